@@ -6,13 +6,25 @@ in vec2 g_texUV;
 
 layout(location = 0) out vec4 f_color;
 
-// Uploaded by the renderer
-uniform vec3 u_color;
-uniform sampler2D u_texture;
-
-// Uploaded by the engine
-uniform mat4 u_matMV;
-uniform vec3 u_clearColor;
+// Uploaded by the renderer, layer by u_color.a
+uniform sampler2DArray u_texture;
+
+// Per frame, shared by all programs (binding 0)
+layout(std140) uniform Frame {
+  mat4 u_matV;
+  mat4 u_matP;
+  mat4 u_matVP;
+  vec4 u_clearColor;
+};
+
+// Per draw, from the renderer constants ring (binding 1)
+layout(std140) uniform Draw {
+  mat4 u_matMV;
+  mat4 u_matN;
+  vec4 u_color;
+  vec4 u_posOffset;
+  vec4 u_posScale;
+};
 
 // ====================================================================== //
 // ====================================================================== //
@@ -21,7 +33,7 @@ uniform vec3 u_clearColor;
 
 vec3 fogged(in vec3 pos, in vec3 color){
 	float fog_factor = 1 / exp(0.0003 * pow(length(pos),2));
-	return mix(u_clearColor, color, fog_factor);
+	return mix(u_clearColor.rgb, color, fog_factor);
 }
 
 // ====================================================================== //
@@ -32,10 +44,11 @@ vec3 fogged(in vec3 pos, in vec3 color){
 void main() {
 
   // Obj color and texture read
-	vec3 color = texture(u_texture, g_texUV).rgb;
-	if (color == vec3(0)) { color = u_color; }
+	vec3 color = vec3(0);
+	if (u_color.a >= 0) { color = texture(u_texture, vec3(g_texUV, u_color.a)).rgb; }
+	if (color == vec3(0)) { color = u_color.rgb; }
 
-  color *= u_color * 0.5;
+  color *= u_color.rgb * 0.5;
   color = fogged(-g_pos*0.25, color);
 
   // Output gamma corrected color
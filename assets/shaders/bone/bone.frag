@@ -3,26 +3,26 @@
 in vec3 g_pos;
 in vec3 g_norm;
 in vec2 g_texUV;
+in vec3 g_color;
+flat in float g_layer;
 
 layout(location = 0) out vec4 f_color;
 
-// Uploaded by the renderer
-uniform vec3 u_color;
-uniform sampler2D u_texture;
+// Uploaded by the renderer, layer by g_layer
+uniform sampler2DArray u_texture;
 
 // Uploaded by the engine
-uniform mat4 u_matMV;
 uniform vec3 u_lightPos;
 uniform vec3 u_lightColor;
 uniform float u_lightIntensity;
-uniform vec3 u_clearColor;
 
 
 void main() {
 
   // Texture
-	vec3 color = texture(u_texture, g_texUV).rgb;
-	if (color == vec3(0)) { color = u_color; }
+	vec3 color = vec3(0);
+	if (g_layer >= 0) { color = texture(u_texture, vec3(g_texUV, g_layer)).rgb; }
+	if (color == vec3(0)) { color = g_color; }
 
   // Light
   vec3 N = normalize(g_norm);
@@ -1,20 +1,63 @@
 #version 330 core
 
-layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 norm;
+layout(location = 0) in vec3 pos;  // Unorm within the mesh bounds
+layout(location = 1) in vec2 norm; // Octahedral
 layout(location = 2) in vec2 texUV;
+layout(location = 3) in mat4 i_matM;  // Per instance, locations 3..6
+layout(location = 7) in vec4 i_color; // Per instance
+layout(location = 8) in mat3 i_matN;  // Per instance, locations 8..10
 
 out vec3 v_pos;
 out vec3 v_norm;
 out vec2 v_texUV;
+out vec3 v_color;
+flat out float v_layer; // Texture array layer, -1 for none
 
-uniform mat4 u_matMV;
-uniform mat4 u_matV;
-uniform mat4 u_matN;
+// Per frame, shared by all programs (binding 0)
+layout(std140) uniform Frame {
+  mat4 u_matV;
+  mat4 u_matP;
+  mat4 u_matVP;
+  vec4 u_clearColor;
+};
+
+// Per draw, from the renderer constants ring (binding 1)
+layout(std140) uniform Draw {
+  mat4 u_matMV;
+  mat4 u_matN;
+  vec4 u_color;
+  vec4 u_posOffset;
+  vec4 u_posScale;
+};
+
+// Uploaded by the renderer
+uniform bool u_instanced;
+
+// Packed vertices: positions are unorm within the mesh bounds, normals
+// octahedral snorm
+vec3 octDecode(vec2 e) {
+  vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if (v.z < 0) { v.xy = (1.0 - abs(v.yx)) * vec2(e.x >= 0 ? 1 : -1, e.y >= 0 ? 1 : -1); }
+  return normalize(v);
+}
 
 void main() {
-	v_norm = (u_matN * vec4(norm,0)).xyz;
-	v_pos = (u_matMV * vec4(pos,1)).xyz;
+	mat4 matMV = u_matMV;
+	mat3 matN = mat3(u_matN);
+	v_color = u_color.rgb;
+	v_layer = u_color.a;
+
+	// Instanced draws: model, color and layer come from the instance buffer
+	if (u_instanced) {
+		matMV = u_matV * i_matM;
+		matN = mat3(u_matV) * i_matN; // View is rigid
+		v_color = i_color.rgb;
+		v_layer = i_color.a;
+	}
+
+	vec3 objPos = u_posOffset.xyz + pos * u_posScale.xyz;
+	v_norm = matN * octDecode(norm);
+	v_pos = (matMV * vec4(objPos,1)).xyz;
 	v_texUV = texUV;
-	gl_Position = u_matMV * vec4(pos, 1);
+	gl_Position = matMV * vec4(objPos, 1);
 }
@@ -0,0 +1,19 @@
+#version 330 core
+
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec4 color;
+
+out vec4 v_color;
+
+// Per frame, shared by all programs (binding 0)
+layout(std140) uniform Frame {
+  mat4 u_matV;
+  mat4 u_matP;
+  mat4 u_matVP;
+  vec4 u_clearColor;
+};
+
+void main() {
+	v_color = color;
+	gl_Position = u_matVP * vec4(pos, 1);
+}
@@ -64,6 +64,29 @@ float       Settings::mainCameraSpeed{0.1f};
 float       Settings::mainCameraFov{0.75f};
 std::string Settings::plotDir{"./assets/plotdata/"};
 float       Settings::floorSize{500.f};
+std::string Settings::inputRecord{""};
+std::string Settings::inputReplay{""};
+bool        Settings::headless{false};
+std::string Settings::cacheDir{"./assets/cache/"};
+std::string Settings::captureDir{""};
+std::string Settings::captureFormat{"png"};
+int         Settings::captureFrames{0};
+int         Settings::loaderThreads{0};
+int         Settings::textureUploadKB{4096};
+float       Settings::lodPixelError{1.f};
+bool        Settings::skinnedMesh{false};
+int         Settings::skinThreads{0};
+bool        Settings::skinBenchmark{false};
+bool        Settings::packingCheck{false};
+bool        Settings::renderThread{true};
+std::string Settings::frameMode{"vsync"};
+int         Settings::frameRate{60};
+bool        Settings::renderOnDemand{true};
+int         Settings::metricsFrames{60};
+std::string Settings::metricsFile{""};
+std::string Settings::metricsShm{""};
+
+std::atomic<void (*)()> Settings::onReload{nullptr};
 
 
 // ====================================================================== //
@@ -99,6 +122,27 @@ void Settings::init(const std::string& filePath) {
         stdParse(mainCameraFov, 0.75f);
         stdParse(plotDir, "./assets/plotdata/");
         stdParse(floorSize, 500.f);
+        stdParse(inputRecord, "");
+        stdParse(inputReplay, "");
+        stdParse(headless, false);
+        stdParse(cacheDir, "./assets/cache/");
+        stdParse(captureDir, "");
+        stdParse(captureFormat, "png");
+        stdParse(captureFrames, 0);
+        stdParse(loaderThreads, 0);
+        stdParse(textureUploadKB, 4096);
+        stdParse(lodPixelError, 1.f);
+        stdParse(skinnedMesh, false);
+        stdParse(skinThreads, 0);
+        stdParse(skinBenchmark, false);
+        stdParse(packingCheck, false);
+        stdParse(renderThread, true);
+        stdParse(frameMode, "vsync");
+        stdParse(frameRate, 60);
+        stdParse(renderOnDemand, true);
+        stdParse(metricsFrames, 60);
+        stdParse(metricsFile, "");
+        stdParse(metricsShm, "");
 
         m_corrupted = false;
       }
@@ -108,6 +152,8 @@ void Settings::init(const std::string& filePath) {
         LOGE("'{}' Bad parsing:\n{}", m_path, e.what());
         goto retry_pase;
       }
+
+      if (auto fn = onReload.load()) fn();
   };
 
   // Load values
@@ -141,6 +187,27 @@ void Settings::dump() {
   glmPrint(mainCameraPos);
   glmPrint(mainCameraRot);
   stdPrint(mainCameraSpeed);
+  stdPrint(inputRecord);
+  stdPrint(inputReplay);
+  stdPrint(headless);
+  stdPrint(cacheDir);
+  stdPrint(captureDir);
+  stdPrint(captureFormat);
+  stdPrint(captureFrames);
+  stdPrint(loaderThreads);
+  stdPrint(textureUploadKB);
+  stdPrint(lodPixelError);
+  stdPrint(skinnedMesh);
+  stdPrint(skinThreads);
+  stdPrint(skinBenchmark);
+  stdPrint(packingCheck);
+  stdPrint(renderThread);
+  stdPrint(frameMode);
+  stdPrint(frameRate);
+  stdPrint(renderOnDemand);
+  stdPrint(metricsFrames);
+  stdPrint(metricsFile);
+  stdPrint(metricsShm);
   LOG("");
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <json.hpp>
 using json = nlohmann::json;
 
@@ -34,6 +35,30 @@ public:
   static float       mainCameraFov;
   static std::string plotDir;
   static float       floorSize;
+  static std::string inputRecord;
+  static std::string inputReplay;
+  static bool        headless;
+  static std::string cacheDir;
+  static std::string captureDir;
+  static std::string captureFormat;
+  static int         captureFrames;
+  static int         loaderThreads;
+  static int         textureUploadKB;
+  static float       lodPixelError;
+  static bool        skinnedMesh;
+  static int         skinThreads;
+  static bool        skinBenchmark;
+  static bool        packingCheck;
+  static bool        renderThread;
+  static std::string frameMode;
+  static int         frameRate;
+  static bool        renderOnDemand;
+  static int         metricsFrames;
+  static std::string metricsFile;
+  static std::string metricsShm;
+
+  // Called from the watcher thread when the file is parsed again
+  static std::atomic<void (*)()> onReload;
 
   // Initializer
   static void init(const std::string& filePath);
@@ -0,0 +1,168 @@
+#include "cpptools_BufferAllocators.hpp"
+
+#include <iterator>
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Round offset up to a multiple of align (not only powers of two)
+// ====================================================================== //
+
+static size_t alignUp(size_t offset, size_t align) {
+  return (align > 1u) ? (offset + align - 1u) / align * align : offset;
+}
+
+
+// * ArenaAllocator
+
+// ====================================================================== //
+// ====================================================================== //
+// Param constructor. The whole range starts free
+// ====================================================================== //
+
+ArenaAllocator::ArenaAllocator(size_t capacity)
+    : m_capacity(capacity), m_used(0u) {
+  if (capacity > 0u) m_free.emplace(0u, capacity);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Offset of a free range of size bytes aligned to align, npos if none.
+// The padding before the aligned offset and the tail stay free
+// ====================================================================== //
+
+size_t ArenaAllocator::alloc(size_t size, size_t align) {
+  if (size == 0u) return npos;
+
+  for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+    auto start = it->first;
+    auto len   = it->second;
+    auto off   = alignUp(start, align);
+    if (off + size > start + len) continue;
+
+    m_free.erase(it);
+    if (off > start) m_free.emplace(start, off - start);
+    if (off + size < start + len) {
+      m_free.emplace(off + size, start + len - off - size);
+    }
+
+    m_used += size;
+    return off;
+  }
+  return npos;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Give back a range got from alloc, merged with free neighbours
+// ====================================================================== //
+
+void ArenaAllocator::free(size_t offset, size_t size) {
+  if (offset == npos || size == 0u) return;
+  m_used -= size;
+
+  auto next = m_free.lower_bound(offset);
+  if (next != m_free.end() && offset + size == next->first) {
+    size += next->second;
+    next = m_free.erase(next);
+  }
+  if (next != m_free.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += size;
+      return;
+    }
+  }
+  m_free.emplace(offset, size);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Getters
+// ====================================================================== //
+
+size_t ArenaAllocator::capacity() const { return m_capacity; }
+size_t ArenaAllocator::used() const { return m_used; }
+
+
+// * RingAllocator
+
+// ====================================================================== //
+// ====================================================================== //
+// Param constructor. Starts closed on the last partition, so the first
+// frame opens partition 0
+// ====================================================================== //
+
+RingAllocator::RingAllocator(size_t partitionSize, unsigned int partitions)
+    : m_partitionSize(partitionSize),
+      m_partitions(partitions > 0u ? partitions : 1u),
+      m_current(m_partitions - 1u),
+      m_head(0u),
+      m_open(false) {}
+
+// ====================================================================== //
+// ====================================================================== //
+// Open next partition and return its index (wait its fence before use)
+// ====================================================================== //
+
+unsigned int RingAllocator::begin() {
+  if (!m_open) {
+    m_current = (m_current + 1u) % m_partitions;
+    m_head    = 0u;
+    m_open    = true;
+  }
+  return m_current;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Absolute offset of size bytes aligned to align on the open partition,
+// npos if it doesn't fit
+// ====================================================================== //
+
+size_t RingAllocator::alloc(size_t size, size_t align) {
+  if (!m_open) return npos;
+  auto base = m_current * m_partitionSize;
+  auto off  = alignUp(base + m_head, align);
+  if (off + size > base + m_partitionSize) return npos;
+  m_head = off + size - base;
+  return off;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Close current partition and return its index (fence it after use)
+// ====================================================================== //
+
+unsigned int RingAllocator::end() {
+  m_open = false;
+  return m_current;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Change partition size, only while closed. Every fence must be waited
+// ====================================================================== //
+
+void RingAllocator::resize(size_t partitionSize) {
+  if (m_open) return;
+  m_partitionSize = partitionSize;
+  m_current       = m_partitions - 1u;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Getters
+// ====================================================================== //
+
+bool         RingAllocator::open() const { return m_open; }
+unsigned int RingAllocator::current() const { return m_current; }
+unsigned int RingAllocator::partitions() const { return m_partitions; }
+size_t       RingAllocator::partitionSize() const { return m_partitionSize; }
+size_t       RingAllocator::used() const { return m_head; }
+size_t       RingAllocator::size() const {
+  return m_partitionSize * m_partitions;
+}
+
+} // namespace imog
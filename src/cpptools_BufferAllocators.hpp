@@ -0,0 +1,77 @@
+#pragma once
+
+#include <map>
+#include <cstddef>
+
+namespace imog {
+
+// Offset allocators behind GPU buffers. Only bookkeeping of byte ranges,
+// no graphics API involved, so they can be checked without a context.
+
+// First fit allocator over [0, capacity) for long lived ranges (meshes).
+// Freed ranges are merged with their free neighbours.
+class ArenaAllocator {
+
+public:
+  static constexpr size_t npos = ~size_t(0);
+
+private:
+  size_t                   m_capacity;
+  size_t                   m_used;
+  std::map<size_t, size_t> m_free; // Offset -> size, sorted to merge
+
+public:
+  explicit ArenaAllocator(size_t capacity);
+
+  // Offset of a free range of size bytes aligned to align, npos if none
+  size_t alloc(size_t size, size_t align = 16u);
+
+  // Give back a range got from alloc
+  void free(size_t offset, size_t size);
+
+  // Getters
+  size_t capacity() const;
+  size_t used() const;
+};
+
+// Ring split in equal partitions, one per frame in flight. A frame opens
+// the next partition, bumps allocations on it and closes it. The caller
+// fences each partition at close and waits that fence before reopening.
+class RingAllocator {
+
+public:
+  static constexpr size_t npos = ~size_t(0);
+
+private:
+  size_t       m_partitionSize;
+  unsigned int m_partitions;
+  unsigned int m_current;
+  size_t       m_head; // Bytes used on current partition
+  bool         m_open;
+
+public:
+  RingAllocator(size_t partitionSize, unsigned int partitions = 3u);
+
+  // Open next partition and return its index (wait its fence before use)
+  unsigned int begin();
+
+  // Absolute offset of size bytes aligned to align on the open partition,
+  // npos if it doesn't fit
+  size_t alloc(size_t size, size_t align = 16u);
+
+  // Close current partition and return its index (fence it after use)
+  unsigned int end();
+
+  // Change partition size, only while closed. Every fence must be waited
+  void resize(size_t partitionSize);
+
+  // Getters
+  bool         open() const;
+  unsigned int current() const;
+  unsigned int partitions() const;
+  size_t       partitionSize() const;
+  size_t       used() const; // On current partition
+  size_t       size() const; // Of the whole ring
+};
+
+} // namespace imog
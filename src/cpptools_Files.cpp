@@ -1,7 +1,11 @@
 #include "cpptools_Files.hpp"
 
 #include <fstream>
+#include <algorithm>
 #include <sys/stat.h>
+#if _WIN64
+#include <direct.h>
+#endif
 
 #include "cpptools_Logger.hpp"
 
@@ -25,4 +29,35 @@ std::string Files::pathToWin(const std::string& path) {
   return auxStr;
 }
 
+long long Files::size(const std::string& path) {
+  struct stat buffer;
+  return (stat(path.c_str(), &buffer) == 0) ? buffer.st_size : -1;
+}
+
+long long Files::modTime(const std::string& path) {
+  struct stat buffer;
+  return (stat(path.c_str(), &buffer) == 0) ? buffer.st_mtime : -1;
+}
+
+bool Files::makeDir(const std::string& path) {
+  for (auto i = path.find_first_of("/\\", 1); i != std::string::npos;
+       i      = path.find_first_of("/\\", i + 1)) {
+    auto sub = path.substr(0, i);
+    if (pathExists(sub)) continue;
+#if _WIN64
+    _mkdir(sub.c_str());
+#else
+    mkdir(sub.c_str(), 0755);
+#endif
+  }
+  if (!pathExists(path)) {
+#if _WIN64
+    _mkdir(path.c_str());
+#else
+    mkdir(path.c_str(), 0755);
+#endif
+  }
+  return pathExists(path);
+}
+
 } // namespace imog
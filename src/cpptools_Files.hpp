@@ -9,6 +9,13 @@ public:
   static bool ok(const std::string& path, bool log = false);
   static bool pathExists(const std::string& path);
   static std::string pathToWin(const std::string& path);
+
+  // Size in bytes and last modification time, -1 if file doesn't exist
+  static long long size(const std::string& path);
+  static long long modTime(const std::string& path);
+
+  // Create a folder (and its parents) if it doesn't exist
+  static bool makeDir(const std::string& path);
 };
 
 } // namespace imog
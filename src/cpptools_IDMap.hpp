@@ -0,0 +1,117 @@
+#pragma once
+
+#include <vector>
+
+#include "cpptools_StringID.hpp"
+
+#ifdef DEBUG
+#include <string>
+#include "cpptools_Logger.hpp"
+#endif
+
+namespace imog {
+
+// Flat open-addressing table keyed by StringID hashes. Linear probing over a
+// power of two array kept at most half full, so lookups are a hash mask and
+// a few compares on contiguous memory. No erase, keys live as long as the
+// table. Debug builds keep the names to report hash collisions.
+template <typename V>
+class IDMap {
+
+  struct slot {
+    uint64_t key{0u}; // 0 = empty
+    V        value{};
+  };
+
+private:
+  std::vector<slot> m_slots;
+  size_t            m_count{0u};
+
+#ifdef DEBUG
+  std::vector<std::string> m_names;
+
+  void check(size_t i, StringID id) const {
+    if (id.str() && m_names[i] != id.str()) {
+      LOGE("StringID collision: \"{}\" vs \"{}\"", m_names[i], id.str());
+    }
+  }
+#endif
+
+  // Hash 0 marks empty slots, move it away
+  static uint64_t keyOf(StringID id) {
+    return (id.value() != 0u) ? id.value() : 1u;
+  }
+
+  // Slot holding key or the empty slot where it should go
+  size_t probe(uint64_t key) const {
+    auto mask = m_slots.size() - 1u;
+    auto i    = static_cast<size_t>(key ^ (key >> 32)) & mask;
+    while (m_slots[i].key != 0u && m_slots[i].key != key) i = (i + 1u) & mask;
+    return i;
+  }
+
+  void grow() {
+    auto old = std::move(m_slots);
+    m_slots.assign((old.empty()) ? 16u : old.size() * 2u, slot{});
+#ifdef DEBUG
+    auto oldNames = std::move(m_names);
+    m_names.assign(m_slots.size(), std::string{});
+#endif
+    for (auto j = 0u; j < old.size(); ++j) {
+      if (old[j].key == 0u) continue;
+      auto i     = probe(old[j].key);
+      m_slots[i] = std::move(old[j]);
+#ifdef DEBUG
+      m_names[i] = std::move(oldNames[j]);
+#endif
+    }
+  }
+
+public:
+  // Pointer to the value of id, null if it isn't on the table
+  V* find(StringID id) {
+    if (m_slots.empty()) return nullptr;
+    auto i = probe(keyOf(id));
+    if (m_slots[i].key == 0u) return nullptr;
+#ifdef DEBUG
+    check(i, id);
+#endif
+    return &m_slots[i].value;
+  }
+
+  const V* find(StringID id) const {
+    return const_cast<IDMap*>(this)->find(id);
+  }
+
+  // Insert or overwrite the value of id
+  V& set(StringID id, const V& value) {
+    if ((m_count + 1u) * 2u > m_slots.size()) grow();
+    auto key = keyOf(id);
+    auto i   = probe(key);
+    if (m_slots[i].key == 0u) {
+      m_slots[i].key = key;
+      ++m_count;
+#ifdef DEBUG
+      if (id.str()) m_names[i] = id.str();
+    } else {
+      check(i, id);
+#endif
+    }
+    m_slots[i].value = value;
+    return m_slots[i].value;
+  }
+
+  // Number of keys
+  size_t size() const { return m_count; }
+
+  // Remove all keys
+  void clear() {
+    m_slots.clear();
+    m_count = 0u;
+#ifdef DEBUG
+    m_names.clear();
+#endif
+  }
+};
+
+} // namespace imog
@@ -0,0 +1,319 @@
+#include "cpptools_Image.hpp"
+
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define IMOG_SSE2
+#include <emmintrin.h>
+#endif
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "cpptools_Logger.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Checksums of PNG chunks (CRC-32) and zlib streams (Adler-32)
+// ====================================================================== //
+
+static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0u) {
+  static const auto table = []() {
+    std::vector<uint32_t> t(256u);
+    for (auto n = 0u; n < 256u; ++n) {
+      auto c = n;
+      for (auto k = 0; k < 8; ++k) {
+        c = (c & 1u) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      t[n] = c;
+    }
+    return t;
+  }();
+
+  crc = ~crc;
+  for (size_t i = 0u; i < size; ++i) {
+    crc = table[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+static uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler) {
+  uint32_t a = adler & 0xFFFFu, b = adler >> 16;
+  while (size > 0u) {
+    auto n = std::min<size_t>(size, 5552u); // No overflow before modulo
+    size -= n;
+    while (n--) {
+      a += *data++;
+      b += a;
+    }
+    a %= 65521u;
+    b %= 65521u;
+  }
+  return (b << 16) | a;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Average 2x2 blocks of two rows, with rounding. count output pixels,
+// (2 * count) on each input row. SSE2 does two pixels per iteration
+// ====================================================================== //
+
+static void average(const uint8_t* row0,
+                    const uint8_t* row1,
+                    uint8_t*       out,
+                    int            count) {
+  auto i = 0;
+#ifdef IMOG_SSE2
+  const auto zero = _mm_setzero_si128();
+  const auto two  = _mm_set1_epi16(2);
+  for (; i + 2 <= count; i += 2) {
+    auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + i * 8));
+    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + i * 8));
+
+    // Vertical sums of 16 bit channels: pixels 0 and 1, pixels 2 and 3
+    auto lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                            _mm_unpacklo_epi8(b, zero));
+    auto hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                            _mm_unpackhi_epi8(b, zero));
+
+    // Horizontal sums, each 64 bit half plus the other
+    lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+    hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+    auto sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two),
+                              2);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i * 4),
+                     _mm_packus_epi16(sum, zero));
+  }
+#endif
+  for (; i < count; ++i) {
+    for (auto c = 0; c < 4; ++c) {
+      auto s = row0[i * 8 + c] + row0[i * 8 + 4 + c] + row1[i * 8 + c] +
+               row1[i * 8 + 4 + c];
+      out[i * 4 + c] = static_cast<uint8_t>((s + 2) >> 2);
+    }
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Big endian writes
+// ====================================================================== //
+
+static void put32(std::vector<uint8_t>& out, uint32_t v) {
+  out.push_back(v >> 24);
+  out.push_back(v >> 16);
+  out.push_back(v >> 8);
+  out.push_back(v);
+}
+
+static void putChunk(std::vector<uint8_t>&       out,
+                     const char*                 type,
+                     const std::vector<uint8_t>& data) {
+  put32(out, static_cast<uint32_t>(data.size()));
+  auto start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  put32(out, crc32(out.data() + start, out.size() - start));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Write a whole buffer to disk
+// ====================================================================== //
+
+static bool writeFile(const std::string& path,
+                      const uint8_t*     data,
+                      size_t             size) {
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(data), size);
+  if (!file) {
+    LOGE("Couldn't write image {}", path);
+    return false;
+  }
+  return true;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Decode a file to RGBA, empty if it can't. Flipped here and not with the
+// stb_image global flag, so decoding from many threads is safe
+// ====================================================================== //
+
+std::vector<uint8_t> Image::read(const std::string& path,
+                                 int&               width,
+                                 int&               height,
+                                 bool               flipY) {
+  std::vector<uint8_t> out;
+  int                  channels = 0;
+  auto img = stbi_load(path.c_str(), &width, &height, &channels, 4);
+  if (!img) return out;
+
+  size_t rowSize = static_cast<size_t>(width) * 4u;
+  out.resize(rowSize * height);
+  for (auto y = 0; y < height; ++y) {
+    std::memcpy(out.data() + rowSize * y,
+                img + rowSize * (flipY ? height - 1 - y : y),
+                rowSize);
+  }
+  stbi_image_free(img);
+  return out;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Mip levels down to 1x1
+// ====================================================================== //
+
+int Image::mipLevels(int width, int height) {
+  auto levels = 1;
+  for (auto size = std::max(width, height); size > 1; size >>= 1) ++levels;
+  return levels;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Half size of an image (2x2 box filter, as glGenerateMipmap). An odd
+// last column or row is dropped, a size of 1 is averaged with itself
+// ====================================================================== //
+
+void Image::downsample(const uint8_t* rgba,
+                       int            width,
+                       int            height,
+                       uint8_t*       out) {
+  auto outW    = std::max(width / 2, 1);
+  auto outH    = std::max(height / 2, 1);
+  auto rowSize = static_cast<size_t>(width) * 4u;
+
+  for (auto y = 0; y < outH; ++y) {
+    auto row0 = rgba + rowSize * std::min(2 * y, height - 1);
+    auto row1 = rgba + rowSize * std::min(2 * y + 1, height - 1);
+    auto dst  = out + static_cast<size_t>(outW) * 4u * y;
+
+    if (width > 1) {
+      average(row0, row1, dst, outW);
+    } else {
+      for (auto c = 0; c < 4; ++c) {
+        dst[c] = static_cast<uint8_t>((row0[c] + row1[c] + 1) >> 1);
+      }
+    }
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Whole mip chain of an image, each level from the previous one
+// ====================================================================== //
+
+Image::chain Image::mipChain(const std::vector<uint8_t>& rgba,
+                             int                         width,
+                             int                         height) {
+  chain out;
+  auto  count = mipLevels(width, height);
+  out.levels.reserve(count);
+
+  size_t total = 0u;
+  for (auto l = 0; l < count; ++l) {
+    auto w = std::max(width >> l, 1);
+    auto h = std::max(height >> l, 1);
+    out.levels.push_back({w, h, total});
+    total += static_cast<size_t>(w) * h * 4u;
+  }
+
+  out.pixels.resize(total);
+  std::copy(rgba.begin(), rgba.end(), out.pixels.begin());
+  for (auto l = 1; l < count; ++l) {
+    const auto& src = out.levels[l - 1];
+    downsample(out.pixels.data() + src.offset,
+               src.width,
+               src.height,
+               out.pixels.data() + out.levels[l].offset);
+  }
+  return out;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// PNG with stored deflate blocks. Every row goes with filter 0 (none) and
+// blocks take up to 64KB of the filtered rows
+// ====================================================================== //
+
+bool Image::writePNG(const std::string& path,
+                     int                width,
+                     int                height,
+                     const uint8_t*     rgba,
+                     bool               flipY) {
+  if (width <= 0 || height <= 0 || !rgba) return false;
+
+  size_t               rowSize = static_cast<size_t>(width) * 4u;
+  std::vector<uint8_t> rows;
+  rows.reserve((rowSize + 1u) * height);
+  for (auto y = 0; y < height; ++y) {
+    auto src = rgba + rowSize * (flipY ? height - 1 - y : y);
+    rows.push_back(0u);
+    rows.insert(rows.end(), src, src + rowSize);
+  }
+
+  // zlib stream: header, stored blocks, Adler-32 of the raw data
+  std::vector<uint8_t> idat;
+  idat.reserve(rows.size() + rows.size() / 65535u * 5u + 16u);
+  idat.push_back(0x78u);
+  idat.push_back(0x01u);
+  for (size_t pos = 0u; pos < rows.size();) {
+    auto len  = std::min<size_t>(rows.size() - pos, 65535u);
+    auto last = pos + len == rows.size();
+    idat.push_back(last ? 1u : 0u);
+    idat.push_back(len & 0xFFu);
+    idat.push_back(len >> 8);
+    idat.push_back(~len & 0xFFu);
+    idat.push_back((~len >> 8) & 0xFFu);
+    idat.insert(idat.end(), rows.begin() + pos, rows.begin() + pos + len);
+    pos += len;
+  }
+  put32(idat, adler32(rows.data(), rows.size(), 1u));
+
+  std::vector<uint8_t> ihdr;
+  put32(ihdr, static_cast<uint32_t>(width));
+  put32(ihdr, static_cast<uint32_t>(height));
+  ihdr.insert(ihdr.end(), {8u, 6u, 0u, 0u, 0u}); // 8 bit RGBA, no interlace
+
+  static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+  std::vector<uint8_t> png(signature, signature + 8);
+  png.reserve(idat.size() + 64u);
+  putChunk(png, "IHDR", ihdr);
+  putChunk(png, "IDAT", idat);
+  putChunk(png, "IEND", {});
+
+  return writeFile(path, png.data(), png.size());
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Bare pixels, width * height * 4 bytes, no header
+// ====================================================================== //
+
+bool Image::writeRaw(const std::string& path,
+                     int                width,
+                     int                height,
+                     const uint8_t*     rgba,
+                     bool               flipY) {
+  if (width <= 0 || height <= 0 || !rgba) return false;
+
+  size_t rowSize = static_cast<size_t>(width) * 4u;
+  if (!flipY) return writeFile(path, rgba, rowSize * height);
+
+  std::vector<uint8_t> flipped(rowSize * height);
+  for (auto y = 0; y < height; ++y) {
+    std::copy_n(rgba + rowSize * (height - 1 - y),
+                rowSize,
+                flipped.data() + rowSize * y);
+  }
+  return writeFile(path, flipped.data(), flipped.size());
+}
+
+} // namespace imog
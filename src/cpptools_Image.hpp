@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace imog {
+
+// Image files and mip chains of 8 bit RGBA pixels. Rows are bottom to top
+// when flipY is set, as OpenGL reads them back. CPU only, thread safe.
+class Image {
+public:
+  // Mip chain on one buffer, full size level first
+  struct level {
+    int    width;
+    int    height;
+    size_t offset; // On pixels
+  };
+  struct chain {
+    std::vector<uint8_t> pixels;
+    std::vector<level>   levels;
+  };
+
+  // Decode a file (PNG, JPG, BMP, TGA, ...) to RGBA, empty if it can't
+  static std::vector<uint8_t> read(const std::string& path,
+                                   int&               width,
+                                   int&               height,
+                                   bool               flipY = false);
+
+  // Mip levels down to 1x1
+  static int mipLevels(int width, int height);
+
+  // Half size of an image (2x2 box), odd last row or column are dropped
+  static void downsample(const uint8_t* rgba,
+                         int            width,
+                         int            height,
+                         uint8_t*       out);
+
+  // Whole mip chain of an image
+  static chain mipChain(const std::vector<uint8_t>& rgba,
+                        int                         width,
+                        int                         height);
+
+  // PNG with stored (not compressed) deflate blocks: bigger files, but
+  // writing costs little more than a copy
+  static bool writePNG(const std::string& path,
+                       int                width,
+                       int                height,
+                       const uint8_t*     rgba,
+                       bool               flipY = false);
+
+  // Bare pixels, width * height * 4 bytes, no header
+  static bool writeRaw(const std::string& path,
+                       int                width,
+                       int                height,
+                       const uint8_t*     rgba,
+                       bool               flipY = false);
+};
+
+} // namespace imog
@@ -0,0 +1,90 @@
+#include "cpptools_MappedFile.hpp"
+
+#if _WIN64
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Map the file, check ok() to know if it was mapped
+// ====================================================================== //
+
+#if _WIN64
+
+MappedFile::MappedFile(const std::string& path)
+    : m_data(nullptr), m_size(0u), m_file(nullptr), m_mapping(nullptr) {
+
+  HANDLE f = CreateFileA(path.c_str(),
+                         GENERIC_READ,
+                         FILE_SHARE_READ,
+                         nullptr,
+                         OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL,
+                         nullptr);
+  if (f == INVALID_HANDLE_VALUE) return;
+  m_file = f;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(f, &size) || size.QuadPart == 0) return;
+
+  m_mapping = CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!m_mapping) return;
+
+  m_data = (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+  if (m_data) m_size = static_cast<size_t>(size.QuadPart);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+    : m_data(nullptr), m_size(0u), m_fd(-1) {
+
+  m_fd = open(path.c_str(), O_RDONLY);
+  if (m_fd < 0) return;
+
+  struct stat st;
+  if (fstat(m_fd, &st) != 0 || st.st_size == 0) return;
+
+  void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+  if (ptr == MAP_FAILED) return;
+
+  m_data = static_cast<const char*>(ptr);
+  m_size = static_cast<size_t>(st.st_size);
+}
+
+#endif
+
+// ====================================================================== //
+// ====================================================================== //
+// Unmap and close the file
+// ====================================================================== //
+
+MappedFile::~MappedFile() {
+#if _WIN64
+  if (m_data) UnmapViewOfFile(m_data);
+  if (m_mapping) CloseHandle(m_mapping);
+  if (m_file) CloseHandle(m_file);
+#else
+  if (m_data) munmap(const_cast<char*>(m_data), m_size);
+  if (m_fd >= 0) close(m_fd);
+#endif
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Getters
+// ====================================================================== //
+
+bool        MappedFile::ok() const { return m_data != nullptr; }
+const char* MappedFile::data() const { return m_data; }
+size_t      MappedFile::size() const { return m_size; }
+
+} // namespace imog
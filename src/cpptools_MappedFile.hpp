@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace imog {
+
+// Read-only memory mapping of a whole file. Unmapped on destruction
+class MappedFile {
+
+private:
+  const char* m_data;
+  size_t      m_size;
+#if _WIN64
+  void* m_file;
+  void* m_mapping;
+#else
+  int m_fd;
+#endif
+
+public:
+  // Map the file, check ok() to know if it was mapped
+  MappedFile(const std::string& path);
+
+  // Unmap and close the file
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Was the file mapped?
+  bool ok() const;
+
+  // Getter for data
+  const char* data() const;
+
+  // Getter for size (bytes)
+  size_t size() const;
+};
+
+} // namespace imog
@@ -0,0 +1,330 @@
+#include "cpptools_Metrics.hpp"
+
+#include <new>
+#include <cmath>
+#include <thread>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+
+#include "cpptools_Logger.hpp"
+#include "cpptools_SharedMemory.hpp"
+#include "Settings.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Private variables definition
+// ====================================================================== //
+
+std::mutex                            Metrics::m_mutex{};
+Metrics::registry<Metrics::counter>   Metrics::m_counters{};
+Metrics::registry<Metrics::gauge>     Metrics::m_gauges{};
+Metrics::registry<Metrics::histogram> Metrics::m_histograms{};
+std::atomic<uint64_t>                 Metrics::m_frames{0u};
+uint64_t                              Metrics::m_published{0u};
+TimePoint                             Metrics::m_start{StdClock::now()};
+std::string                           Metrics::m_line{};
+std::FILE*                            Metrics::m_file{nullptr};
+std::unique_ptr<SharedMemory>         Metrics::m_shared{};
+
+// ====================================================================== //
+// ====================================================================== //
+// Atomic updates of doubles (no fetch_add for them before C++20)
+// ====================================================================== //
+
+static void atomicAdd(std::atomic<double>& a, double v) {
+  auto old = a.load(std::memory_order_relaxed);
+  while (!a.compare_exchange_weak(old, old + v, std::memory_order_relaxed)) {}
+}
+
+template <typename Better>
+static void atomicKeep(std::atomic<double>& a, double v, Better better) {
+  auto old = a.load(std::memory_order_relaxed);
+  while (better(v, old) &&
+         !a.compare_exchange_weak(old, v, std::memory_order_relaxed)) {}
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Counters and gauges
+// ====================================================================== //
+
+void Metrics::counter::add(uint64_t n) {
+  m_value.fetch_add(n, std::memory_order_relaxed);
+}
+uint64_t Metrics::counter::value() const {
+  return m_value.load(std::memory_order_relaxed);
+}
+
+void Metrics::gauge::set(double v) {
+  m_value.store(v, std::memory_order_relaxed);
+}
+double Metrics::gauge::value() const {
+  return m_value.load(std::memory_order_relaxed);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Histogram buckets. Bucket i holds samples up to 1/16 * 2^(i/4) ms, the
+// last one everything over 1s
+// ====================================================================== //
+
+static constexpr double bucketBase = 1.0 / 16.0;
+
+static unsigned int bucketOf(double ms) {
+  if (!(ms > bucketBase)) return 0u;
+  auto i = std::ceil(4.0 * std::log2(ms / bucketBase));
+  return std::min(static_cast<unsigned int>(i),
+                  Metrics::histogram::buckets - 1u);
+}
+
+static double bucketBound(unsigned int i) {
+  return bucketBase * std::exp2(i / 4.0);
+}
+
+void Metrics::histogram::observe(double ms) {
+  m_counts[bucketOf(ms)].fetch_add(1u, std::memory_order_relaxed);
+  atomicAdd(m_sum, ms);
+  atomicKeep(m_min, ms, std::less<double>());
+  atomicKeep(m_max, ms, std::greater<double>());
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Summary of the samples since the last take, and start over. Samples
+// observed meanwhile may land half in this one, half in the next
+// ====================================================================== //
+
+Metrics::histogram::summary Metrics::histogram::take() {
+  uint32_t counts[buckets];
+  summary  s;
+  for (auto i = 0u; i < buckets; ++i) {
+    counts[i] = m_counts[i].exchange(0u, std::memory_order_relaxed);
+    s.count += counts[i];
+  }
+  auto sum = m_sum.exchange(0.0, std::memory_order_relaxed);
+  auto min = m_min.exchange(1e300, std::memory_order_relaxed);
+  auto max = m_max.exchange(0.0, std::memory_order_relaxed);
+  if (s.count == 0u) return s;
+
+  s.mean = sum / s.count;
+  s.min  = min;
+  s.max  = max;
+
+  // Nearest rank, clamped to the samples seen
+  auto rank = [&](double p) {
+    auto     target = std::max<uint64_t>(std::ceil(p * s.count), 1u);
+    uint64_t seen   = 0u;
+    auto     i      = 0u;
+    while ((seen += counts[i]) < target) ++i;
+    return std::min(std::max(bucketBound(i), min), max);
+  };
+  s.p50 = rank(0.50);
+  s.p95 = rank(0.95);
+  s.p99 = rank(0.99);
+  return s;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Find or add a metric by name. Few of them, found once each
+// ====================================================================== //
+
+template <typename T>
+T& Metrics::find(registry<T>& metrics, const std::string& name) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto& [key, metric] : metrics) {
+    if (key == name) return *metric;
+  }
+  metrics.emplace_back(name, std::make_unique<T>());
+  return *metrics.back().second;
+}
+
+Metrics::counter& Metrics::findCounter(const std::string& name) {
+  return find(m_counters, name);
+}
+Metrics::gauge& Metrics::findGauge(const std::string& name) {
+  return find(m_gauges, name);
+}
+Metrics::histogram& Metrics::findHistogram(const std::string& name) {
+  return find(m_histograms, name);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Open the file and the segment of Settings. Without any, frame() only
+// counts frames
+// ====================================================================== //
+
+void Metrics::init() {
+  close();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_start     = StdClock::now();
+  m_published = m_frames.load();
+
+  if (!Settings::metricsFile.empty()) {
+    m_file = std::fopen(Settings::metricsFile.c_str(), "a");
+    if (!m_file) {
+      LOGE("Metrics file '{}' can't be opened.", Settings::metricsFile);
+    } else {
+      // A line per publish shows up at once for tail -f and the like
+      std::setvbuf(m_file, nullptr, _IOLBF, capacity);
+    }
+  }
+
+  if (!Settings::metricsShm.empty()) {
+    m_shared = std::make_unique<SharedMemory>(Settings::metricsShm,
+                                              sizeof(segment));
+    if (!m_shared->ok()) {
+      LOGE("Metrics segment '{}' can't be created.", Settings::metricsShm);
+      m_shared.reset();
+    } else {
+      auto seg     = new (m_shared->data()) segment();
+      seg->magic   = magic;
+      seg->version = version;
+    }
+  }
+  m_line.reserve(capacity);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Publish what is left, flush and close them. The segment is removed
+// ====================================================================== //
+
+void Metrics::close() {
+  if ((m_file || m_shared) && m_frames.load() != m_published) publish();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_file) std::fclose(m_file);
+  m_file = nullptr;
+  m_shared.reset();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// A frame is done. Publishes every Settings::metricsFrames frames
+// ====================================================================== //
+
+void Metrics::frame() {
+  auto frames = m_frames.fetch_add(1u, std::memory_order_relaxed) + 1u;
+  auto every  = Settings::metricsFrames;
+  if (every > 0 && frames - m_published >= static_cast<uint64_t>(every)) {
+    publish();
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Write the metrics as a JSON line on m_line. Keeps its capacity, no
+// allocations once it has grown to the line size
+// ====================================================================== //
+
+void Metrics::format(uint64_t frame) {
+  Seconds time = StdClock::now() - m_start;
+  auto    out  = std::back_inserter(m_line);
+  m_line.clear();
+
+  fmt::format_to(out,
+                 "{{\"frame\":{},\"time\":{:.3f},\"frames\":{}",
+                 frame,
+                 time.count(),
+                 frame - m_published);
+
+  auto sep = "";
+  fmt::format_to(out, ",\"counters\":{{");
+  for (const auto& [name, c] : m_counters) {
+    fmt::format_to(out, "{}\"{}\":{}", sep, name, c->value());
+    sep = ",";
+  }
+
+  sep = "";
+  fmt::format_to(out, "}},\"gauges\":{{");
+  for (const auto& [name, g] : m_gauges) {
+    auto v = g->value();
+    fmt::format_to(out, "{}\"{}\":{}", sep, name, std::isfinite(v) ? v : 0.0);
+    sep = ",";
+  }
+
+  sep = "";
+  fmt::format_to(out, "}},\"histograms\":{{");
+  for (const auto& [name, h] : m_histograms) {
+    auto s = h->take();
+    fmt::format_to(out,
+                   "{}\"{}\":{{\"count\":{},\"mean\":{:.3f},\"min\":{:.3f},"
+                   "\"max\":{:.3f},\"p50\":{:.3f},\"p95\":{:.3f},"
+                   "\"p99\":{:.3f}}}",
+                   sep,
+                   name,
+                   s.count,
+                   s.mean,
+                   s.min,
+                   s.max,
+                   s.p50,
+                   s.p95,
+                   s.p99);
+    sep = ",";
+  }
+  fmt::format_to(out, "}}}}\n");
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Publish now: a line on the file, a copy on the segment
+// ====================================================================== //
+
+void Metrics::publish() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto                        frame = m_frames.load();
+  format(frame);
+  m_published = frame;
+
+  if (m_file) std::fwrite(m_line.data(), 1u, m_line.size(), m_file);
+
+  if (m_shared) {
+    auto seg  = reinterpret_cast<segment*>(m_shared->data());
+    auto size = std::min(m_line.size(), capacity);
+    auto seq  = seg->sequence.load(std::memory_order_relaxed);
+
+    seg->sequence.store(seq + 1u, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(seg->text, m_line.data(), size);
+    seg->size.store(static_cast<uint32_t>(size), std::memory_order_relaxed);
+    seg->frame.store(frame, std::memory_order_relaxed);
+    seg->sequence.store(seq + 2u, std::memory_order_release);
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Monitor side: copy of the last line published on the segment name,
+// empty if there is none (yet). Retries while the writer is on it, not
+// forever in case it died there
+// ====================================================================== //
+
+std::string Metrics::read(const std::string& name) {
+  SharedMemory shm(name);
+  if (!shm.ok() || shm.size() < sizeof(segment)) return {};
+
+  auto seg = reinterpret_cast<const segment*>(shm.data());
+  if (seg->magic != magic || seg->version != version) return {};
+
+  std::string text;
+  for (auto tries = 0u; tries < 1000u; ++tries) {
+    auto before = seg->sequence.load(std::memory_order_acquire);
+    if (before == 0u) return {};
+    if (before & 1u) {
+      std::this_thread::yield();
+      continue;
+    }
+    auto size = std::min<size_t>(seg->size.load(std::memory_order_relaxed),
+                                 capacity);
+    text.assign(seg->text, size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seg->sequence.load(std::memory_order_relaxed) == before) return text;
+  }
+  return {};
+}
+
+} // namespace imog
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+
+#include "cpptools_Timer.hpp"
+
+namespace imog {
+class SharedMemory;
+
+// Runtime metrics for monitoring. Named counters, gauges and histograms,
+// found once by name (keep the reference) and updated from any thread
+// with relaxed atomics, no locks nor allocations. Every
+// Settings::metricsFrames frames they are published as a JSON line:
+//   {"frame":N,"time":s,"frames":n,"counters":{...},"gauges":{...},
+//    "histograms":{"name":{"count","mean","min","max","p50","p95","p99"}}}
+// appended to Settings::metricsFile and copied to the shared memory
+// segment Settings::metricsShm, for a local monitor to read() whenever it
+// wants without blocking the frame. Names are plain, no JSON escaping.
+class Metrics {
+
+public:
+  // Ever growing total
+  class counter {
+    std::atomic<uint64_t> m_value{0u};
+
+  public:
+    void     add(uint64_t n = 1u);
+    uint64_t value() const;
+  };
+
+  // Last value set
+  class gauge {
+    std::atomic<double> m_value{0.0};
+
+  public:
+    void   set(double v);
+    double value() const;
+  };
+
+  // Millisecond samples since the last publish, counted on quarter octave
+  // buckets from 1/16ms to 1s (and one over that). Percentiles are the
+  // bucket upper bound, within 19% of the sample
+  class histogram {
+  public:
+    static constexpr unsigned int buckets = 58u;
+
+    struct summary {
+      uint64_t count{0u};
+      double   mean{0.0};
+      double   min{0.0};
+      double   max{0.0};
+      double   p50{0.0};
+      double   p95{0.0};
+      double   p99{0.0};
+    };
+
+  private:
+    std::atomic<uint32_t> m_counts[buckets]{};
+    std::atomic<double>   m_sum{0.0};
+    std::atomic<double>   m_min{1e300};
+    std::atomic<double>   m_max{0.0};
+
+  public:
+    void observe(double ms);
+
+    // Summary of the samples since the last take, and start over
+    summary take();
+  };
+
+  // Shared segment layout. The writer never waits: sequence is odd while
+  // it writes, readers copy text and retry if sequence was odd or changed
+  // meanwhile (a seqlock)
+  static constexpr uint32_t magic    = 0x474F4D49u; // "IMOG"
+  static constexpr uint32_t version  = 1u;
+  static constexpr size_t   capacity = 64u << 10;
+
+  struct segment {
+    uint32_t              magic;
+    uint32_t              version;
+    std::atomic<uint32_t> sequence;
+    std::atomic<uint32_t> size;
+    std::atomic<uint64_t> frame;
+    char                  text[capacity];
+  };
+  static_assert(std::atomic<uint32_t>::is_always_lock_free &&
+                    std::atomic<uint64_t>::is_always_lock_free,
+                "Shared between processes, no locks inside");
+
+private:
+  template <typename T>
+  using registry = std::vector<std::pair<std::string, std::unique_ptr<T>>>;
+
+  static std::mutex          m_mutex; // Registration and publish
+  static registry<counter>   m_counters;
+  static registry<gauge>     m_gauges;
+  static registry<histogram> m_histograms;
+
+  static std::atomic<uint64_t>         m_frames;
+  static uint64_t                      m_published; // Frame of last publish
+  static TimePoint                     m_start;
+  static std::string                   m_line;
+  static std::FILE*                    m_file;
+  static std::unique_ptr<SharedMemory> m_shared;
+
+  // Find or add a metric by name
+  template <typename T>
+  static T& find(registry<T>& metrics, const std::string& name);
+
+  // Write the metrics as a JSON line on m_line
+  static void format(uint64_t frame);
+
+public:
+  // Open the file and the segment of Settings. Without any, frame() only
+  // counts frames
+  static void init();
+
+  // Publish what is left, flush and close them. The segment is removed
+  static void close();
+
+  // Metric of that name, added on first use. References stay valid
+  static counter&   findCounter(const std::string& name);
+  static gauge&     findGauge(const std::string& name);
+  static histogram& findHistogram(const std::string& name);
+
+  // A frame is done. Publishes every Settings::metricsFrames frames
+  static void frame();
+
+  // Publish now
+  static void publish();
+
+  // Monitor side: copy of the last line published on the segment name,
+  // empty if there is none (yet)
+  static std::string read(const std::string& name);
+};
+
+} // namespace imog
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpptools_IDMap.hpp"
+#include "cpptools_Strings.hpp"
+
+namespace imog {
+
+// Generational index to an object stored on a Registry. A handle whose slot
+// has been reused by other object is stale and resolves to null.
+template <typename T>
+struct Handle {
+  unsigned int index{~0u};
+  unsigned int generation{0u};
+
+  bool valid() const { return index != ~0u; }
+  bool operator==(const Handle& h) const {
+    return index == h.index && generation == h.generation;
+  }
+  bool operator!=(const Handle& h) const { return !(*this == h); }
+};
+
+template <typename T>
+class Registry {
+
+  struct slot {
+    std::shared_ptr<T> obj;
+    unsigned int       generation;
+  };
+
+private:
+  bool                      m_caseSensitive;
+  unsigned int              m_count;
+  std::vector<slot>         m_slots;
+  std::vector<unsigned int> m_free;
+  IDMap<Handle<T>>          m_names; // Interned name hash -> handle
+
+  // Interned form of a name, normalized once at load time
+  std::string intern(const std::string& name) const {
+    return (m_caseSensitive) ? name : Strings::toLower(name);
+  }
+
+public:
+  Registry(bool caseSensitive = false)
+      : m_caseSensitive(caseSensitive), m_count(0u) {}
+
+  // Store an object and get its handle. Optionally link a name to it
+  Handle<T> add(const std::shared_ptr<T>& obj, const std::string& name = "") {
+    Handle<T> h;
+    if (!m_free.empty()) {
+      h.index = m_free.back();
+      m_free.pop_back();
+    } else {
+      h.index = m_slots.size();
+      m_slots.push_back({nullptr, 0u});
+    }
+    h.generation         = m_slots[h.index].generation;
+    m_slots[h.index].obj = obj;
+    ++m_count;
+
+    if (!name.empty()) alias(name, h);
+    return h;
+  }
+
+  // Link an extra name to a handle
+  void alias(const std::string& name, Handle<T> h) {
+    m_names.set(intern(name), h);
+  }
+
+  // Remove object from registry, its handles and names become stale
+  void remove(Handle<T> h) {
+    if (!get(h)) return;
+    m_slots[h.index].obj = nullptr;
+    ++m_slots[h.index].generation;
+    m_free.push_back(h.index);
+    --m_count;
+  }
+
+  // Search a handle by name. Meant for load time, NOT for per-frame code
+  Handle<T> find(const std::string& name) const {
+    auto h = m_names.find(intern(name));
+    return (h && get(*h)) ? *h : Handle<T>{};
+  }
+
+  // Resolve a handle: two compares and an index, no strings involved
+  const std::shared_ptr<T>& get(Handle<T> h) const {
+    static const std::shared_ptr<T> null{nullptr};
+    if (h.index >= m_slots.size()) return null;
+    const auto& s = m_slots[h.index];
+    return (s.generation == h.generation) ? s.obj : null;
+  }
+
+  // Number of live objects
+  size_t size() const { return m_count; }
+
+  // Call fn over all live objects
+  template <typename Fn>
+  void each(Fn fn) const {
+    for (const auto& s : m_slots) {
+      if (s.obj) fn(s.obj);
+    }
+  }
+};
+
+} // namespace imog
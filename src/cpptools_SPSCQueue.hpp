@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+namespace imog {
+
+// Lock-free bounded queue for ONE producer thread and ONE consumer thread.
+// N must be a power of two. Items are copied in and out, keep them small.
+template <typename T, size_t N>
+class SPSCQueue {
+  static_assert(N > 1 && (N & (N - 1)) == 0, "N must be a power of two");
+
+private:
+  std::array<T, N> m_buffer;
+
+  // Each index is written by one side only, keep them on its own cache line
+  alignas(64) std::atomic<size_t> m_head{0}; // Next slot to pop (consumer)
+  alignas(64) std::atomic<size_t> m_tail{0}; // Next slot to push (producer)
+
+public:
+  // Producer: enqueue a copy of item, false if queue is full
+  bool push(const T& item) {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == N) return false;
+    m_buffer[tail & (N - 1)] = item;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer: dequeue the oldest item into out, false if queue is empty
+  bool pop(T& out) {
+    auto head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) return false;
+    out = m_buffer[head & (N - 1)];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer: call fn with every queued item in push order
+  template <typename Fn>
+  void drain(Fn fn) {
+    T item;
+    while (pop(item)) fn(item);
+  }
+};
+
+} // namespace imog
@@ -0,0 +1,107 @@
+#include "cpptools_SharedMemory.hpp"
+
+#include <cstdint>
+
+#if _WIN64
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Create the segment, size bytes zeroed, or open an existing one with its
+// own size (size 0). Check ok() to know if it was mapped
+// ====================================================================== //
+
+#if _WIN64
+
+SharedMemory::SharedMemory(const std::string& name, size_t size)
+    : m_data(nullptr),
+      m_size(0u),
+      m_owner(size > 0u),
+      m_name("Local\\" + name),
+      m_mapping(nullptr) {
+
+  if (m_owner) {
+    auto high = static_cast<DWORD>(static_cast<uint64_t>(size) >> 32);
+    auto low  = static_cast<DWORD>(size & 0xFFFFFFFFu);
+    m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE,
+                                   nullptr,
+                                   PAGE_READWRITE,
+                                   high,
+                                   low,
+                                   m_name.c_str());
+  } else {
+    m_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, m_name.c_str());
+  }
+  if (!m_mapping) return;
+
+  auto access = (m_owner) ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ;
+  m_data      = (char*)MapViewOfFile(m_mapping, access, 0, 0, 0);
+  if (!m_data) return;
+
+  MEMORY_BASIC_INFORMATION info;
+  VirtualQuery(m_data, &info, sizeof(info));
+  m_size = (m_owner) ? size : static_cast<size_t>(info.RegionSize);
+}
+
+#else
+
+SharedMemory::SharedMemory(const std::string& name, size_t size)
+    : m_data(nullptr), m_size(0u), m_owner(size > 0u), m_name("/" + name) {
+
+  auto fd = (m_owner) ? shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0644)
+                      : shm_open(m_name.c_str(), O_RDONLY, 0);
+  if (fd < 0) return;
+
+  struct stat st;
+  if (m_owner && ftruncate(fd, 0) == 0 && ftruncate(fd, size) == 0) {
+    st.st_size = size;
+  } else if (m_owner || fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return;
+  }
+
+  auto  prot = (m_owner) ? PROT_READ | PROT_WRITE : PROT_READ;
+  void* ptr  = mmap(nullptr, st.st_size, prot, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) return;
+
+  m_data = static_cast<char*>(ptr);
+  m_size = static_cast<size_t>(st.st_size);
+}
+
+#endif
+
+// ====================================================================== //
+// ====================================================================== //
+// Unmap it, and remove it if created here
+// ====================================================================== //
+
+SharedMemory::~SharedMemory() {
+#if _WIN64
+  if (m_data) UnmapViewOfFile(m_data);
+  if (m_mapping) CloseHandle(m_mapping);
+#else
+  if (m_data) munmap(m_data, m_size);
+  if (m_owner) shm_unlink(m_name.c_str());
+#endif
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Getters
+// ====================================================================== //
+
+bool   SharedMemory::ok() const { return m_data != nullptr; }
+char*  SharedMemory::data() const { return m_data; }
+size_t SharedMemory::size() const { return m_size; }
+
+} // namespace imog
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace imog {
+
+// Named memory segment other local processes can map, with the same name
+// on every platform ("imog_metrics"). Unmapped on destruction, and removed
+// by the process that created it
+class SharedMemory {
+
+private:
+  char*       m_data;
+  size_t      m_size;
+  bool        m_owner;
+  std::string m_name;
+#if _WIN64
+  void* m_mapping;
+#endif
+
+public:
+  // Create the segment, size bytes zeroed, or open an existing one with
+  // its own size (size 0). Check ok() to know if it was mapped
+  SharedMemory(const std::string& name, size_t size = 0u);
+
+  // Unmap it, and remove it if created here
+  ~SharedMemory();
+
+  SharedMemory(const SharedMemory&) = delete;
+  SharedMemory& operator=(const SharedMemory&) = delete;
+
+  // Was the segment mapped?
+  bool ok() const;
+
+  // Getter for data
+  char* data() const;
+
+  // Getter for size (bytes)
+  size_t size() const;
+};
+
+} // namespace imog
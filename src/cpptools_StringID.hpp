@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+namespace imog {
+
+// 64 bit FNV-1a hash of a name. Literals hash at compile time (constexpr),
+// runtime strings hash once when converted. Keeps a pointer to the chars to
+// be able to query OpenGL or check collisions, so it must NOT outlive them.
+class StringID {
+
+private:
+  uint64_t    m_hash;
+  const char* m_str;
+
+  static constexpr uint64_t g_basis = 14695981039346656037ull;
+  static constexpr uint64_t g_prime = 1099511628211ull;
+
+public:
+  // Hash n chars, optionally folding ASCII upper case to lower case
+  static constexpr uint64_t hash(const char* s, size_t n, bool fold = false) {
+    uint64_t h = g_basis;
+    for (size_t i = 0u; i < n; ++i) {
+      auto c = static_cast<unsigned char>(s[i]);
+      if (fold && c >= 'A' && c <= 'Z') c += 'a' - 'A';
+      h = (h ^ c) * g_prime;
+    }
+    return h;
+  }
+
+  // From a literal, hashed at compile time
+  template <size_t N>
+  constexpr StringID(const char (&s)[N]) : m_hash(hash(s, N - 1u)), m_str(s) {}
+
+  // From a runtime string
+  StringID(const std::string& s)
+      : m_hash(hash(s.data(), s.size())), m_str(s.c_str()) {}
+
+  // From a precomputed hash and its chars
+  constexpr StringID(uint64_t h, const char* s) : m_hash(h), m_str(s) {}
+
+  constexpr uint64_t    value() const { return m_hash; }
+  constexpr const char* str() const { return m_str; }
+
+  constexpr bool operator==(const StringID& id) const {
+    return m_hash == id.m_hash;
+  }
+  constexpr bool operator!=(const StringID& id) const {
+    return m_hash != id.m_hash;
+  }
+};
+
+static_assert(StringID::hash("a", 1u) == 0xaf63dc4c8601ec8cull,
+              "StringID must hash as FNV-1a 64, at compile time");
+
+// "name"_id, same as StringID("name")
+constexpr StringID operator"" _id(const char* s, size_t n) {
+  return StringID(StringID::hash(s, n), s);
+}
+
+} // namespace imog
@@ -1,7 +1,7 @@
 #include "cpptools_Strings.hpp"
 
+#include <cctype>
 #include <fstream>
-#include <locale>
 
 namespace imog {
 
@@ -49,11 +49,8 @@ std::vector<std::string> Strings::split(const std::string& str,
 // ====================================================================== //
 
 std::string Strings::toLower(const std::string& str) {
-  std::locale loc;
-  std::string out;
-
-  for (auto c : str) out += std::tolower(c, loc);
-
+  std::string out(str);
+  for (auto& c : out) c = std::tolower(static_cast<unsigned char>(c));
   return out;
 }
 
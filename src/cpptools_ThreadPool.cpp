@@ -0,0 +1,95 @@
+#include "cpptools_ThreadPool.hpp"
+
+#include <algorithm>
+
+#include "cpptools_Logger.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Worker thread body. Leaves once stopping and the queue is empty
+// ====================================================================== //
+
+void ThreadPool::workerLoop() {
+  while (true) {
+    jobFn job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [&]() { return m_stop || !m_jobs.empty(); });
+      if (m_jobs.empty()) return;
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+      ++m_busy;
+    }
+
+    try {
+      job();
+    } catch (std::exception& e) { LOGE("Fail on pool job: {}", e.what()); }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    --m_busy;
+    if (m_busy == 0u && m_jobs.empty()) m_idle.notify_all();
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Launch threads workers, 0 is one per core but one (at least one)
+// ====================================================================== //
+
+ThreadPool::ThreadPool(unsigned int threads) : m_busy(0u), m_stop(false) {
+  if (threads == 0u) {
+    auto cores = std::thread::hardware_concurrency();
+    threads    = std::max(cores, 2u) - 1u;
+  }
+  for (auto i = 0u; i < threads; ++i) {
+    m_threads.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Destructor. Runs what is queued and joins the workers
+// ====================================================================== //
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (auto& t : m_threads) t.join();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Queue a job for the next free worker
+// ====================================================================== //
+
+void ThreadPool::submit(jobFn job) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.push_back(std::move(job));
+  }
+  m_wake.notify_one();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Block until every queued job is done
+// ====================================================================== //
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_idle.wait(lock, [&]() { return m_busy == 0u && m_jobs.empty(); });
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Number of workers
+// ====================================================================== //
+
+unsigned int ThreadPool::size() const { return m_threads.size(); }
+
+} // namespace imog
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace imog {
+
+// Fixed set of worker threads running queued jobs in submit order. Jobs
+// must not touch OpenGL, hand their results to the render thread instead.
+// Destruction runs what is queued and joins the workers.
+class ThreadPool {
+  using jobFn = std::function<void(void)>;
+
+private:
+  std::vector<std::thread> m_threads;
+  std::deque<jobFn>        m_jobs;
+  std::mutex               m_mutex;
+  std::condition_variable  m_wake; // Jobs queued or stopping
+  std::condition_variable  m_idle; // Queue empty and nobody busy
+  unsigned int             m_busy;
+  bool                     m_stop;
+
+  // Worker thread body
+  void workerLoop();
+
+public:
+  // Launch threads workers, 0 is one per core but one (at least one)
+  explicit ThreadPool(unsigned int threads = 0u);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Queue a job for the next free worker
+  void submit(jobFn job);
+
+  // Block until every queued job is done
+  void wait();
+
+  // Number of workers
+  unsigned int size() const;
+};
+
+} // namespace imog
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace imog {
+
+// Latest value handoff from ONE writer thread to ONE reader thread, no
+// locks. The writer fills its back slot and publishes it, the reader
+// takes the newest published slot. Neither side ever waits, and a slot
+// is never written while the reader holds it.
+template <typename T>
+class TripleBuffer {
+  static constexpr uint8_t fresh = 4u; // Middle slot not taken yet
+
+private:
+  std::array<T, 3> m_slots{};
+
+  alignas(64) std::atomic<uint8_t> m_middle{1u}; // Slot index | fresh
+  alignas(64) uint8_t m_back{0u};                // Writer only
+  alignas(64) uint8_t m_front{2u};               // Reader only
+
+public:
+  // Writer: slot to fill, keeps what it had two publishes ago
+  T& back() { return m_slots[m_back]; }
+
+  // Writer: hand the back slot to the reader
+  void publish() {
+    auto prev = m_middle.exchange(m_back | fresh, std::memory_order_acq_rel);
+    m_back    = prev & ~fresh;
+  }
+
+  // Reader: take the newest published slot, if any. True if it changed
+  bool update() {
+    if (!(m_middle.load(std::memory_order_relaxed) & fresh)) return false;
+    auto prev = m_middle.exchange(m_front, std::memory_order_acq_rel);
+    m_front   = prev & ~fresh;
+    return true;
+  }
+
+  // Reader: slot taken on last update
+  const T& front() const { return m_slots[m_front]; }
+};
+
+} // namespace imog
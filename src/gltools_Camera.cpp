@@ -14,12 +14,17 @@ namespace imog {
 // ====================================================================== //
 
 Camera::Camera(float speed, float fov)
-    : m_fov(fov), m_offset(0.f), m_centeredOnTarget(false), speed(speed) {
+    : m_fov(fov),
+      m_offset(0.f),
+      m_centeredOnTarget(false),
+      m_scene(nullptr),
+      m_target(SceneGraph::none),
+      speed(speed) {
 
   pivot.rot = glm::vec3(Settings::mainCameraRot, 0.0f);
 }
 
-Camera::~Camera() { this->target.reset(); }
+Camera::~Camera() {}
 
 
 // ====================================================================== //
@@ -37,17 +42,28 @@ glm::mat4 Camera::view() const { return m_view; }
 glm::mat4 Camera::proj() const { return m_proj; }
 glm::mat4 Camera::viewproj() const { return m_viewproj; }
 
+// ====================================================================== //
+// ====================================================================== //
+// Follow a scene node, or stop following with SceneGraph::none
+// ====================================================================== //
+
+void Camera::follow(const SceneGraph* scene, SceneGraph::node target) {
+  if (scene) m_scene = scene;
+  m_target = target;
+}
+bool Camera::following() const { return m_target != SceneGraph::none; }
+
 // ====================================================================== //
 // ====================================================================== //
 // Radian based zoom == fov variation
 // ====================================================================== //
 
 void Camera::zoom(float variation) {
-  if (glfwGetKey(IO::window(), GLFW_KEY_Z) == GLFW_PRESS) {
+  if (IO::keyboardIsDown(GLFW_KEY_Z)) {
     m_offset.z += variation;
-  } else if (glfwGetKey(IO::window(), GLFW_KEY_X) == GLFW_PRESS) {
+  } else if (IO::keyboardIsDown(GLFW_KEY_X)) {
     m_offset.x += variation;
-  } else if (glfwGetKey(IO::window(), GLFW_KEY_Y) == GLFW_PRESS) {
+  } else if (IO::keyboardIsDown(GLFW_KEY_Y)) {
     m_offset.y += variation;
   } else {
     m_fov += glm::radians(variation);
@@ -62,14 +78,16 @@ void Camera::zoom(float variation) {
 void Camera::frame() {
   static glm::vec3 modY;
 
-  if (this->target) {
+  auto target = m_target.load();
+  if (target != SceneGraph::none) {
+    auto targetPos = glm::vec3(m_scene->world(target)[3]);
     // Get center of the skeleton
     if (!m_centeredOnTarget) {
       m_centeredOnTarget = true;
-      modY               = pivot.up() * this->target->pos.y;
+      modY               = pivot.up() * targetPos.y;
     }
     // Follow on XZ
-    pivot.pos = (this->target->pos * Math::vecXZ) + modY;
+    pivot.pos = (targetPos * Math::vecXZ) + modY;
   } else {
     m_centeredOnTarget = false;
   }
@@ -82,7 +100,7 @@ void Camera::frame() {
   auto modZ = pivot.front() * Settings::mainCameraPos.z;
   auto eye  = pivot.pos - modZ;
 
-  auto modX = (this->cinemaLike && this->target)
+  auto modX = (this->cinemaLike && target != SceneGraph::none)
                   ? pivot.right() * Settings::mainCameraPos.x
                   : Math::nullVec;
 
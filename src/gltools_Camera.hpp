@@ -1,9 +1,11 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 
 #include "gltools_Math.hpp"
 #include "gltools_Transform.hpp"
+#include "gltools_SceneGraph.hpp"
 
 
 namespace imog {
@@ -21,10 +23,13 @@ private:
   glm::vec3 m_offset;
   bool      m_centeredOnTarget;
 
+  // Scene node followed on XZ, read after the scene update of the frame
+  const SceneGraph*             m_scene;
+  std::atomic<SceneGraph::node> m_target;
+
 public:
   float                      speed;
   Transform                  pivot;
-  std::shared_ptr<Transform> target;
   Transform                  transform;
   bool                       cinemaLike;
 
@@ -41,6 +46,10 @@ public:
   // Getter for viewproj
   glm::mat4 viewproj() const;
 
+  // Follow a scene node, or stop following with SceneGraph::none
+  void follow(const SceneGraph* scene, SceneGraph::node target);
+  bool following() const;
+
   // Modify camera fov (a.k.a. zoom)
   void zoom(float variation);
 
@@ -0,0 +1,266 @@
+#include "gltools_DebugDraw.hpp"
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <glm/gtc/packing.hpp>
+
+#include "cpptools_Logger.hpp"
+#include "gltools_Shader.hpp"
+#include "gltools_GLState.hpp"
+#include "gltools_Renderable.hpp"
+#include "helpers/GLAssert.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Geometry of one thread. Emitted vertices are only touched by the owner
+// thread, the committed ones are shared with flush under the mutex
+// ====================================================================== //
+
+struct threadBuffer {
+  std::vector<DebugDraw::vertex> emitted[2]; // Depth tested, on top
+  std::vector<DebugDraw::vertex> committed[2];
+  std::mutex                     mutex;
+  bool                           alive{true};
+};
+
+static std::mutex                                 g_buffersMutex;
+static std::vector<std::shared_ptr<threadBuffer>> g_buffers;
+
+// Gathered by flush, kept to reuse its memory
+static std::vector<DebugDraw::vertex> g_frame[2];
+static size_t                         g_frameSize = 0u;
+
+// ====================================================================== //
+// ====================================================================== //
+// Buffer of the calling thread. Registered on first use, its geometry is
+// dropped when the thread ends
+// ====================================================================== //
+
+struct threadOwner {
+  std::shared_ptr<threadBuffer> buf{std::make_shared<threadBuffer>()};
+
+  threadOwner() {
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+    g_buffers.push_back(buf);
+  }
+  ~threadOwner() {
+    std::lock_guard<std::mutex> lock(buf->mutex);
+    buf->alive = false;
+    for (auto& c : buf->committed) c.clear();
+  }
+};
+
+static threadBuffer& local() {
+  thread_local threadOwner owner;
+  return *owner.buf;
+}
+
+static uint32_t pack(const glm::vec3& color) {
+  return glm::packUnorm4x8(glm::vec4(color, 1.f));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Segment from a to b
+// ====================================================================== //
+
+void DebugDraw::line(const glm::vec3& a,
+                     const glm::vec3& b,
+                     const glm::vec3& color,
+                     bool             onTop) {
+  auto& v = local().emitted[onTop];
+  auto  c = pack(color);
+  v.push_back({a, c});
+  v.push_back({b, c});
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Three axis aligned segments crossing at p
+// ====================================================================== //
+
+void DebugDraw::point(const glm::vec3& p,
+                      const glm::vec3& color,
+                      float            size,
+                      bool             onTop) {
+  auto& v = local().emitted[onTop];
+  auto  c = pack(color);
+  auto  h = size * 0.5f;
+  for (auto axis = 0u; axis < 3u; ++axis) {
+    glm::vec3 d(0.f);
+    d[axis] = h;
+    v.push_back({p - d, c});
+    v.push_back({p + d, c});
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Edges of a bounding box moved by model. Corner i takes the max of the
+// axes set on its bits, edges join corners one bit apart
+// ====================================================================== //
+
+void DebugDraw::box(const glm::vec3& bmin,
+                    const glm::vec3& bmax,
+                    const glm::vec3& color,
+                    const glm::mat4& model,
+                    bool             onTop) {
+  glm::vec3 corners[8];
+  for (auto i = 0u; i < 8u; ++i) {
+    glm::vec3 p((i & 1u) ? bmax.x : bmin.x,
+                (i & 2u) ? bmax.y : bmin.y,
+                (i & 4u) ? bmax.z : bmin.z);
+    corners[i] = glm::vec3(model * glm::vec4(p, 1.f));
+  }
+
+  auto& v = local().emitted[onTop];
+  auto  c = pack(color);
+  for (auto i = 0u; i < 8u; ++i) {
+    for (auto bit = 1u; bit < 8u; bit <<= 1u) {
+      if (i & bit) continue;
+      v.push_back({corners[i], c});
+      v.push_back({corners[i | bit], c});
+    }
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// X, Y, Z axes (red, green, blue) of model
+// ====================================================================== //
+
+void DebugDraw::axes(const glm::mat4& model, float size, bool onTop) {
+  static const glm::vec3 colors[3] = {
+      {1.f, 0.f, 0.f}, {0.f, 1.f, 0.f}, {0.f, 0.f, 1.f}};
+
+  glm::vec3 origin(model[3]);
+  for (auto axis = 0u; axis < 3u; ++axis) {
+    auto tip = origin + glm::vec3(model[axis]) * size;
+    line(origin, tip, colors[axis], onTop);
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Vector v from origin
+// ====================================================================== //
+
+void DebugDraw::vec(const glm::vec3& v,
+                    const glm::vec3& color,
+                    const glm::vec3& origin,
+                    bool             onTop) {
+  line(origin, origin + v, color, onTop);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Publish what the calling thread emitted since its last commit. Swap
+// keeps the memory of both sides
+// ====================================================================== //
+
+void DebugDraw::commit() {
+  auto& buf = local();
+  {
+    std::lock_guard<std::mutex> lock(buf.mutex);
+    for (auto i = 0u; i < 2u; ++i) buf.committed[i].swap(buf.emitted[i]);
+  }
+  for (auto& e : buf.emitted) e.clear();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Commit the calling thread and draw every thread last commit, copied
+// to the frame stream: depth tested lines first, then the on top ones
+// ====================================================================== //
+
+unsigned int DebugDraw::flush() {
+  commit();
+
+  for (auto& f : g_frame) f.clear();
+  {
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+    for (auto it = g_buffers.begin(); it != g_buffers.end();) {
+      auto                        buf = *it; // Alive past the erase
+      std::lock_guard<std::mutex> bufLock(buf->mutex);
+      if (!buf->alive) {
+        it = g_buffers.erase(it);
+        continue;
+      }
+      for (auto i = 0u; i < 2u; ++i) {
+        const auto& c = buf->committed[i];
+        g_frame[i].insert(g_frame[i].end(), c.begin(), c.end());
+      }
+      ++it;
+    }
+  }
+
+  g_frameSize = g_frame[0].size() + g_frame[1].size();
+  if (g_frameSize == 0u) return 0u;
+
+  static auto shaderHandle = Shader::find("debug");
+  const auto& shader       = Shader::get(shaderHandle);
+  if (!shader) return 0u;
+
+  auto span = Renderable::stream.alloc(g_frameSize * sizeof(vertex));
+  if (!span.data) {
+    LOGE("No room for {} debug vertices this frame.", g_frameSize);
+    return 0u;
+  }
+  auto dst = static_cast<vertex*>(span.data);
+  std::memcpy(dst, g_frame[0].data(), g_frame[0].size() * sizeof(vertex));
+  std::memcpy(dst + g_frame[0].size(),
+              g_frame[1].data(),
+              g_frame[1].size() * sizeof(vertex));
+  Renderable::stream.flush();
+
+  // Attributes point to this frame range, the stream buffer may change
+  static unsigned int vao = 0u;
+  if (!vao) { GL_ASSERT(glGenVertexArrays(1, &vao)); }
+  GLState::bindVertexArray(vao);
+  GL_ASSERT(glBindBuffer(GL_ARRAY_BUFFER, Renderable::stream.buffer()));
+  GL_ASSERT(glEnableVertexAttribArray(0));
+  GL_ASSERT(glVertexAttribPointer(0,
+                                  3,
+                                  GL_FLOAT,
+                                  GL_FALSE,
+                                  sizeof(vertex),
+                                  (void*)(span.offset)));
+  GL_ASSERT(glEnableVertexAttribArray(1));
+  GL_ASSERT(glVertexAttribPointer(
+      1,
+      4,
+      GL_UNSIGNED_BYTE,
+      GL_TRUE,
+      sizeof(vertex),
+      (void*)(span.offset + offsetof(vertex, color))));
+  GL_ASSERT(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+  shader->bind();
+  auto draws = 0u;
+  if (!g_frame[0].empty()) {
+    GL_ASSERT(glDrawArrays(GL_LINES, 0, g_frame[0].size()));
+    ++draws;
+  }
+  if (!g_frame[1].empty()) {
+    GLState::disable(GL_DEPTH_TEST);
+    GL_ASSERT(glDrawArrays(GL_LINES, g_frame[0].size(), g_frame[1].size()));
+    GLState::enable(GL_DEPTH_TEST);
+    ++draws;
+  }
+  GLState::bindVertexArray(0u);
+  return draws;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Vertices drawn on last flush
+// ====================================================================== //
+
+size_t DebugDraw::size() { return g_frameSize; }
+
+} // namespace imog
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+#include "gltools_Math.hpp"
+
+namespace imog {
+
+// Debug geometry (lines, points, boxes, axes) from any thread, drawn as
+// lines in one call (plus one for on top geometry). Emitting only appends
+// vertices to a buffer of the calling thread: no locks and no OpenGL.
+// Each thread publishes what it emitted with commit(), and flush() draws
+// the last commit of every thread, so a slower animation thread keeps its
+// geometry on screen between its frames.
+class DebugDraw {
+
+public:
+  // Interleaved vertex, color packed as RGBA8
+  struct vertex {
+    glm::vec3 pos;
+    uint32_t  color;
+  };
+
+  // Segment from a to b
+  static void line(const glm::vec3& a,
+                   const glm::vec3& b,
+                   const glm::vec3& color,
+                   bool             onTop = false);
+
+  // Three axis aligned segments crossing at p
+  static void point(const glm::vec3& p,
+                    const glm::vec3& color,
+                    float            size  = 1.f,
+                    bool             onTop = false);
+
+  // Edges of a bounding box moved by model
+  static void box(const glm::vec3& bmin,
+                  const glm::vec3& bmax,
+                  const glm::vec3& color,
+                  const glm::mat4& model = glm::mat4(1.f),
+                  bool             onTop = false);
+
+  // X, Y, Z axes (red, green, blue) of model
+  static void axes(const glm::mat4& model,
+                   float            size  = 1.f,
+                   bool             onTop = false);
+
+  // Vector v from origin
+  static void vec(const glm::vec3& v,
+                  const glm::vec3& color,
+                  const glm::vec3& origin = glm::vec3(0.f),
+                  bool             onTop  = false);
+
+  // Publish what the calling thread emitted since its last commit
+  static void commit();
+
+  // Commit the calling thread and draw every thread last commit on the
+  // frame stream. Render thread only, before the stream ends the frame.
+  // Returns the number of draw calls
+  static unsigned int flush();
+
+  // Vertices drawn on last flush
+  static size_t size();
+};
+
+} // namespace imog
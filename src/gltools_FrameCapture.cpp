@@ -0,0 +1,200 @@
+#include "gltools_FrameCapture.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "cpptools_Files.hpp"
+#include "cpptools_Image.hpp"
+#include "cpptools_Logger.hpp"
+#include "helpers/GLAssert.hpp"
+
+namespace imog {
+
+// * private
+
+// ====================================================================== //
+// ====================================================================== //
+// (Re)create both pixel buffers for current size
+// ====================================================================== //
+
+void FrameCapture::createBuffers() {
+  if (m_pbos[0]) { GL_ASSERT(glDeleteBuffers(2, m_pbos)); }
+  GL_ASSERT(glGenBuffers(2, m_pbos));
+
+  auto size = static_cast<size_t>(m_width) * m_height * 4u;
+  for (auto pbo : m_pbos) {
+    GL_ASSERT(glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo));
+    GL_ASSERT(glBufferData(
+        GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ));
+  }
+  GL_ASSERT(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Map the pending frame (read one frame ago) and queue it for the writer.
+// Waits for a free slot if the writer is behind
+// ====================================================================== //
+
+void FrameCapture::readPending() {
+  if (!m_pending) return;
+  m_pending = false;
+
+  auto size = static_cast<size_t>(m_width) * m_height * 4u;
+  GL_ASSERT(glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[m_pbo ^ 1u]));
+  auto src = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+  if (!src) {
+    LOGE("Couldn't map captured frame {}", m_pendingIndex);
+    GL_ASSERT(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    return;
+  }
+
+  unsigned int slot;
+  while (!m_free.pop(slot)) std::this_thread::yield();
+
+  auto& f  = m_frames[slot];
+  f.width  = m_width;
+  f.height = m_height;
+  f.index  = m_pendingIndex;
+  f.pixels.resize(size);
+  std::memcpy(f.pixels.data(), src, size);
+
+  GL_ASSERT(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+  GL_ASSERT(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+  m_ready.push(slot);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Writer thread body. Runs until finish, writing what is left before
+// leaving
+// ====================================================================== //
+
+void FrameCapture::writeLoop() {
+  auto ext = (m_format == format::png) ? ".png" : ".rgba";
+
+  auto write = [&](unsigned int slot) {
+    const auto& f = m_frames[slot];
+    char        name[32];
+    std::snprintf(name, sizeof(name), "frame_%06u", f.index);
+    auto path = m_dir + name + ext;
+
+    // Rows come bottom to top from OpenGL
+    if (m_format == format::png) {
+      Image::writePNG(path, f.width, f.height, f.pixels.data(), true);
+    } else {
+      Image::writeRaw(path, f.width, f.height, f.pixels.data(), true);
+    }
+    m_free.push(slot);
+    ++m_written;
+  };
+
+  unsigned int slot;
+  while (true) {
+    if (m_ready.pop(slot)) {
+      write(slot);
+    } else if (!m_writing) {
+      m_ready.drain(write);
+      break;
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+
+// * public
+
+// ====================================================================== //
+// ====================================================================== //
+// Param constructor. Needs a current context, launches the writer
+// ====================================================================== //
+
+FrameCapture::FrameCapture(const std::string& dir,
+                           format             fmt,
+                           int                width,
+                           int                height)
+    : m_dir(dir),
+      m_format(fmt),
+      m_width(width),
+      m_height(height),
+      m_pbos{0u, 0u},
+      m_pbo(0u),
+      m_pending(false),
+      m_pendingIndex(0u),
+      m_captured(0u),
+      m_writing(true),
+      m_written(0u) {
+  if (!m_dir.empty() && m_dir.back() != '/') m_dir += '/';
+  Files::makeDir(m_dir);
+
+  for (auto i = 0u; i < slots; ++i) m_free.push(i);
+  this->createBuffers();
+  m_writer = std::thread(&FrameCapture::writeLoop, this);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Destructor. Writes what is left
+// ====================================================================== //
+
+FrameCapture::~FrameCapture() {
+  this->finish();
+  if (m_pbos[0]) { GL_ASSERT(glDeleteBuffers(2, m_pbos)); }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Read the bound framebuffer to a pixel buffer (async) and queue the frame
+// read on the previous call, which is done by now
+// ====================================================================== //
+
+void FrameCapture::capture() {
+  if (!m_writer.joinable()) return;
+
+  GL_ASSERT(glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[m_pbo]));
+  GL_ASSERT(glReadPixels(
+      0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+  GL_ASSERT(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+
+  this->readPending();
+  m_pending      = true;
+  m_pendingIndex = m_captured++;
+  m_pbo ^= 1u;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Change frame size. The pending frame is queued with the old one
+// ====================================================================== //
+
+void FrameCapture::resize(int width, int height) {
+  if (width == m_width && height == m_height) return;
+  this->readPending();
+  m_width  = width;
+  m_height = height;
+  this->createBuffers();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Queue the pending frame and wait until every file is written
+// ====================================================================== //
+
+void FrameCapture::finish() {
+  if (!m_writer.joinable()) return;
+  this->readPending();
+  m_writing = false;
+  m_writer.join();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Getters
+// ====================================================================== //
+
+unsigned int FrameCapture::captured() const { return m_captured; }
+unsigned int FrameCapture::written() const { return m_written; }
+
+} // namespace imog
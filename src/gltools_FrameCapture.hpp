@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+#include "cpptools_SPSCQueue.hpp"
+
+namespace imog {
+
+// Saves every rendered frame to an image sequence on dir. Pixels are read
+// to one of two pixel buffers, so the copy of frame N is only mapped while
+// frame N + 1 renders and the readback doesn't stall the pipeline. A
+// writer thread encodes and writes the files. When it falls behind, the
+// render thread waits for a free slot instead of dropping frames.
+class FrameCapture {
+
+public:
+  enum struct format { png, raw };
+
+private:
+  struct frame {
+    std::vector<uint8_t> pixels;
+    int                  width;
+    int                  height;
+    unsigned int         index;
+  };
+  static constexpr size_t slots = 8u;
+
+  std::string m_dir;
+  format      m_format;
+  int         m_width;
+  int         m_height;
+
+  // Readback. The pending frame is always on the buffer not to be written
+  unsigned int m_pbos[2];
+  unsigned int m_pbo;
+  bool         m_pending;
+  unsigned int m_pendingIndex;
+  unsigned int m_captured;
+
+  // Frames handed to the writer thread and back
+  std::array<frame, slots>     m_frames;
+  SPSCQueue<unsigned int, 16u> m_ready; // Render -> writer
+  SPSCQueue<unsigned int, 16u> m_free;  // Writer -> render
+  std::atomic<bool>            m_writing;
+  std::atomic<unsigned int>    m_written;
+  std::thread                  m_writer;
+
+  // (Re)create pixel buffers for current size
+  void createBuffers();
+
+  // Map the pending frame and queue it for the writer
+  void readPending();
+
+  // Writer thread body
+  void writeLoop();
+
+public:
+  FrameCapture(const std::string& dir, format fmt, int width, int height);
+  ~FrameCapture();
+
+  FrameCapture(const FrameCapture&) = delete;
+  FrameCapture& operator=(const FrameCapture&) = delete;
+
+  // Read the bound framebuffer. Call it once the frame is drawn
+  void capture();
+
+  // Change frame size. The pending frame is queued with the old one
+  void resize(int width, int height);
+
+  // Queue the pending frame and wait until every file is written
+  void finish();
+
+  // Frames read back and written to disk
+  unsigned int captured() const;
+  unsigned int written() const;
+};
+
+} // namespace imog
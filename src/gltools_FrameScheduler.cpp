@@ -0,0 +1,219 @@
+#include "gltools_FrameScheduler.hpp"
+
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+#include "gltools_IO.hpp"
+#include "gltools_Replay.hpp"
+#include "cpptools_Logger.hpp"
+#include "cpptools_Metrics.hpp"
+#include "Settings.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Private variables definition
+// ====================================================================== //
+
+FrameScheduler::mode FrameScheduler::m_mode{FrameScheduler::mode::vsync};
+Seconds              FrameScheduler::m_period{1.0 / 60.0};
+std::atomic<bool>    FrameScheduler::m_dirty{true};
+bool                 FrameScheduler::m_window{false};
+bool                 FrameScheduler::m_idle{false};
+TimePoint            FrameScheduler::m_next{};
+TimePoint            FrameScheduler::m_begin{};
+double               FrameScheduler::m_workMs{0.0};
+
+TimePoint             FrameScheduler::m_second{};
+std::vector<float>    FrameScheduler::m_samples{};
+unsigned int          FrameScheduler::m_skipped{0u};
+FrameScheduler::stats FrameScheduler::m_stats{};
+
+// ====================================================================== //
+// ====================================================================== //
+// Mode and period from Settings, and the swap interval of the mode on the
+// current context. Synced modes take the period of the monitor refresh
+// ====================================================================== //
+
+void FrameScheduler::init(bool window) {
+  const auto& name = Settings::frameMode;
+  m_mode           = mode::vsync;
+  if (name == "target") {
+    m_mode = mode::target;
+  } else if (name == "adaptive") {
+    m_mode = mode::adaptive;
+  } else if (name != "vsync") {
+    LOGE("Unknown frame mode \"{}\", using vsync.", name);
+  }
+
+  auto rate = Settings::frameRate;
+  if (window && m_mode != mode::target) {
+    auto monitor = glfwGetPrimaryMonitor();
+    auto video   = (monitor) ? glfwGetVideoMode(monitor) : nullptr;
+    if (video && video->refreshRate > 0) rate = video->refreshRate;
+  }
+  m_period = Seconds(1.0 / std::max(rate, 1));
+  m_second = StdClock::now();
+  m_window = window;
+  if (!window) return;
+
+  auto interval = (m_mode == mode::target) ? 0 : 1;
+  if (m_mode == mode::adaptive) {
+    auto tear = glfwExtensionSupported("GLX_EXT_swap_control_tear") ||
+                glfwExtensionSupported("WGL_EXT_swap_control_tear");
+    if (tear) {
+      interval = -1;
+    } else if (!Settings::quiet) {
+      LOGD("No adaptive vsync on this driver, frames wait for vsync.");
+    }
+  }
+  glfwSwapInterval(interval);
+
+  // Edited settings show up without waiting for anything else to change
+  Settings::onReload = invalidate;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Pace in use, and its frame period
+// ====================================================================== //
+
+FrameScheduler::mode FrameScheduler::current() { return m_mode; }
+
+double FrameScheduler::periodMs() { return m_period.count() * 1000.0; }
+
+// ====================================================================== //
+// ====================================================================== //
+// Run frames only when invalidated? Replays feed input every frame,
+// recordings step the animation from the frame loop, and pollEvents asks
+// for frames nonstop
+// ====================================================================== //
+
+bool FrameScheduler::onDemand() {
+  return Settings::renderOnDemand && !Settings::pollEvents &&
+         !Replay::replaying() && !Replay::recording();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Something changed, a frame is needed. Any thread: an empty event wakes
+// the loop if it's waiting
+// ====================================================================== //
+
+void FrameScheduler::invalidate() {
+  m_dirty.store(true, std::memory_order_release);
+  if (m_window) glfwPostEmptyEvent();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Process events, waiting until the next frame is due, or until something
+// changes when idle. Synced modes don't wait here, the swap paces them
+// ====================================================================== //
+
+void FrameScheduler::waitEvents(bool paused) {
+  auto idle = onDemand() && !m_dirty.load(std::memory_order_acquire);
+  if (paused || idle) {
+    glfwWaitEvents();
+    return;
+  }
+  if (m_mode == mode::target) {
+    Seconds wait = m_next - StdClock::now();
+    if (wait.count() > 0.0) {
+      glfwWaitEventsTimeout(wait.count());
+      return;
+    }
+  }
+  glfwPollEvents();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Is a frame due? Starts it if so. Time of the previous frame is the one
+// to this start, or its own work if the loop was idle in between
+// ====================================================================== //
+
+bool FrameScheduler::begin() {
+  TimePoint now = StdClock::now();
+  if (m_mode == mode::target && now < m_next) return false;
+
+  auto dirty = m_dirty.exchange(false, std::memory_order_acq_rel);
+  if (onDemand() && !dirty) {
+    ++m_skipped;
+    m_idle = true;
+    return false;
+  }
+
+  if (m_begin != TimePoint{}) {
+    static auto& frameMs = Metrics::findHistogram("frame.ms");
+    Seconds      elapsed = now - m_begin;
+    m_samples.push_back((m_idle) ? m_workMs : elapsed.count() * 1000.0);
+    frameMs.observe(m_samples.back());
+  }
+  m_idle  = false;
+  m_begin = now;
+
+  // Keep the cadence, unless too late to catch up
+  m_next = (now - m_next < m_period) ? m_next + m_period : now + m_period;
+  return true;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// The frame is recorded. True when a second of stats was completed
+// ====================================================================== //
+
+bool FrameScheduler::end() {
+  TimePoint now     = StdClock::now();
+  Seconds   elapsed = now - m_begin;
+  m_workMs          = elapsed.count() * 1000.0;
+
+  if (now - m_second < Seconds(1.0)) return false;
+  roll(now);
+  return true;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Close a second of samples into m_stats. Percentiles are nearest rank
+// ====================================================================== //
+
+void FrameScheduler::roll(const TimePoint& now) {
+  m_stats         = stats{};
+  m_stats.frames  = static_cast<unsigned int>(m_samples.size());
+  m_stats.skipped = m_skipped;
+
+  if (!m_samples.empty()) {
+    std::sort(m_samples.begin(), m_samples.end());
+    auto n    = m_samples.size();
+    auto rank = [&](double p) {
+      auto i = static_cast<size_t>(std::ceil(p * n));
+      return m_samples[std::min(std::max(i, size_t(1)), n) - 1u];
+    };
+    auto late = static_cast<float>(1.5 * periodMs());
+
+    auto sum       = std::accumulate(m_samples.begin(), m_samples.end(), 0.0);
+    m_stats.meanMs = sum / n;
+    m_stats.p95Ms  = rank(0.95);
+    m_stats.p99Ms  = rank(0.99);
+    m_stats.maxMs  = m_samples.back();
+    m_stats.missed = static_cast<unsigned int>(
+        m_samples.end() -
+        std::upper_bound(m_samples.begin(), m_samples.end(), late));
+  }
+
+  m_samples.clear();
+  m_skipped = 0u;
+  m_second  = now;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Stats of the last complete second
+// ====================================================================== //
+
+const FrameScheduler::stats& FrameScheduler::lastStats() { return m_stats; }
+
+} // namespace imog
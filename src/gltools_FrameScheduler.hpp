@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "cpptools_Timer.hpp"
+
+namespace imog {
+
+// When the window loop runs a frame. Settings::frameMode picks the pace:
+//   vsync    : swaps wait for the display refresh
+//   adaptive : vsync, but a late frame swaps at once (and tears) instead
+//              of waiting for the next refresh. Plain vsync where the
+//              driver can't
+//   target   : no vsync, a frame every 1 / Settings::frameRate seconds
+// With Settings::renderOnDemand a frame only runs when something changed
+// since the last one: a pose, input (so the camera), settings or textures
+// still loading. Meanwhile the loop sleeps on glfwWaitEvents, no CPU nor
+// GPU use while idle. Recordings, replays and pollEvents run every frame.
+class FrameScheduler {
+
+public:
+  enum struct mode { vsync, adaptive, target };
+
+  // Frame times of the last second. A frame is missed when it takes over
+  // one and a half periods, on screen it shows a refresh late
+  struct stats {
+    unsigned int frames{0u};
+    unsigned int missed{0u};
+    unsigned int skipped{0u}; // Wake ups with nothing to draw
+    double       meanMs{0.0};
+    double       p95Ms{0.0};
+    double       p99Ms{0.0};
+    double       maxMs{0.0};
+  };
+
+private:
+  static mode              m_mode;
+  static Seconds           m_period;
+  static std::atomic<bool> m_dirty;
+  static bool              m_window;
+  static bool              m_idle;
+  static TimePoint         m_next;
+  static TimePoint         m_begin;
+  static double            m_workMs;
+
+  static TimePoint          m_second;
+  static std::vector<float> m_samples;
+  static unsigned int       m_skipped;
+  static stats              m_stats;
+
+  // Run frames only when invalidated?
+  static bool onDemand();
+
+  // Close a second of samples into m_stats
+  static void roll(const TimePoint& now);
+
+public:
+  // Mode and period from Settings, and the swap interval of the mode on
+  // the current context (none without window)
+  static void init(bool window);
+
+  // Pace in use, and its frame period
+  static mode   current();
+  static double periodMs();
+
+  // Something changed, a frame is needed. Any thread, wakes the loop
+  static void invalidate();
+
+  // Process events, waiting until the next frame is due, or until
+  // something changes when idle. Paused loops only wait for events
+  static void waitEvents(bool paused);
+
+  // Is a frame due? Starts it if so, otherwise the loop waits again
+  static bool begin();
+
+  // The frame is recorded. True when a second of stats was completed
+  static bool end();
+
+  // Stats of the last complete second
+  static const stats& lastStats();
+};
+
+} // namespace imog
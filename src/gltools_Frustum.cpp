@@ -0,0 +1,138 @@
+#include "gltools_Frustum.hpp"
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Spheres stored per component, the layout the batch test wants
+// ====================================================================== //
+
+void Frustum::spheres::push(const glm::vec4& sphere) {
+  x.push_back(sphere.x);
+  y.push_back(sphere.y);
+  z.push_back(sphere.z);
+  r.push_back(sphere.w);
+}
+
+void Frustum::spheres::clear() {
+  x.clear();
+  y.clear();
+  z.clear();
+  r.clear();
+}
+
+size_t Frustum::spheres::size() const { return x.size(); }
+
+// ====================================================================== //
+// ====================================================================== //
+// Sphere (xyz center, w radius) enclosing an AABB moved by model.
+// Radius grows with the biggest scale axis of the model
+// ====================================================================== //
+
+glm::vec4 Frustum::sphere(const glm::vec3& boundsMin,
+                          const glm::vec3& boundsMax,
+                          const glm::mat4& model) {
+  auto axis2 = [&](int i) {
+    return glm::dot(glm::vec3(model[i]), glm::vec3(model[i]));
+  };
+  auto scale  = glm::sqrt(glm::max(axis2(0), glm::max(axis2(1), axis2(2))));
+  auto center = model * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.f);
+  auto radius = glm::length(boundsMax - boundsMin) * 0.5f * scale;
+  return glm::vec4(glm::vec3(center), radius);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Planes of a viewproj matrix (Gribb & Hartmann): left, right, bottom,
+// top, near, far. Normalized so plane distances are in world units
+// ====================================================================== //
+
+Frustum::Frustum(const glm::mat4& viewproj) {
+  auto m = glm::transpose(viewproj); // Rows of viewproj as columns
+  m_planes[0] = m[3] + m[0];
+  m_planes[1] = m[3] - m[0];
+  m_planes[2] = m[3] + m[1];
+  m_planes[3] = m[3] - m[1];
+  m_planes[4] = m[3] + m[2];
+  m_planes[5] = m[3] - m[2];
+  for (auto& p : m_planes) p /= glm::length(glm::vec3(p));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// True if the sphere is (maybe) inside
+// ====================================================================== //
+
+bool Frustum::visible(const glm::vec4& s) const {
+  for (const auto& p : m_planes) {
+    if (glm::dot(glm::vec3(p), glm::vec3(s)) + p.w < -s.w) return false;
+  }
+  return true;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Test all spheres, writing 1 (visible) or 0 per sphere on out.
+// Each plane is tested on a full register of spheres at once, the tail
+// that doesn't fill a register goes one by one
+// ====================================================================== //
+
+size_t Frustum::test(const spheres& s, std::vector<uint8_t>& out) const {
+  auto n = s.size();
+  out.resize(n);
+
+  size_t i     = 0u;
+  size_t count = 0u;
+
+#if defined(__AVX__)
+  for (; i + 8u <= n; i += 8u) {
+    auto x  = _mm256_loadu_ps(&s.x[i]);
+    auto y  = _mm256_loadu_ps(&s.y[i]);
+    auto z  = _mm256_loadu_ps(&s.z[i]);
+    auto r  = _mm256_loadu_ps(&s.r[i]);
+    auto in = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (const auto& p : m_planes) {
+      auto d = _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(p.x)),
+                        _mm256_mul_ps(y, _mm256_set1_ps(p.y))),
+          _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(p.z)),
+                        _mm256_add_ps(r, _mm256_set1_ps(p.w))));
+      auto ge = _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ);
+      in      = _mm256_and_ps(in, ge);
+    }
+    auto mask = _mm256_movemask_ps(in);
+    for (auto k = 0u; k < 8u; ++k) out[i + k] = (mask >> k) & 1;
+    count += __builtin_popcount(mask);
+  }
+#elif defined(__SSE2__)
+  for (; i + 4u <= n; i += 4u) {
+    auto x  = _mm_loadu_ps(&s.x[i]);
+    auto y  = _mm_loadu_ps(&s.y[i]);
+    auto z  = _mm_loadu_ps(&s.z[i]);
+    auto r  = _mm_loadu_ps(&s.r[i]);
+    auto in = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (const auto& p : m_planes) {
+      auto d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(p.x)),
+                                     _mm_mul_ps(y, _mm_set1_ps(p.y))),
+                          _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(p.z)),
+                                     _mm_add_ps(r, _mm_set1_ps(p.w))));
+      in = _mm_and_ps(in, _mm_cmpge_ps(d, _mm_setzero_ps()));
+    }
+    auto mask = _mm_movemask_ps(in);
+    for (auto k = 0u; k < 4u; ++k) out[i + k] = (mask >> k) & 1;
+    count += __builtin_popcount(mask);
+  }
+#endif
+
+  for (; i < n; ++i) {
+    out[i] = visible(glm::vec4(s.x[i], s.y[i], s.z[i], s.r[i]));
+    count += out[i];
+  }
+  return count;
+}
+
+} // namespace imog
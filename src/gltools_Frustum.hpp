@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "gltools_Math.hpp"
+
+namespace imog {
+
+// View frustum as six normalized planes, tested against bounding spheres.
+// Batches of spheres are tested several at once (8 with AVX, 4 with SSE).
+class Frustum {
+
+public:
+  // Spheres stored per component, the layout the batch test wants
+  struct spheres {
+    std::vector<float> x, y, z, r;
+
+    void   push(const glm::vec4& sphere); // xyz center, w radius
+    void   clear();
+    size_t size() const;
+  };
+
+  // Sphere (xyz center, w radius) enclosing an AABB moved by model
+  static glm::vec4 sphere(const glm::vec3& boundsMin,
+                          const glm::vec3& boundsMax,
+                          const glm::mat4& model);
+
+private:
+  glm::vec4 m_planes[6];
+
+public:
+  // Planes of a viewproj matrix (Gribb & Hartmann)
+  explicit Frustum(const glm::mat4& viewproj);
+
+  // True if the sphere is (maybe) inside
+  bool visible(const glm::vec4& sphere) const;
+
+  // Test all spheres, writing 1 (visible) or 0 per sphere on out.
+  // Returns the number of visible ones
+  size_t test(const spheres& s, std::vector<uint8_t>& out) const;
+};
+
+} // namespace imog
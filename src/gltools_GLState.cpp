@@ -0,0 +1,214 @@
+#include "gltools_GLState.hpp"
+
+#include <glad/glad.h>
+
+#include "cpptools_Logger.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Shadowed state. ~0u (no valid name) means unknown, so the first change
+// is always sent
+// ====================================================================== //
+
+static constexpr unsigned int g_unknown = ~0u;
+
+unsigned int GLState::m_program{g_unknown};
+unsigned int GLState::m_vao{g_unknown};
+unsigned int GLState::m_unit{g_unknown};
+unsigned int GLState::m_targets[maxUnits]{};
+unsigned int GLState::m_textures[maxUnits]{};
+
+GLState::capability GLState::m_caps[maxCaps]{};
+unsigned int        GLState::m_capsCount{0u};
+
+GLState::counters GLState::m_counters{};
+bool              GLState::m_debugOutput{false};
+
+// ====================================================================== //
+// ====================================================================== //
+// Set a capability, skipped if it already is. Unknown ones take a slot
+// while there are free ones, the rest are always sent
+// ====================================================================== //
+
+void GLState::setCapability(unsigned int cap, bool on) {
+  auto send = [&]() {
+    (on) ? glEnable(cap) : glDisable(cap);
+    ++m_counters.issued;
+  };
+
+  for (auto i = 0u; i < m_capsCount; ++i) {
+    auto& c = m_caps[i];
+    if (c.cap != cap) continue;
+    if (c.on == (int)on) {
+      ++m_counters.skipped;
+    } else {
+      c.on = on;
+      send();
+    }
+    return;
+  }
+
+  if (m_capsCount < maxCaps) m_caps[m_capsCount++] = {cap, on};
+  send();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Forget everything, next changes are all sent
+// ====================================================================== //
+
+void GLState::invalidate() {
+  m_program = m_vao = m_unit = g_unknown;
+  for (auto u = 0u; u < maxUnits; ++u) m_textures[u] = g_unknown;
+  m_capsCount = 0u;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Program and vertex array in use
+// ====================================================================== //
+
+void GLState::useProgram(unsigned int program) {
+  if (program == m_program) {
+    ++m_counters.skipped;
+    return;
+  }
+  glUseProgram(program);
+  m_program = program;
+  ++m_counters.issued;
+}
+
+void GLState::bindVertexArray(unsigned int vao) {
+  if (vao == m_vao) {
+    ++m_counters.skipped;
+    return;
+  }
+  glBindVertexArray(vao);
+  m_vao = vao;
+  ++m_counters.issued;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Texture unit for next texture binds, as index (not GL_TEXTURE0 + i)
+// ====================================================================== //
+
+void GLState::activeTexture(unsigned int unit) {
+  if (unit == m_unit) {
+    ++m_counters.skipped;
+    return;
+  }
+  glActiveTexture(GL_TEXTURE0 + unit);
+  m_unit = unit;
+  ++m_counters.issued;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Bind a texture to the active unit. A unit remembers its last binding
+// only, other target of the same unit is sent again (never skipped wrong)
+// ====================================================================== //
+
+void GLState::bindTexture(unsigned int target, unsigned int texture) {
+  auto tracked = m_unit < maxUnits;
+  if (tracked && m_textures[m_unit] == texture &&
+      m_targets[m_unit] == target) {
+    ++m_counters.skipped;
+    return;
+  }
+  glBindTexture(target, texture);
+  if (tracked) {
+    m_targets[m_unit]  = target;
+    m_textures[m_unit] = texture;
+  }
+  ++m_counters.issued;
+}
+
+void GLState::bindTexture(unsigned int unit,
+                          unsigned int target,
+                          unsigned int texture) {
+  activeTexture(unit);
+  bindTexture(target, texture);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Deleted textures are unbound from every unit by the driver, and their
+// name can be given again to a new one
+// ====================================================================== //
+
+void GLState::textureDeleted(unsigned int texture) {
+  for (auto u = 0u; u < maxUnits; ++u) {
+    if (m_textures[u] == texture) m_textures[u] = 0u;
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Capabilities (GL_DEPTH_TEST, GL_CULL_FACE, ...)
+// ====================================================================== //
+
+void GLState::enable(unsigned int cap) { setCapability(cap, true); }
+void GLState::disable(unsigned int cap) { setCapability(cap, false); }
+
+// ====================================================================== //
+// ====================================================================== //
+// State changes issued and skipped since last reset
+// ====================================================================== //
+
+GLState::counters GLState::stats() { return m_counters; }
+void              GLState::resetStats() { m_counters = counters{}; }
+
+// ====================================================================== //
+// ====================================================================== //
+// KHR_debug callback. Synchronous, so it runs inside the call that raised
+// the message and a breakpoint here shows who did it
+// ====================================================================== //
+
+#ifdef DEBUG
+static void APIENTRY onDebugMessage(GLenum        source,
+                                    GLenum        type,
+                                    GLuint        id,
+                                    GLenum        severity,
+                                    GLsizei       length,
+                                    const GLchar* message,
+                                    const void*   user) {
+  if (type == GL_DEBUG_TYPE_ERROR) {
+    LOGE("GL error {}: {}", id, message);
+  } else if (severity != GL_DEBUG_SEVERITY_NOTIFICATION) {
+    LOGD("GL {}: {}", id, message);
+  }
+}
+#endif
+
+// ====================================================================== //
+// ====================================================================== //
+// Report errors through a KHR_debug callback. Debug builds only, false
+// if the context doesn't have it (errors are polled by GL_ASSERT then)
+// ====================================================================== //
+
+bool GLState::debugOutput() {
+#ifdef DEBUG
+  if (!GLAD_GL_VERSION_4_3 && !GLAD_GL_KHR_debug) {
+    LOGD("No KHR_debug on this context, GL errors will be polled.");
+    return false;
+  }
+  glEnable(GL_DEBUG_OUTPUT);
+  glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  glDebugMessageCallback(onDebugMessage, nullptr);
+  glDebugMessageControl(GL_DONT_CARE,
+                        GL_DONT_CARE,
+                        GL_DEBUG_SEVERITY_NOTIFICATION,
+                        0,
+                        nullptr,
+                        GL_FALSE);
+  m_debugOutput = true;
+#endif
+  return m_debugOutput;
+}
+
+bool GLState::debugOutputOn() { return m_debugOutput; }
+
+} // namespace imog
@@ -0,0 +1,76 @@
+#pragma once
+
+namespace imog {
+
+// Shadow copy of the OpenGL state changed on every draw: program, vertex
+// array, active texture unit, texture per unit and capabilities. Changes
+// to the value the driver already has are skipped. Render thread only,
+// and that state must only change through here (or call invalidate).
+class GLState {
+
+public:
+  // State changes sent to the driver and skipped as redundant
+  struct counters {
+    unsigned int issued{0u};
+    unsigned int skipped{0u};
+  };
+
+  static constexpr unsigned int maxUnits = 32u;
+  static constexpr unsigned int maxCaps  = 8u;
+
+private:
+  static unsigned int m_program;
+  static unsigned int m_vao;
+  static unsigned int m_unit;
+  static unsigned int m_targets[maxUnits];
+  static unsigned int m_textures[maxUnits];
+
+  // Capabilities seen so far, -1 while unknown
+  struct capability {
+    unsigned int cap;
+    int          on;
+  };
+  static capability   m_caps[maxCaps];
+  static unsigned int m_capsCount;
+
+  static counters m_counters;
+  static bool     m_debugOutput;
+
+  // Set a capability, skipped if it already is
+  static void setCapability(unsigned int cap, bool on);
+
+public:
+  // Forget everything, next changes are all sent
+  static void invalidate();
+
+  // Program and vertex array in use
+  static void useProgram(unsigned int program);
+  static void bindVertexArray(unsigned int vao);
+
+  // Texture unit for next texture binds, as index (not GL_TEXTURE0 + i)
+  static void activeTexture(unsigned int unit);
+
+  // Bind a texture to the active unit, or to a given one
+  static void bindTexture(unsigned int target, unsigned int texture);
+  static void bindTexture(unsigned int unit,
+                          unsigned int target,
+                          unsigned int texture);
+
+  // Deleted textures are unbound from every unit by the driver
+  static void textureDeleted(unsigned int texture);
+
+  // Capabilities (GL_DEPTH_TEST, GL_CULL_FACE, ...)
+  static void enable(unsigned int cap);
+  static void disable(unsigned int cap);
+
+  // State changes issued and skipped since last reset
+  static counters stats();
+  static void     resetStats();
+
+  // Report errors through a KHR_debug callback. Debug builds only, false
+  // if the context doesn't have it (errors are polled by GL_ASSERT then)
+  static bool debugOutput();
+  static bool debugOutputOn();
+};
+
+} // namespace imog
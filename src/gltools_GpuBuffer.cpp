@@ -0,0 +1,257 @@
+#include "gltools_GpuBuffer.hpp"
+
+#include <algorithm>
+
+#include "cpptools_Logger.hpp"
+#include "helpers/GLAssert.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Immutable storage is core since 4.4, older contexts may expose the ARB
+// ====================================================================== //
+
+static bool hasBufferStorage() {
+  return GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Block until the GPU is done with a fence, then forget it
+// ====================================================================== //
+
+static void waitFence(void*& fence) {
+  if (!fence) return;
+  auto sync = static_cast<GLsync>(fence);
+  while (true) {
+    auto res = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000u);
+    if (res != GL_TIMEOUT_EXPIRED) break;
+  }
+  glDeleteSync(sync);
+  fence = nullptr;
+}
+
+
+// * StaticArena
+
+// ====================================================================== //
+// ====================================================================== //
+// Param constructor. Nothing is created until first alloc
+// ====================================================================== //
+
+StaticArena::StaticArena(size_t pageSize) : m_pageSize(pageSize) {}
+
+// ====================================================================== //
+// ====================================================================== //
+// Upload size bytes of data to a free range aligned to align. Opens a new
+// page when no page has room (a bigger one for a bigger block)
+// ====================================================================== //
+
+StaticArena::block StaticArena::alloc(const void* data,
+                                      size_t      size,
+                                      size_t      align) {
+  block b;
+  if (size == 0u) return b;
+
+  for (auto& p : m_pages) {
+    auto offset = p.ranges.alloc(size, align);
+    if (offset != ArenaAllocator::npos) {
+      b = {p.buffer, offset, size};
+      break;
+    }
+  }
+
+  if (!b.buffer) {
+    page p{0u, ArenaAllocator(std::max(m_pageSize, size))};
+    GL_ASSERT(glGenBuffers(1, &p.buffer));
+    GL_ASSERT(glBindBuffer(GL_COPY_WRITE_BUFFER, p.buffer));
+    if (hasBufferStorage()) {
+      GL_ASSERT(glBufferStorage(GL_COPY_WRITE_BUFFER,
+                                p.ranges.capacity(),
+                                nullptr,
+                                GL_DYNAMIC_STORAGE_BIT));
+    } else {
+      GL_ASSERT(glBufferData(GL_COPY_WRITE_BUFFER,
+                             p.ranges.capacity(),
+                             nullptr,
+                             GL_STATIC_DRAW));
+    }
+    b = {p.buffer, p.ranges.alloc(size, align), size};
+    m_pages.push_back(std::move(p));
+  }
+
+  GL_ASSERT(glBindBuffer(GL_COPY_WRITE_BUFFER, b.buffer));
+  GL_ASSERT(glBufferSubData(GL_COPY_WRITE_BUFFER, b.offset, size, data));
+  GL_ASSERT(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+  return b;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Give back a block got from alloc. CPU only, safe after GL is gone
+// ====================================================================== //
+
+void StaticArena::free(block& b) {
+  for (auto& p : m_pages) {
+    if (p.buffer == b.buffer) {
+      p.ranges.free(b.offset, b.size);
+      break;
+    }
+  }
+  b = block{};
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Bytes in use and reserved on all pages
+// ====================================================================== //
+
+size_t StaticArena::used() const {
+  size_t bytes = 0u;
+  for (const auto& p : m_pages) bytes += p.ranges.used();
+  return bytes;
+}
+
+size_t StaticArena::capacity() const {
+  size_t bytes = 0u;
+  for (const auto& p : m_pages) bytes += p.ranges.capacity();
+  return bytes;
+}
+
+
+// * StreamRing
+
+// ====================================================================== //
+// ====================================================================== //
+// Param constructor. Nothing is created until first alloc
+// ====================================================================== //
+
+StreamRing::StreamRing(size_t partitionSize, unsigned int partitions)
+    : m_ring(partitionSize, partitions),
+      m_buffer(0u),
+      m_persistent(false),
+      m_mapped(nullptr),
+      m_flushed(0u),
+      m_wanted(partitionSize),
+      m_fences(m_ring.partitions(), nullptr) {}
+
+// ====================================================================== //
+// ====================================================================== //
+// (Re)create the buffer for the current partition size. Persistent and
+// coherent mapping if buffer storage is there, a CPU copy otherwise
+// ====================================================================== //
+
+void StreamRing::create() {
+  if (m_buffer) { GL_ASSERT(glDeleteBuffers(1, &m_buffer)); }
+  m_mapped = nullptr;
+  m_shadow.clear();
+
+  GL_ASSERT(glGenBuffers(1, &m_buffer));
+  GL_ASSERT(glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer));
+
+  m_persistent = hasBufferStorage();
+  if (m_persistent) {
+    auto flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+                 GL_MAP_COHERENT_BIT;
+    GL_ASSERT(glBufferStorage(
+        GL_COPY_WRITE_BUFFER, m_ring.size(), nullptr, flags));
+    m_mapped = static_cast<char*>(
+        glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, m_ring.size(), flags));
+    if (!m_mapped) {
+      LOGE("Couldn't map the stream buffer, falling back to uploads.");
+      m_persistent = false;
+      GL_ASSERT(glDeleteBuffers(1, &m_buffer));
+      GL_ASSERT(glGenBuffers(1, &m_buffer));
+      GL_ASSERT(glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer));
+    }
+  }
+  if (!m_persistent) {
+    GL_ASSERT(glBufferData(
+        GL_COPY_WRITE_BUFFER, m_ring.size(), nullptr, GL_STREAM_DRAW));
+    m_shadow.resize(m_ring.size());
+  }
+  GL_ASSERT(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Open next partition once its fence is signaled. Growing needs every
+// partition idle, so it waits them all
+// ====================================================================== //
+
+void StreamRing::beginFrame() {
+  if (!m_buffer || m_wanted != m_ring.partitionSize()) {
+    for (auto& f : m_fences) waitFence(f);
+    m_ring.resize(m_wanted);
+    this->create();
+  }
+  waitFence(m_fences[m_ring.begin()]);
+  m_flushed = 0u;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Reserve size bytes on the current frame partition. When it's full the
+// partition size is doubled for next frames
+// ====================================================================== //
+
+StreamRing::span StreamRing::alloc(size_t size, size_t align) {
+  if (!m_ring.open()) this->beginFrame();
+
+  auto offset = m_ring.alloc(size, align);
+  if (offset == RingAllocator::npos) {
+    auto needed = m_ring.used() + size + align;
+    if (needed > m_wanted) {
+      m_wanted = std::max(m_wanted * 2u, needed);
+      LOGE("Stream buffer partition full, growing to {} bytes.", m_wanted);
+    }
+    return span{};
+  }
+
+  auto base = (m_persistent) ? m_mapped : m_shadow.data();
+  return span{base + offset, offset};
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Make written data visible to the GPU. Coherent mapping needs nothing,
+// the CPU copy uploads what was written since last flush
+// ====================================================================== //
+
+void StreamRing::flush() {
+  if (m_persistent || !m_ring.open()) return;
+  auto used = m_ring.used();
+  if (used <= m_flushed) return;
+
+  auto offset = m_ring.current() * m_ring.partitionSize() + m_flushed;
+  GL_ASSERT(glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer));
+  GL_ASSERT(glBufferSubData(GL_COPY_WRITE_BUFFER,
+                            offset,
+                            used - m_flushed,
+                            m_shadow.data() + offset));
+  GL_ASSERT(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+  m_flushed = used;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Flush and fence the current partition. Call it after the frame draws
+// ====================================================================== //
+
+void StreamRing::endFrame() {
+  if (!m_ring.open()) return;
+  this->flush();
+  auto p      = m_ring.end();
+  m_fences[p] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Getters
+// ====================================================================== //
+
+unsigned int StreamRing::buffer() const { return m_buffer; }
+bool         StreamRing::persistent() const { return m_persistent; }
+
+} // namespace imog
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include "cpptools_BufferAllocators.hpp"
+
+namespace imog {
+
+// Immutable mesh data sub-allocated from a few big buffers (pages), so
+// every Renderable shares them instead of owning a buffer per attribute.
+// Buffers are created on demand, pageSize bytes or more.
+class StaticArena {
+
+public:
+  // Range of a page buffer, buffer 0 if empty
+  struct block {
+    unsigned int buffer{0u};
+    size_t       offset{0u};
+    size_t       size{0u};
+  };
+
+private:
+  struct page {
+    unsigned int   buffer;
+    ArenaAllocator ranges;
+  };
+
+  size_t            m_pageSize;
+  std::vector<page> m_pages;
+
+public:
+  explicit StaticArena(size_t pageSize);
+
+  // Upload size bytes of data to a free range aligned to align
+  block alloc(const void* data, size_t size, size_t align = 16u);
+
+  // Give back a block got from alloc
+  void free(block& b);
+
+  // Bytes in use and reserved on all pages
+  size_t used() const;
+  size_t capacity() const;
+};
+
+// Per frame dynamic data (instances, debug lines, skinned vertices) on one
+// buffer split in a partition per frame in flight. With buffer storage
+// (GL 4.4) it's mapped once, persistent and coherent, and written in
+// place. Without it writes go to a CPU copy uploaded by flush. A fence per
+// partition keeps the CPU from writing what the GPU may still be reading.
+class StreamRing {
+
+public:
+  // Where to write and the offset to point the GPU at. data is null when
+  // the frame partition is full (the ring grows on next frame)
+  struct span {
+    void*  data{nullptr};
+    size_t offset{0u};
+  };
+
+private:
+  RingAllocator      m_ring;
+  unsigned int       m_buffer;
+  bool               m_persistent;
+  char*              m_mapped;
+  std::vector<char>  m_shadow;  // Without buffer storage
+  size_t             m_flushed; // Bytes of the partition already uploaded
+  size_t             m_wanted;  // Partition size for next frame
+  std::vector<void*> m_fences;  // GLsync per partition
+
+  // (Re)create the buffer for the current partition size
+  void create();
+
+  // Open next partition once its fence is signaled
+  void beginFrame();
+
+public:
+  StreamRing(size_t partitionSize, unsigned int partitions = 3u);
+
+  // Reserve size bytes on the current frame partition
+  span alloc(size_t size, size_t align = 16u);
+
+  // Make written data visible to the GPU. Call it before drawing with it
+  void flush();
+
+  // Flush and fence the current partition. Call it after the frame draws
+  void endFrame();
+
+  // Getters
+  unsigned int buffer() const;
+  bool         persistent() const;
+};
+
+} // namespace imog
@@ -4,7 +4,15 @@
 #include "Settings.hpp"
 
 #include "gltools_Shader.hpp"
+#include "gltools_Replay.hpp"
+#include "gltools_GLState.hpp"
+#include "gltools_TextureLoader.hpp"
+#include "gltools_Offscreen.hpp"
 #include "gltools_Renderable.hpp"
+#include "gltools_FrameCapture.hpp"
+#include "gltools_FrameScheduler.hpp"
+#include "cpptools_Timer.hpp"
+#include "cpptools_Metrics.hpp"
 
 #include "helpers/Consts.hpp"
 #include "helpers/GLAssert.hpp"
@@ -23,6 +31,10 @@ bool                    IO::m_pause;
 std::shared_ptr<Camera> IO::m_camera;
 
 GLFWwindow* IO::m_windowPtr{nullptr};
+bool        IO::m_windowClosed{false};
+
+std::unique_ptr<Offscreen>    IO::m_offscreen{};
+std::unique_ptr<FrameCapture> IO::m_capture{};
 
 std::string IO::m_windowTitle{""};
 int         IO::m_windowWidth{0};
@@ -35,6 +47,7 @@ double IO::m_mouseLastX{.0};
 double IO::m_mouseLastY{.0};
 
 std::unordered_multimap<std::string, _IO_FUNC> IO::m_keyboardActions{};
+bool IO::m_keyboardDown[GLFW_KEY_LAST + 1]{};
 
 
 
@@ -79,75 +92,88 @@ void IO::windowInit(const std::shared_ptr<Camera>& camera) {
   // ---------------------------------------------------------
   // --- Window creation -------------------------------------
 
-  if (!glfwInit()) {
-    LOGE("Couldn't initialize GLFW");
-    glfwTerminate();
-  }
-
-  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-  glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
-  glfwWindowHint(GLFW_FOCUS_ON_SHOW, GLFW_TRUE);
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, Settings::openglMajorV);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, Settings::openglMinorV);
-
-  GLFWwindow* o_WINDOW = glfwCreateWindow(
-      m_windowWidth, m_windowHeight, m_windowTitle.c_str(), nullptr, nullptr);
-
-  if (!o_WINDOW) {
-    LOGE("Couldn't create GLFW window");
-    glfwTerminate();
-  }
+  GLFWwindow*  o_WINDOW = nullptr;
+  GLADloadproc glProc   = (GLADloadproc)glfwGetProcAddress;
 
-  // Set as active window
-  glfwMakeContextCurrent(o_WINDOW);
-  // glfwSwapInterval(1);
+  if (Settings::headless) {
+    // No window nor input callbacks. Frames go to an offscreen target
+    auto major = Settings::openglMajorV, minor = Settings::openglMinorV;
+    if (!Offscreen::contextInit(major, minor)) {
+      LOGD("Headless rendering needs a windowless context. ABORT.");
+      std::exit(2);
+    }
+    glProc = (GLADloadproc)Offscreen::procAddress;
+  } else {
+    if (!glfwInit()) {
+      LOGE("Couldn't initialize GLFW");
+      glfwTerminate();
+    }
 
-  // Set icon
-  int       icoW, icoH;
-  auto      ico = stbi_load("./assets/icon/icon.png", &icoW, &icoH, 0, 4);
-  GLFWimage icons[1];
-  icons[0].height = icoH;
-  icons[0].width  = icoW;
-  icons[0].pixels = ico;
-  glfwSetWindowIcon(o_WINDOW, 1, icons);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+    glfwWindowHint(GLFW_FOCUS_ON_SHOW, GLFW_TRUE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, Settings::openglMajorV);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, Settings::openglMinorV);
+#ifdef DEBUG
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
+
+    o_WINDOW = glfwCreateWindow(m_windowWidth,
+                                m_windowHeight,
+                                m_windowTitle.c_str(),
+                                nullptr,
+                                nullptr);
+
+    if (!o_WINDOW) {
+      LOGE("Couldn't create GLFW window");
+      glfwTerminate();
+    }
 
-  // ----------------------------------- / Window creation ---
-  // ---------------------------------------------------------
+    // Set as active window, paced as Settings::frameMode says
+    glfwMakeContextCurrent(o_WINDOW);
+    FrameScheduler::init(true);
 
+    // Set icon
+    int       icoW, icoH;
+    auto      ico = stbi_load("./assets/icon/icon.png", &icoW, &icoH, 0, 4);
+    GLFWimage icons[1];
+    icons[0].height = icoH;
+    icons[0].width  = icoW;
+    icons[0].pixels = ico;
+    glfwSetWindowIcon(o_WINDOW, 1, icons);
 
-  // ---------------------------------------------------------
-  // --- Callbacks -------------------------------------------
+    // Callbacks
 
-  // - Keyboard
+    // - Keyboard
 
-  glfwSetKeyCallback(o_WINDOW, keyboardOnPress);
+    glfwSetKeyCallback(o_WINDOW, keyboardOnPress);
 
-  // - Mouse
+    // - Mouse
 
-  glfwSetScrollCallback(o_WINDOW, mouseOnScroll);
-  glfwSetCursorPosCallback(o_WINDOW, mouseOnMove);
-  glfwSetMouseButtonCallback(o_WINDOW, mouseOnClick);
+    glfwSetScrollCallback(o_WINDOW, mouseOnScroll);
+    glfwSetCursorPosCallback(o_WINDOW, mouseOnMove);
+    glfwSetMouseButtonCallback(o_WINDOW, mouseOnClick);
 
-  // - Window
+    // - Window
 
-  glfwSetWindowCloseCallback(o_WINDOW, windowOnClose);
-  glfwSetWindowSizeCallback(o_WINDOW, windowOnScaleChange);
+    glfwSetWindowCloseCallback(o_WINDOW, windowOnClose);
+    glfwSetWindowSizeCallback(o_WINDOW, windowOnScaleChange);
+  }
 
-  // ----------------------------------------- / Callbacks ---
+  // ----------------------------------- / Window creation ---
   // ---------------------------------------------------------
 
 
   // ---------------------------------------------------------
   // --- GLAD ------------------------------------------------
 
-  GLADloadproc glwfProc = (GLADloadproc)glfwGetProcAddress;
-
-  if (!gladLoadGLLoader(glwfProc)) {
+  if (!gladLoadGLLoader(glProc)) {
     LOGE("Couldn't initialize GLAD");
     glfwTerminate();
   }
+  GLState::debugOutput();
 
   // ---------------------------------------------- / GLAD ---
   // ---------------------------------------------------------
@@ -158,8 +184,8 @@ void IO::windowInit(const std::shared_ptr<Camera>& camera) {
 
   // GL Settings
   glFrontFace(GL_CCW);
-  glEnable(GL_CULL_FACE);
-  glEnable(GL_DEPTH_TEST);
+  GLState::enable(GL_CULL_FACE);
+  GLState::enable(GL_DEPTH_TEST);
   glDepthFunc(GL_LEQUAL);
   glm::vec3 cc = Settings::clearColor;
   glClearColor(cc.r, cc.g, cc.b, 1.0f);
@@ -168,6 +194,7 @@ void IO::windowInit(const std::shared_ptr<Camera>& camera) {
   Shader::createByName("base", true);
   auto sks   = Shader::createByName("sk", true);
   auto bones = Shader::createByName("bone", true);
+  Shader::createByName("debug");
 
   // Create default Renderables
   Renderable::create(false, "Cube", Figures::cube, "", Colors::orange, sks);
@@ -185,47 +212,325 @@ void IO::windowInit(const std::shared_ptr<Camera>& camera) {
   // ------------------------------------------ / Defaults ---
   // ---------------------------------------------------------
 
+
+  // ---------------------------------------------------------
+  // --- Offscreen and capture -------------------------------
+
+  if (Settings::headless) {
+    m_offscreen = std::make_unique<Offscreen>(m_windowWidth, m_windowHeight);
+    m_offscreen->bind();
+  }
+
+  if (!Settings::captureDir.empty()) {
+    auto fmt = (Settings::captureFormat == "raw") ? FrameCapture::format::raw
+                                                  : FrameCapture::format::png;
+    m_capture = std::make_unique<FrameCapture>(
+        Settings::captureDir, fmt, m_windowWidth, m_windowHeight);
+  }
+
+  // ----------------------------- / Offscreen and capture ---
+  // ---------------------------------------------------------
+
+
+  // ---------------------------------------------------------
+  // --- Metrics ---------------------------------------------
+
+  Metrics::init();
+
+  // ------------------------------------------- / Metrics ---
+  // ---------------------------------------------------------
+
+
+  // ---------------------------------------------------------
+  // --- Input log -------------------------------------------
+
+  if (!Settings::inputReplay.empty()) {
+    Replay::play(Settings::inputReplay);
+  } else if (!Settings::inputRecord.empty()) {
+    Replay::record(Settings::inputRecord);
+  }
+
+  // ----------------------------------------- / Input log ---
+  // ---------------------------------------------------------
+
   m_windowPtr = o_WINDOW; // Store window ptr
 }
 
+// ====================================================================== //
+// ====================================================================== //
+// Make the context current on the calling thread, or release it
+// ====================================================================== //
+
+void IO::contextCurrent(bool current) {
+  if (Settings::headless) {
+    Offscreen::makeCurrent(current);
+  } else {
+    glfwMakeContextCurrent((current) ? m_windowPtr : nullptr);
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Frame time breakdown of the last second, with Settings::showTimes. The
+// overlap is update and record time spent while the previous frame was
+// being submitted, what the render thread wins
+// ====================================================================== //
+
+static void logFrameTimes() {
+  static auto   since  = StdClock::now();
+  static double sum[4] = {};
+  static int    frames = 0;
+
+  const auto& st = Renderable::queue.lastStats();
+  sum[0] += st.recordMs;
+  sum[1] += st.waitMs;
+  sum[2] += st.submitMs;
+  sum[3] += st.overlapMs;
+  ++frames;
+
+  Seconds elapsed = StdClock::now() - since;
+  if (elapsed.count() < 1.0) return;
+  if (Settings::showTimes) {
+    LOGD("{} frames, ms per frame: record {:.2f} (waiting {:.2f}), submit "
+         "{:.2f}, overlap {:.2f}",
+         frames,
+         sum[0] / frames,
+         sum[1] / frames,
+         sum[2] / frames,
+         sum[3] / frames);
+  }
+  since  = StdClock::now();
+  frames = 0;
+  for (auto& s : sum) s = 0.0;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Metrics of the frame just submitted. Same thread as the submit: owns the
+// state tracker counters
+// ====================================================================== //
+
+static void frameMetrics() {
+  static auto& recordMs = Metrics::findHistogram("record.ms");
+  static auto& waitMs   = Metrics::findHistogram("wait.ms");
+  static auto& submitMs = Metrics::findHistogram("submit.ms");
+  static auto& draws    = Metrics::findCounter("draws");
+  static auto& inst     = Metrics::findCounter("instances");
+  static auto& changes  = Metrics::findCounter("state.changes");
+  static auto& skipped  = Metrics::findCounter("state.skipped");
+  static auto& allocs   = Metrics::findCounter("allocs");
+  static auto& bytes    = Metrics::findCounter("alloc.bytes");
+  static auto& fDraws   = Metrics::findGauge("frame.draws");
+  static auto& fTris    = Metrics::findGauge("frame.triangles");
+  static auto& fCulled  = Metrics::findGauge("frame.culled");
+  static auto& fBytes   = Metrics::findGauge("frame.bytes");
+  static auto& arena    = Metrics::findGauge("arena.bytes");
+  static auto& textures = Metrics::findGauge("textures.progress");
+
+  const auto& st = Renderable::queue.lastStats();
+  recordMs.observe(st.recordMs);
+  waitMs.observe(st.waitMs);
+  submitMs.observe(st.submitMs);
+  draws.add(st.draws);
+  inst.add(st.instances);
+  allocs.add(st.allocs);
+  bytes.add(st.frameBytes);
+  fDraws.set(st.draws);
+  fTris.set(st.triangles);
+  fCulled.set(st.culled);
+  fBytes.set(st.frameBytes);
+  arena.set(Renderable::arena.used());
+  textures.set(TextureLoader::progress());
+
+  auto gl = GLState::stats();
+  GLState::resetStats();
+  changes.add(gl.issued);
+  skipped.add(gl.skipped);
+
+  Metrics::frame();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Hand the context to a render thread that submits the frames published
+// by the loop, each followed by present. The loop thread keeps events,
+// update and recording: frame N+1 is recorded while frame N submits
+// ====================================================================== //
+
+std::thread IO::renderStart(const _IO_FUNC& present) {
+  if (!Settings::renderThread) return {};
+
+  Renderable::queue.threaded(true);
+  contextCurrent(false);
+  return std::thread([present]() {
+    contextCurrent(true);
+    while (Renderable::poolSubmit()) {
+      present();
+      logFrameTimes();
+      frameMetrics();
+    }
+    contextCurrent(false);
+  });
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Stop the render thread once it submits what was published, and take
+// the context back
+// ====================================================================== //
+
+void IO::renderStop(std::thread& renderer) {
+  if (!renderer.joinable()) return;
+  Renderable::queue.threaded(false);
+  renderer.join();
+  contextCurrent(true);
+}
+
 // ====================================================================== //
 // ====================================================================== //
 // WINDOW loop definition
 // ====================================================================== //
 
 void IO::windowLoop(const _IO_FUNC& renderFn, const _IO_FUNC& updateFn) {
-  int    frame = 0;
-  double iTime = glfwGetTime();
-
-  auto lam_FPS = [&]() {
-    ++frame;
-    double eTime = glfwGetTime();
-    if (eTime - iTime >= 1.0) {
-      auto subTitle = (m_pause) ? "PAUSED" : std::to_string(frame) + "fps";
-      auto title    = m_windowTitle + " :: " + subTitle;
-      iTime         = eTime;
-      frame         = 0;
-      glfwSetWindowTitle(m_windowPtr, title.c_str());
+  if (Settings::headless) {
+    offscreenLoop(renderFn, updateFn);
+    return;
+  }
+
+  auto present = [&]() {
+    if (m_capture) m_capture->capture();
+    glfwSwapBuffers(m_windowPtr);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  };
+  auto renderer = renderStart(present);
+
+  // Frame time stats of the last second on the title, or pause state
+  auto subTitle  = std::string();
+  auto lam_title = [&](const std::string& text) {
+    if (text == subTitle) return;
+    subTitle   = text;
+    auto title = m_windowTitle + " :: " + subTitle;
+    glfwSetWindowTitle(m_windowPtr, title.c_str());
+  };
+  auto lam_stats = [&]() {
+    const auto& st = FrameScheduler::lastStats();
+    if (Settings::showTimes) {
+      LOGD("{} frames ({} skipped), ms mean {:.2f}, p95 {:.2f}, p99 {:.2f}, "
+           "max {:.2f}, {} missed",
+           st.frames,
+           st.skipped,
+           st.meanMs,
+           st.p95Ms,
+           st.p99Ms,
+           st.maxMs,
+           st.missed);
     }
+    auto text = fmt::format("{} fps, {:.1f}ms (p95 {:.1f}, p99 {:.1f}), "
+                            "{} missed",
+                            st.frames,
+                            st.meanMs,
+                            st.p95Ms,
+                            st.p99Ms,
+                            st.missed);
+    lam_title(text);
   };
 
 
   while (!glfwWindowShouldClose(m_windowPtr)) {
 
-    // Events
-    lam_FPS();
-    (Settings::pollEvents) ? glfwPollEvents() : glfwWaitEvents();
+    // Events, until the next frame is due
+    FrameScheduler::waitEvents(m_pause);
     if (Settings::corrupted()) { m_pause = true; }
-    if (m_pause) { continue; }
+    if (m_pause) {
+      lam_title("PAUSED");
+      continue;
+    }
+    if (!FrameScheduler::begin()) { continue; }
+    if (!Replay::frame()) { windowOnClose(m_windowPtr); }
 
     // Update
+    Renderable::queue.begin();
     updateFn();
 
-    // Render
+    // Record (and submit, without render thread)
     renderFn();
-    glfwSwapBuffers(m_windowPtr);
+    if (!renderer.joinable()) {
+      present();
+      logFrameTimes();
+      frameMetrics();
+    }
+    if (FrameScheduler::end()) lam_stats();
+  }
+
+  renderStop(renderer);
+  m_capture.reset(); // Writes what is left
+  Replay::stop();
+  Metrics::close();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// WINDOW loop without window. No events nor vsync: renders as fast as it
+// can until the replay ends, captureFrames are done or it's closed, and
+// reports the throughput
+// ====================================================================== //
+
+void IO::offscreenLoop(const _IO_FUNC& renderFn, const _IO_FUNC& updateFn) {
+  // Same frames on every run, whatever the texture load timing
+  TextureLoader::finish();
+
+  auto present = [&]() {
+    if (m_capture) m_capture->capture();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  };
+  auto renderer = renderStart(present);
+
+  auto& frameMs = Metrics::findHistogram("frame.ms");
+  auto  frames  = 0;
+  auto  start   = StdClock::now();
+  auto  last    = TimePoint(start);
+
+  while (!m_windowClosed) {
+    if (!Replay::frame()) { windowOnClose(nullptr); }
+    if (Settings::corrupted()) {
+      LOGE("Corrupted settings, headless run stopped.");
+      break;
+    }
+
+    Renderable::queue.begin();
+    updateFn();
+    renderFn();
+    if (!renderer.joinable()) {
+      present();
+      logFrameTimes();
+      frameMetrics();
+    }
+
+    TimePoint now       = StdClock::now();
+    Seconds   frameTime = now - last;
+    last                = now;
+    frameMs.observe(frameTime.count() * 1000.0);
+
+    ++frames;
+    if (Settings::captureFrames > 0 && frames >= Settings::captureFrames) break;
+  }
+  renderStop(renderer);
+
+  auto written = 0u;
+  if (m_capture) {
+    m_capture->finish();
+    written = m_capture->written();
+    m_capture.reset();
   }
+  Seconds elapsed = StdClock::now() - start;
+  LOGD("Headless: {} frames ({} written) in {:.2f}s, {:.1f} fps.",
+       frames,
+       written,
+       elapsed.count(),
+       frames / elapsed.count());
+
+  Replay::stop();
+  Metrics::close();
 }
 
 // ====================================================================== //
@@ -241,13 +546,26 @@ float IO::windowAspectRatio() {
 
 // ====================================================================== //
 // ====================================================================== //
-// WINDOW reply when is "resized"
+// WINDOW height in pixels
+// ====================================================================== //
+
+int IO::windowHeight() { return m_windowHeight; }
+
+// ====================================================================== //
+// ====================================================================== //
+// WINDOW reply when is "resized". Targets are resized on the render
+// thread, before the first frame recorded with the new size
 // ====================================================================== //
 
 void IO::windowOnScaleChange(GLFWwindow* w, int width, int height) {
-  glViewport(0, 0, width, height);
+  Renderable::queue.defer([width, height]() {
+    glViewport(0, 0, width, height);
+    if (m_offscreen) m_offscreen->resize(width, height);
+    if (m_capture) m_capture->resize(width, height);
+  });
   m_windowWidth  = width;
   m_windowHeight = height;
+  FrameScheduler::invalidate();
 }
 
 // ====================================================================== //
@@ -257,10 +575,12 @@ void IO::windowOnScaleChange(GLFWwindow* w, int width, int height) {
 
 void IO::windowOnClose(GLFWwindow* w) {
   if (!Settings::quiet) LOGD("Closing GLFW window.");
-  glfwSetWindowShouldClose(w, GL_TRUE);
+  m_windowClosed = true;
+  if (w) glfwSetWindowShouldClose(w, GL_TRUE);
 }
 
 void IO::windowVisibility(bool value) {
+  if (!m_windowPtr) return; // Headless
   (value) ? glfwShowWindow(m_windowPtr) : glfwHideWindow(m_windowPtr);
 }
 
@@ -273,7 +593,10 @@ void IO::windowVisibility(bool value) {
 // ====================================================================== //
 
 void IO::mouseOnScroll(GLFWwindow* w, double xOffset, double yOffset) {
+  if (Replay::replaying() && !Replay::feeding()) return;
+  Replay::scroll(xOffset, yOffset);
   m_camera->zoom(static_cast<float>(yOffset));
+  FrameScheduler::invalidate();
 }
 
 // ====================================================================== //
@@ -282,11 +605,14 @@ void IO::mouseOnScroll(GLFWwindow* w, double xOffset, double yOffset) {
 // ====================================================================== //
 
 void IO::mouseOnMove(GLFWwindow* w, double mouseCurrX, double mouseCurrY) {
+  if (Replay::replaying() && !Replay::feeding()) return;
+  Replay::mouseMove(mouseCurrX, mouseCurrY);
   if (m_mouseClicL) {
     float yRot = (mouseCurrX - m_mouseLastX) * Settings::mouseSensitivity;
     float xRot = (mouseCurrY - m_mouseLastY) * Settings::mouseSensitivity;
 
     m_camera->pivot.rot += glm::vec3(xRot, yRot, 0.f);
+    FrameScheduler::invalidate();
   }
   m_mouseLastX = mouseCurrX;
   m_mouseLastY = mouseCurrY;
@@ -298,6 +624,9 @@ void IO::mouseOnMove(GLFWwindow* w, double mouseCurrX, double mouseCurrY) {
 // ====================================================================== //
 
 void IO::mouseOnClick(GLFWwindow* w, int button, int action, int mods) {
+  if (Replay::replaying() && !Replay::feeding()) return;
+  Replay::mouseClick(button, action, mods);
+  FrameScheduler::invalidate();
   switch (button) {
 
     case GLFW_MOUSE_BUTTON_LEFT:
@@ -334,6 +663,20 @@ void IO::keyboardOnPress(GLFWwindow* w,
                          int         action,
                          int         mods) {
 
+  // ----------------------------------
+  // --- Input log --------------------
+  // ----------------------------------
+
+  // While replaying only ESC is taken from the real keyboard
+  bool escape = (action == GLFW_PRESS && key == GLFW_KEY_ESCAPE);
+  if (Replay::replaying() && !Replay::feeding() && !escape) return;
+  Replay::key(key, scancode, action, mods);
+  FrameScheduler::invalidate();
+
+  if (key >= 0 && key <= GLFW_KEY_LAST) {
+    m_keyboardDown[key] = (action != GLFW_RELEASE);
+  }
+
   // ----------------------------------
   // --- User defined actions ---------
   // ----------------------------------
@@ -350,9 +693,7 @@ void IO::keyboardOnPress(GLFWwindow* w,
   // --- Default actions --------------
   // ----------------------------------
 
-  if (action == GLFW_PRESS && key == GLFW_KEY_ESCAPE) {
-    windowOnClose(m_windowPtr);
-  }
+  if (escape) { windowOnClose(m_windowPtr); }
 }
 
 // ====================================================================== //
@@ -376,4 +717,13 @@ void IO::keyboardAddAction(int key, kbState state, const _IO_FUNC& action) {
   }
 }
 
+// ====================================================================== //
+// ====================================================================== //
+// KEYBOARD state as seen by the callbacks (real or replayed input)
+// ====================================================================== //
+
+bool IO::keyboardIsDown(int key) {
+  return (key >= 0 && key <= GLFW_KEY_LAST) ? m_keyboardDown[key] : false;
+}
+
 } // namespace imog
@@ -5,6 +5,8 @@
 #include <glfw/glfw3.h>
 
 #include <string>
+#include <memory>
+#include <thread>
 #include <functional>
 #include <unordered_map>
 using _IO_FUNC = std::function<void()>;
@@ -13,6 +15,9 @@ using _IO_FUNC = std::function<void()>;
 
 namespace imog {
 
+class Offscreen;
+class FrameCapture;
+
 class IO {
 
   static bool                    m_pause;
@@ -25,16 +30,34 @@ class IO {
 
 private:
   static GLFWwindow* m_windowPtr;
+  static bool        m_windowClosed;
   static std::string m_windowTitle;
   static int         m_windowWidth;
   static int         m_windowHeight;
 
+  // Headless target and image sequence output, null if unused
+  static std::unique_ptr<Offscreen>    m_offscreen;
+  static std::unique_ptr<FrameCapture> m_capture;
+
+  // Loop for headless runs, no window nor events
+  static void offscreenLoop(const _IO_FUNC& renderFn, const _IO_FUNC& updateFn);
+
+  // Make the context current on the calling thread, or release it
+  static void contextCurrent(bool current);
+
+  // With Settings::renderThread, hand the context to a thread that
+  // submits the frames published by the loop, each followed by present.
+  // Otherwise the loop presents after its own (inline) submit
+  static std::thread renderStart(const _IO_FUNC& present);
+  static void        renderStop(std::thread& renderer);
+
 public:
   static GLFWwindow* window();
 
   static void  windowInit(const std::shared_ptr<Camera>& camera);
   static void  windowLoop(const _IO_FUNC& renderFn, const _IO_FUNC& updateFn);
   static float windowAspectRatio();
+  static int   windowHeight();
   static void  windowOnScaleChange(GLFWwindow* w, int width, int height);
   static void  windowOnClose(GLFWwindow* w);
   static void  windowVisibility(bool value);
@@ -67,6 +90,7 @@ public:
 
 private:
   static std::unordered_multimap<std::string, _IO_FUNC> m_keyboardActions;
+  static bool m_keyboardDown[GLFW_KEY_LAST + 1];
 
 public:
 #define IO_DefineKeyStates(key, onRelease, onPress, onRepeat)  \
@@ -83,6 +107,9 @@ public:
                               int         mods);
 
   static void keyboardAddAction(int key, kbState state, const _IO_FUNC& action);
+
+  // Key state as seen by the callbacks (real or replayed input)
+  static bool keyboardIsDown(int key);
 };
 
 } // namespace imog
@@ -0,0 +1,166 @@
+#include "gltools_InstanceBatch.hpp"
+
+#include <cstring>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include "cpptools_Logger.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Constructor
+// ====================================================================== //
+
+InstanceBatch::InstanceBatch() : m_tested(0u), m_culled(0u) {}
+
+// ====================================================================== //
+// ====================================================================== //
+// Queue an instance of a mesh. Its normal matrix is computed here, once,
+// instead of on every vertex of it
+// ====================================================================== //
+
+void InstanceBatch::add(Handle<Renderable> mesh,
+                        const glm::mat4&   model,
+                        const glm::vec3&   color) {
+  Renderable::instance inst{model, glm::vec4{color, 1.f}, {}};
+  auto                 normal = glm::inverseTranspose(glm::mat3(model));
+  for (auto c = 0u; c < 3u; ++c) inst.normal[c] = glm::vec4(normal[c], 0.f);
+
+  // A handful of meshes per batch, a linear search is enough
+  for (auto& g : m_groups) {
+    if (g.mesh == mesh) {
+      g.instances.push_back(inst);
+      return;
+    }
+  }
+  m_groups.push_back({mesh, {inst}});
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Lay out the queued instances per mesh and record the calls to issue.
+// With a frustum, instances out of it are dropped. Bounds of each mesh
+// are moved by every instance model and tested in batches. With a camera,
+// kept instances are regrouped by level of detail, finest first
+// ====================================================================== //
+
+const std::vector<InstanceBatch::call>& InstanceBatch::record(
+    const Frustum* frustum,
+    const Camera*  camera) {
+  m_instances.clear();
+  m_calls.clear();
+  m_tested = m_culled = 0u;
+
+  for (auto& g : m_groups) {
+    const auto& mesh = Renderable::get(g.mesh);
+    if (g.instances.empty() || !mesh) continue;
+
+    auto first = static_cast<unsigned int>(m_instances.size());
+    if (frustum) {
+      m_bounds.clear();
+      for (const auto& i : g.instances) {
+        m_bounds.push(
+            Frustum::sphere(mesh->boundsMin(), mesh->boundsMax(), i.model));
+      }
+      frustum->test(m_bounds, m_visible);
+      for (auto i = 0u; i < g.instances.size(); ++i) {
+        if (m_visible[i]) m_instances.push_back(g.instances[i]);
+      }
+      m_tested += g.instances.size();
+      m_culled += g.instances.size() - (m_instances.size() - first);
+    } else {
+      m_instances.insert(
+          m_instances.end(), g.instances.begin(), g.instances.end());
+    }
+    g.instances.clear();
+
+    // Alpha carries the texture array layer of the mesh, -1 for none
+    const auto& texture = mesh->texture();
+    auto        layer   = (texture) ? (float)texture->layer() : -1.f;
+    for (auto i = first; i < m_instances.size(); ++i) {
+      m_instances[i].color.w = layer;
+    }
+
+    auto end    = static_cast<unsigned int>(m_instances.size());
+    auto levels = static_cast<unsigned int>(mesh->lods().size());
+    if (!camera || levels < 2u || end == first) {
+      if (end > first) m_calls.push_back({g.mesh, first, end - first, 0u});
+      continue;
+    }
+
+    m_kept.assign(m_instances.begin() + first, m_instances.end());
+    m_instances.resize(first);
+    m_lods.clear();
+    for (const auto& i : m_kept) {
+      auto sphere =
+          Frustum::sphere(mesh->boundsMin(), mesh->boundsMax(), i.model);
+      m_lods.push_back(mesh->lodFor(sphere, *camera));
+    }
+
+    // Stable regroup, one call per level in use
+    for (auto lod = 0u; lod < levels; ++lod) {
+      auto start = static_cast<unsigned int>(m_instances.size());
+      for (auto i = 0u; i < m_kept.size(); ++i) {
+        if (m_lods[i] == lod) m_instances.push_back(m_kept[i]);
+      }
+      auto count = static_cast<unsigned int>(m_instances.size()) - start;
+      if (count > 0u) m_calls.push_back({g.mesh, start, count, lod});
+    }
+  }
+  return m_calls;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Getters for the recorded frame
+// ====================================================================== //
+
+const std::vector<InstanceBatch::call>& InstanceBatch::calls() const {
+  return m_calls;
+}
+
+const std::vector<Renderable::instance>& InstanceBatch::instances() const {
+  return m_instances;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Write recorded instances to the frame bytes and queue the calls on the
+// frame render queue, culling counters included. Returns the number of
+// draw calls queued
+// ====================================================================== //
+
+unsigned int InstanceBatch::submit() {
+  Renderable::queue.countCulling(m_tested, m_culled);
+  if (m_instances.empty()) return 0u;
+
+  // Goes to the frame stream with the rest of the frame, in one copy
+  auto bytes  = m_instances.size() * sizeof(Renderable::instance);
+  auto offset = Renderable::queue.alloc(bytes);
+  std::memcpy(Renderable::queue.data(offset), m_instances.data(), bytes);
+
+  auto draws = 0u;
+  for (const auto& c : m_calls) {
+    const auto& mesh = Renderable::get(c.mesh);
+    if (!mesh) continue;
+    auto first = offset + c.first * sizeof(Renderable::instance);
+    Renderable::queue.addInstanced(*mesh, first, c.count, c.lod);
+    ++draws;
+  }
+  return draws;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Forget queued and recorded instances, keeping the memory
+// ====================================================================== //
+
+void InstanceBatch::clear() {
+  for (auto& g : m_groups) g.instances.clear();
+  m_instances.clear();
+  m_calls.clear();
+  m_tested = m_culled = 0u;
+}
+
+} // namespace imog
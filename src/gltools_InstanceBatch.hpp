@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include "gltools_Frustum.hpp"
+#include "gltools_Renderable.hpp"
+
+namespace imog {
+
+// Collects instances of any number of meshes during a frame and draws them
+// with one instanced call per mesh, all read from the frame stream buffer.
+// Plain CPU work, submit() hands the instances to the frame render queue.
+class InstanceBatch {
+
+public:
+  // Recorded draw: count instances of mesh at a level of detail,
+  // starting at instance first
+  struct call {
+    Handle<Renderable> mesh;
+    unsigned int       first;
+    unsigned int       count;
+    unsigned int       lod;
+  };
+
+private:
+  // Instances grouped by mesh while building
+  struct group {
+    Handle<Renderable>                 mesh;
+    std::vector<Renderable::instance> instances;
+  };
+  std::vector<group> m_groups;
+
+  // Recorded frame: instances laid out per call
+  std::vector<Renderable::instance> m_instances;
+  std::vector<call>                 m_calls;
+
+  // Kept instances of a mesh and their level of detail
+  std::vector<Renderable::instance> m_kept;
+  std::vector<unsigned int>         m_lods;
+
+  // Culling of the recorded frame
+  Frustum::spheres     m_bounds;
+  std::vector<uint8_t> m_visible;
+  unsigned int         m_tested;
+  unsigned int         m_culled;
+
+public:
+  InstanceBatch();
+
+  InstanceBatch(const InstanceBatch&) = delete;
+  InstanceBatch& operator=(const InstanceBatch&) = delete;
+
+  // Queue an instance of a mesh
+  void add(Handle<Renderable> mesh,
+           const glm::mat4&   model,
+           const glm::vec3&   color);
+
+  // Lay out the queued instances per mesh and record the calls to issue.
+  // With a frustum, instances out of it are dropped. With a camera, each
+  // instance picks its level of detail, one call per mesh and level
+  const std::vector<call>& record(const Frustum* frustum = nullptr,
+                                  const Camera*  camera  = nullptr);
+
+  // Getters for the recorded frame
+  const std::vector<call>&                 calls() const;
+  const std::vector<Renderable::instance>& instances() const;
+
+  // Write recorded instances to the frame bytes and queue the calls on
+  // the frame render queue, culling counters included. Returns the number
+  // of draw calls queued
+  unsigned int submit();
+
+  // Forget queued and recorded instances, keeping the memory
+  void clear();
+};
+
+} // namespace imog
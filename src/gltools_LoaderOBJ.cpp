@@ -1,17 +1,49 @@
 #include "gltools_Loader.hpp"
 
-#include <mutex>
-#include <sstream>
+#include <limits>
+#include <cstring>
+#include <charconv>
 #include <unordered_map>
 
 #include "cpptools_Files.hpp"
 #include "cpptools_Logger.hpp"
-#include "cpptools_Strings.hpp"
+#include "cpptools_MappedFile.hpp"
 #include "cpptools_Timer.hpp"
+#include "gltools_MeshOptimizer.hpp"
+#include "Settings.hpp"
 
 namespace imog {
 namespace loader {
 
+  // ====================================================================== //
+  // ====================================================================== //
+  // Tokenizer helpers. Work over the mapped file, no copies or allocations
+  // ====================================================================== //
+
+  static const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    return p;
+  }
+
+  static const char* parseFloat(const char* p, const char* end, float& out) {
+    p = skipBlanks(p, end);
+    if (p < end && *p == '+') ++p; // from_chars doesn't accept leading '+'
+    auto res = std::from_chars(p, end, out);
+    if (res.ec != std::errc()) out = 0.f;
+    return res.ptr;
+  }
+
+  static const char* parseInt(const char* p, const char* end, long& out) {
+    auto res = std::from_chars(p, end, out);
+    if (res.ec != std::errc()) out = 0;
+    return res.ptr;
+  }
+
+  // OBJ indices are 1-based, negative ones are relative to the last element
+  static long fixIndex(long idx, size_t count) {
+    return (idx < 0) ? static_cast<long>(count) + idx : idx - 1;
+  }
+
   // ====================================================================== //
   // ====================================================================== //
   // Wrap the process to load a 3D obj from OBJ file
@@ -23,80 +55,164 @@ namespace loader {
     Renderable::data out;
     if (!Files::ok(filePath, true)) { return out; }
 
+    MappedFile file(filePath);
+    if (!file.ok()) {
+      LOGE("Couldn't map OBJ \"{}\".", filePath);
+      return out;
+    }
+
     // --- AUX VARS ---------------------------------------------------- //
     // ----------------------------------------------------------------- //
 
-    // UVs vars
-    unsigned int                           uvIdx;
-    std::vector<glm::vec2>                 uvsTemp;
-    std::unordered_map<unsigned int, bool> uvsCache;
-    std::once_flag                         uvsOnceFlag;
-    auto resizeUVs = [&]() { out.uvs.resize(out.vertices.size()); };
-
-
-    // Normals vars
-    unsigned int                           nIdx;
-    std::vector<glm::vec3>                 normsTemp;
-    std::unordered_map<unsigned int, bool> normsCache;
-    std::once_flag                         normsOnceFlag;
-    auto resizeNorms = [&]() { out.normals.resize(out.vertices.size()); };
+    std::vector<glm::vec3> posTemp;
+    std::vector<glm::vec2> uvsTemp;
+    std::vector<glm::vec3> normsTemp;
 
-    // Faces vars
-    std::vector<std::string> face;
-    unsigned int             vIdx;
-
-    // Str vars
-    std::string       linestream;
-    std::stringstream filestream(Strings::fromFile(filePath));
+    // Face corners: position, uv and normal indices (-1 if not defined)
+    struct corner {
+      long v, vt, vn;
+      bool operator==(const corner& c) const {
+        return v == c.v && vt == c.vt && vn == c.vn;
+      }
+    };
+    struct cornerHash {
+      size_t operator()(const corner& c) const {
+        size_t h = std::hash<long>()(c.v);
+        h ^= std::hash<long>()(c.vt) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        h ^= std::hash<long>()(c.vn) + 0x9e3779b9 + (h << 6) + (h >> 2);
+        return h;
+      }
+    };
+    std::vector<corner>                                   face;
+    std::unordered_map<corner, unsigned int, cornerHash> unique;
+
+    constexpr float inf = std::numeric_limits<float>::max();
+    out.boundsMin       = glm::vec3{inf};
+    out.boundsMax       = glm::vec3{-inf};
+
+    // Store a face corner. Each different (v, vt, vn) is a vertex
+    auto emit = [&](corner c) {
+      if (c.v < 0 || c.v >= (long)posTemp.size()) return false;
+      if (c.vt >= (long)uvsTemp.size()) c.vt = -1;
+      if (c.vn >= (long)normsTemp.size()) c.vn = -1;
+
+      auto it = unique.find(c);
+      if (it == unique.end()) {
+        it = unique.emplace(c, out.vertices.size()).first;
+        out.vertices.push_back(posTemp[c.v]);
+        out.uvs.push_back((c.vt >= 0) ? uvsTemp[c.vt] : glm::vec2{0.f});
+        out.normals.push_back((c.vn >= 0) ? normsTemp[c.vn] : glm::vec3{0.f});
+      }
+      out.indices.push_back(it->second);
+      return true;
+    };
 
     // ----------------------------------------------------------------- //
     // -------------------------------------------------- / AUX VARS --- //
 
 
-    while (std::getline(filestream, linestream)) {
-      auto LINE   = Strings::split(linestream, " "); // ! First
-      auto lToken = LINE.at(0);                      // ! Second
-
-      if ((lToken == "#") || (lToken == "s")) { continue; }
-      if (lToken == "v") { out.vertices.push_back(Math::glmVec3FromStr(LINE)); }
-      if (lToken == "vt") { uvsTemp.push_back(Math::glmVec2FromStr(LINE)); }
-      if (lToken == "vn") { normsTemp.push_back(Math::glmVec3FromStr(LINE)); }
-
-      if (lToken == "f") {
-        bool thereIsUVs   = uvsTemp.size() > 0;
-        bool thereIsNorms = normsTemp.size() > 0;
-
-        // ReSize to allow the use of [] operator
-        if (thereIsUVs) std::call_once(uvsOnceFlag, resizeUVs);
-        if (thereIsNorms) std::call_once(normsOnceFlag, resizeNorms);
-
-        // Process vertex, normals and UVs indices
-        for (auto i = 1u; i < LINE.size(); ++i) {
-
-          if (thereIsUVs && thereIsNorms) {
-            face  = Strings::split(LINE.at(i), "/");
-            uvIdx = std::stoul(face.at(1)) - 1u;
-            nIdx  = std::stoul(face.at(2)) - 1u;
-          } else if (!thereIsUVs && thereIsNorms) {
-            face = Strings::split(LINE.at(i), "//");
-            nIdx = std::stoul(face.at(1)) - 1u;
-          } else if (thereIsUVs && !thereIsNorms) {
-            face  = Strings::split(LINE.at(i), "/");
-            uvIdx = std::stoul(face.at(1)) - 1u;
-          } else {
-            LOGE("[WARN] Undefined Normals and UVs @ {}", filePath);
-          }
-          vIdx = std::stoul(face.at(0)) - 1u;
+    const char* cursor = file.data();
+    const char* eof    = file.data() + file.size();
+
+    while (cursor < eof) {
+      auto nl  = (const char*)std::memchr(cursor, '\n', eof - cursor);
+      auto end = (nl) ? nl : eof;
+      auto p   = skipBlanks(cursor, end);
+      cursor   = (nl) ? nl + 1 : eof;
+
+      if (end > p && end[-1] == '\r') --end;
+      if (end - p < 2) { continue; }
+
+      // Vertex data: v, vt, vn
+      if (p[0] == 'v') {
+        glm::vec3 v{0.f};
+        if (p[1] == ' ' || p[1] == '\t') {
+          p = parseFloat(p + 1, end, v.x);
+          p = parseFloat(p, end, v.y);
+          p = parseFloat(p, end, v.z);
+          posTemp.push_back(v);
+          out.boundsMin = glm::min(out.boundsMin, v);
+          out.boundsMax = glm::max(out.boundsMax, v);
+        } else if (p[1] == 't') {
+          p = parseFloat(p + 2, end, v.x);
+          p = parseFloat(p, end, v.y);
+          uvsTemp.emplace_back(v.x, v.y);
+        } else if (p[1] == 'n') {
+          p = parseFloat(p + 2, end, v.x);
+          p = parseFloat(p, end, v.y);
+          p = parseFloat(p, end, v.z);
+          normsTemp.push_back(v);
+        }
+        continue;
+      }
 
-          // Fit on vertex index the assigned norm and uv
-          if (thereIsUVs) out.uvs[vIdx] = uvsTemp.at(uvIdx);
-          if (thereIsNorms) out.normals[vIdx] = normsTemp.at(nIdx);
+      // Faces: v, v/vt, v//vn or v/vt/vn per corner. Polygons become fans
+      if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+        face.clear();
+        p = skipBlanks(p + 1, end);
+        while (p < end) {
+          corner c{-1, -1, -1};
+          long   idx;
+          p   = parseInt(p, end, idx);
+          c.v = fixIndex(idx, posTemp.size());
+          if (p < end && *p == '/') {
+            if (++p < end && *p != '/') {
+              p    = parseInt(p, end, idx);
+              c.vt = fixIndex(idx, uvsTemp.size());
+            }
+            if (p < end && *p == '/') {
+              p    = parseInt(p + 1, end, idx);
+              c.vn = fixIndex(idx, normsTemp.size());
+            }
+          }
+          face.push_back(c);
+          // Skip whatever is left of a malformed corner
+          while (p < end && *p != ' ' && *p != '\t') ++p;
+          p = skipBlanks(p, end);
+        }
 
-          // Store vertex index
-          out.indices.push_back(vIdx);
+        for (auto i = 1u; i + 1u < face.size(); ++i) {
+          if (!emit(face[0]) || !emit(face[i]) || !emit(face[i + 1u])) {
+            LOGE("[WARN] Bad face index @ {}", filePath);
+            out.indices.resize(out.indices.size() - out.indices.size() % 3u);
+          }
         }
       }
     }
+
+    if (posTemp.empty()) out.boundsMin = out.boundsMax = glm::vec3{0.f};
+    if (uvsTemp.empty() && normsTemp.empty())
+      LOGE("[WARN] Undefined Normals and UVs @ {}", filePath);
+
+    // Triangle order for the post-transform cache, vertex order for fetch
+    auto vCount = static_cast<unsigned int>(out.vertices.size());
+    auto before = MeshOptimizer::acmr(out.indices, vCount);
+    MeshOptimizer::optimizeVertexCache(out.indices, vCount);
+    MeshOptimizer::optimizeVertexFetch(out);
+    auto after = MeshOptimizer::acmr(out.indices, out.vertices.size());
+
+    if (!Settings::quiet) {
+      LOGD("OBJ \"{}\": {} positions -> {} vertices, {} tris, ACMR {} -> {}",
+           filePath,
+           posTemp.size(),
+           out.vertices.size(),
+           out.indices.size() / 3u,
+           before,
+           after);
+    }
+
+    // Coarser levels, appended to the indices
+    MeshOptimizer::buildLods(out);
+    if (!Settings::quiet) {
+      for (auto i = 1u; i < out.lods.size(); ++i) {
+        LOGD("OBJ \"{}\": LOD {}, {} tris, error {:.3g}",
+             filePath,
+             i,
+             out.lods[i].count / 3u,
+             out.lods[i].error);
+      }
+    }
+
     return out;
   }
 
@@ -0,0 +1,249 @@
+#include "gltools_MeshCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "cpptools_Files.hpp"
+#include "cpptools_Logger.hpp"
+#include "gltools_VertexPacking.hpp"
+#include "Settings.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// File layout: header | lodCount * lodRange | vertexCount * packedVertex |
+// indexCount * (u16 | u32). Bump the version when the loader output or
+// packing changes
+// ====================================================================== //
+
+static const char     g_magic[8] = {'I', 'M', 'O', 'G', 'M', 'E', 'S', 'H'};
+static const uint32_t g_version  = 4u;
+
+// ====================================================================== //
+// ====================================================================== //
+// Constructor
+// ====================================================================== //
+
+MeshCache::MeshCache() : m_file(nullptr), m_header(nullptr) {}
+
+// ====================================================================== //
+// ====================================================================== //
+// Cache file used for an OBJ file. The name keeps the OBJ basename, and
+// a hash of the full path avoids clashes between equal basenames
+// ====================================================================== //
+
+std::string MeshCache::pathFor(const std::string& objPath) {
+  uint32_t hash = 2166136261u; // FNV-1a
+  for (unsigned char c : objPath) { hash = (hash ^ c) * 16777619u; }
+
+  auto slash = objPath.find_last_of("/\\");
+  auto base  = (slash != std::string::npos) ? objPath.substr(slash + 1u)
+                                           : objPath;
+  char hex[9];
+  std::snprintf(hex, sizeof(hex), "%08x", hash);
+  return Settings::cacheDir + base + "." + hex + ".mesh";
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Interleave the loader output in the layout used by the cache
+// ====================================================================== //
+
+std::vector<Renderable::vertex>
+    MeshCache::interleave(const Renderable::data& data) {
+  std::vector<Renderable::vertex> out(data.vertices.size());
+  for (auto i = 0u; i < out.size(); ++i) {
+    out[i].pos    = data.vertices[i];
+    out[i].normal = (i < data.normals.size()) ? data.normals[i] : glm::vec3{};
+    out[i].uv     = (i < data.uvs.size()) ? data.uvs[i] : glm::vec2{};
+  }
+  return out;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Write the cache of an OBJ file, false if it can't be written
+// ====================================================================== //
+
+bool MeshCache::store(const std::string&      objPath,
+                      const Renderable::data& data) {
+  if (data.vertices.empty() || data.indices.empty()) return false;
+
+  auto path = pathFor(objPath);
+  if (!Files::makeDir(Settings::cacheDir)) {
+    LOGE("Couldn't create mesh cache folder \"{}\".", Settings::cacheDir);
+    return false;
+  }
+
+  header h{};
+  std::memcpy(h.magic, g_magic, sizeof(g_magic));
+  h.version     = g_version;
+  h.vertexCount = data.vertices.size();
+  h.indexCount  = data.indices.size();
+  h.indexSize   = (h.vertexCount <= 0x10000u) ? 2u : 4u;
+  h.srcSize     = Files::size(objPath);
+  h.srcTime     = Files::modTime(objPath);
+  for (auto i = 0u; i < 3u; ++i) {
+    h.boundsMin[i] = data.boundsMin[i];
+    h.boundsMax[i] = data.boundsMax[i];
+  }
+
+  std::vector<lodRange> lods;
+  for (const auto& l : data.lods) lods.push_back({l.first, l.count, l.error});
+  if (lods.empty()) lods.push_back({0u, h.indexCount, 0.f});
+  h.lodCount = lods.size();
+
+  auto vertices = interleave(data);
+  auto packed   = VertexPacking::pack(
+      vertices.data(), vertices.size(), data.boundsMin, data.boundsMax);
+
+  // Once per mesh, what packing saves and what it costs
+  if (!Settings::quiet) {
+    auto e = VertexPacking::roundTrip(
+        vertices.data(), vertices.size(), data.boundsMin, data.boundsMax);
+    LOGD("Packed {} vertices of \"{}\": {} -> {} bytes, max error: "
+         "position {:.2g}, normal {:.2g} deg, uv {:.2g}",
+         vertices.size(),
+         objPath,
+         vertices.size() * sizeof(Renderable::vertex),
+         packed.size() * sizeof(Renderable::packedVertex),
+         e.position,
+         e.normalDeg,
+         e.uv);
+  }
+
+  // Write to a temp file and rename, a crash never leaves a half cache
+  auto          tmp = path + ".tmp";
+  std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  out.write(reinterpret_cast<const char*>(lods.data()),
+            lods.size() * sizeof(lodRange));
+  out.write(reinterpret_cast<const char*>(packed.data()),
+            packed.size() * sizeof(Renderable::packedVertex));
+  if (h.indexSize == 2u) {
+    std::vector<uint16_t> narrow(data.indices.begin(), data.indices.end());
+    out.write(reinterpret_cast<const char*>(narrow.data()),
+              narrow.size() * sizeof(uint16_t));
+  } else {
+    out.write(reinterpret_cast<const char*>(data.indices.data()),
+              data.indices.size() * sizeof(unsigned int));
+  }
+  out.close();
+
+  std::remove(path.c_str());
+  if (!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    LOGE("Couldn't write mesh cache \"{}\".", path);
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Map the cache of an OBJ file, false if missing or stale
+// ====================================================================== //
+
+bool MeshCache::open(const std::string& objPath) {
+  m_header = nullptr;
+  m_file   = std::make_unique<MappedFile>(pathFor(objPath));
+  if (!m_file->ok() || m_file->size() < sizeof(header)) return false;
+
+  auto h = reinterpret_cast<const header*>(m_file->data());
+  if (std::memcmp(h->magic, g_magic, sizeof(g_magic)) != 0 ||
+      h->version != g_version || h->srcSize != Files::size(objPath) ||
+      h->srcTime != Files::modTime(objPath) ||
+      (h->indexSize != 2u && h->indexSize != 4u) || h->lodCount == 0u) {
+    return false;
+  }
+
+  size_t expected = sizeof(header) + h->lodCount * sizeof(lodRange) +
+                    h->vertexCount * sizeof(Renderable::packedVertex) +
+                    h->indexCount * h->indexSize;
+  if (m_file->size() != expected) return false;
+
+  // Ranges in 64 bits, a 32-bit first + count could wrap
+  auto ranges = reinterpret_cast<const lodRange*>(h + 1);
+  for (auto i = 0u; i < h->lodCount; ++i) {
+    if (uint64_t{ranges[i].first} + ranges[i].count > h->indexCount) {
+      return false;
+    }
+  }
+
+  // Every index must point at a vertex, or draws read past the buffer
+  m_header = h;
+  if (!indicesInRange(indices(), h->indexCount, h->indexSize, h->vertexCount)) {
+    if (!Settings::quiet) LOGE("Corrupted mesh cache for \"{}\".", objPath);
+    m_header = nullptr;
+    return false;
+  }
+  return true;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Every one of count indices of indexSize bytes is below vertexCount
+// ====================================================================== //
+
+bool MeshCache::indicesInRange(const void*  indices,
+                               size_t       count,
+                               unsigned int indexSize,
+                               unsigned int vertexCount) {
+  auto below = [&](const auto* idx) {
+    for (size_t i = 0u; i < count; ++i) {
+      if (idx[i] >= vertexCount) return false;
+    }
+    return true;
+  };
+  return (indexSize == 2u) ? below(static_cast<const uint16_t*>(indices))
+                           : below(static_cast<const uint32_t*>(indices));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Is there a valid cache mapped?
+// ====================================================================== //
+
+bool MeshCache::ok() const { return m_header != nullptr; }
+
+// ====================================================================== //
+// ====================================================================== //
+// Getters for mapped data
+// ====================================================================== //
+
+std::vector<Renderable::lod> MeshCache::lods() const {
+  auto ranges = reinterpret_cast<const lodRange*>(m_header + 1);
+  std::vector<Renderable::lod> out;
+  for (auto i = 0u; i < m_header->lodCount; ++i) {
+    out.push_back({ranges[i].first, ranges[i].count, ranges[i].error});
+  }
+  return out;
+}
+
+const Renderable::packedVertex* MeshCache::vertices() const {
+  auto ranges = reinterpret_cast<const lodRange*>(m_header + 1);
+  return reinterpret_cast<const Renderable::packedVertex*>(
+      ranges + m_header->lodCount);
+}
+
+const void* MeshCache::indices() const { return vertices() + vertexCount(); }
+
+unsigned int MeshCache::vertexCount() const { return m_header->vertexCount; }
+unsigned int MeshCache::indexCount() const { return m_header->indexCount; }
+unsigned int MeshCache::indexSize() const { return m_header->indexSize; }
+
+glm::vec3 MeshCache::boundsMin() const {
+  return glm::vec3{m_header->boundsMin[0],
+                   m_header->boundsMin[1],
+                   m_header->boundsMin[2]};
+}
+
+glm::vec3 MeshCache::boundsMax() const {
+  return glm::vec3{m_header->boundsMax[0],
+                   m_header->boundsMax[1],
+                   m_header->boundsMax[2]};
+}
+
+} // namespace imog
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "gltools_Renderable.hpp"
+#include "cpptools_MappedFile.hpp"
+
+namespace imog {
+
+// Binary copy of a parsed OBJ: header, levels of detail, packed vertices
+// (quantized within the header bounds) and indices of every level (16-bit
+// when the mesh has less than 64K vertices).
+// Mapped read-only and uploaded straight to OpenGL, no parsing involved.
+// Stale caches (source size or modification time changed) are ignored.
+class MeshCache {
+
+public:
+  struct header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize; // 2 or 4 bytes
+    int64_t  srcSize;
+    int64_t  srcTime;
+    float    boundsMin[3];
+    float    boundsMax[3];
+    uint32_t lodCount;
+    uint32_t reserved[3];
+  };
+  static_assert(sizeof(header) == 80, "Keep vertex data 16-byte aligned");
+
+  struct lodRange {
+    uint32_t first;
+    uint32_t count;
+    float    error;
+    uint32_t reserved;
+  };
+  static_assert(sizeof(lodRange) == 16, "Keep vertex data 16-byte aligned");
+
+private:
+  std::unique_ptr<MappedFile> m_file;
+  const header*               m_header;
+
+  // Every one of count indices of indexSize bytes is below vertexCount
+  static bool indicesInRange(const void*  indices,
+                             size_t       count,
+                             unsigned int indexSize,
+                             unsigned int vertexCount);
+
+public:
+  MeshCache();
+
+  // Cache file used for an OBJ file
+  static std::string pathFor(const std::string& objPath);
+
+  // Interleave the loader output in the layout used by the cache
+  static std::vector<Renderable::vertex>
+      interleave(const Renderable::data& data);
+
+  // Write the cache of an OBJ file, false if it can't be written
+  static bool store(const std::string& objPath, const Renderable::data& data);
+
+  // Map the cache of an OBJ file, false if missing, stale or corrupted
+  bool open(const std::string& objPath);
+
+  // Is there a valid cache mapped?
+  bool ok() const;
+
+  // Getters for mapped data
+  std::vector<Renderable::lod>    lods() const;
+  const Renderable::packedVertex* vertices() const;
+  const void*                     indices() const;
+  unsigned int                    vertexCount() const;
+  unsigned int                    indexCount() const;
+  unsigned int                    indexSize() const;
+  glm::vec3                       boundsMin() const;
+  glm::vec3                       boundsMax() const;
+};
+
+} // namespace imog
@@ -0,0 +1,517 @@
+#include "gltools_MeshOptimizer.hpp"
+
+#include <cmath>
+#include <queue>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Forsyth's scoring, tuned for a LRU cache of 32 entries. Vertices already
+// on cache or with few triangles left to emit score higher
+// ====================================================================== //
+
+static const int   g_cacheSize    = 32;
+static const float g_cacheDecay   = 1.5f;
+static const float g_lastTriScore = 0.75f;
+static const float g_valenceScale = 2.0f;
+static const float g_valencePower = -0.5f;
+
+static float vertexScore(int cachePos, unsigned int remaining) {
+  if (remaining == 0u) return -1.f; // Not needed anymore
+
+  float score = 0.f;
+  if (cachePos >= 0) {
+    if (cachePos < 3) {
+      // Used by the last triangle, a fixed score avoids emitting it again
+      score = g_lastTriScore;
+    } else {
+      float scale = 1.f / (g_cacheSize - 3);
+      score = std::pow(1.f - (cachePos - 3) * scale, g_cacheDecay);
+    }
+  }
+  return score + g_valenceScale * std::pow((float)remaining, g_valencePower);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Squared distance to a set of planes, weighted by their triangle area.
+// Symmetric 4x4 matrix stored as its upper triangle
+// ====================================================================== //
+
+struct quadric {
+  double a[10]{};
+  double weight{0.0};
+
+  void addPlane(const glm::dvec3& n, double d, double w) {
+    const double p[4] = {n.x, n.y, n.z, d};
+    for (auto i = 0, k = 0; i < 4; ++i) {
+      for (auto j = i; j < 4; ++j) a[k++] += w * p[i] * p[j];
+    }
+    weight += w;
+  }
+
+  void add(const quadric& q) {
+    for (auto k = 0; k < 10; ++k) a[k] += q.a[k];
+    weight += q.weight;
+  }
+
+  // Mean squared distance of p to the planes
+  double error(const glm::dvec3& p) const {
+    const double v[4] = {p.x, p.y, p.z, 1.0};
+    double       e    = 0.0;
+    for (auto i = 0, k = 0; i < 4; ++i) {
+      for (auto j = i; j < 4; ++j) {
+        e += (i == j ? 1.0 : 2.0) * a[k++] * v[i] * v[j];
+      }
+    }
+    return (weight > 0.0) ? std::max(e, 0.0) / weight : 0.0;
+  }
+};
+
+// Vertex from collapsing onto vertex to. Stamps tell if they changed since
+struct collapse {
+  double       cost;
+  unsigned int from, to;
+  unsigned int fromStamp, toStamp;
+
+  bool operator>(const collapse& other) const { return cost > other.cost; }
+};
+
+// ====================================================================== //
+// ====================================================================== //
+// Average cache miss ratio on a FIFO post-transform cache
+// ====================================================================== //
+
+float MeshOptimizer::acmr(const std::vector<unsigned int>& indices,
+                          unsigned int                     vertexCount,
+                          unsigned int                     cacheSize) {
+  if (indices.size() < 3u) return 0.f;
+
+  // Timestamp of insertion per vertex. In cache if newer than the oldest
+  std::vector<unsigned int> stamp(vertexCount, 0u);
+  unsigned int              time   = cacheSize + 1u;
+  unsigned int              misses = 0u;
+
+  for (auto idx : indices) {
+    if (time - stamp[idx] > cacheSize) {
+      stamp[idx] = time++;
+      ++misses;
+    }
+  }
+  return (float)misses / (indices.size() / 3u);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Reorder triangles to reuse recently transformed vertices (Forsyth)
+// ====================================================================== //
+
+void MeshOptimizer::optimizeVertexCache(std::vector<unsigned int>& indices,
+                                        unsigned int vertexCount) {
+  const auto triCount = static_cast<unsigned int>(indices.size() / 3u);
+  if (triCount == 0u) return;
+
+  // --- Adjacency ---------------------------------------------------- //
+  // ----------------------------------------------------------------- //
+
+  std::vector<unsigned int> remaining(vertexCount, 0u);
+  for (auto idx : indices) { ++remaining[idx]; }
+
+  // CSR list of triangles per vertex
+  std::vector<unsigned int> offsets(vertexCount + 1u, 0u);
+  for (auto v = 0u; v < vertexCount; ++v) {
+    offsets[v + 1u] = offsets[v] + remaining[v];
+  }
+  std::vector<unsigned int> adjacency(indices.size());
+  {
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (auto i = 0u; i < indices.size(); ++i) {
+      adjacency[fill[indices[i]]++] = i / 3u;
+    }
+  }
+
+  // --- Scores ------------------------------------------------------- //
+  // ----------------------------------------------------------------- //
+
+  std::vector<int>   cachePos(vertexCount, -1);
+  std::vector<float> vScore(vertexCount);
+  for (auto v = 0u; v < vertexCount; ++v) {
+    vScore[v] = vertexScore(-1, remaining[v]);
+  }
+
+  std::vector<float> tScore(triCount);
+  std::vector<bool>  emitted(triCount, false);
+  for (auto t = 0u; t < triCount; ++t) {
+    const auto* tri = &indices[t * 3u];
+    tScore[t]       = vScore[tri[0]] + vScore[tri[1]] + vScore[tri[2]];
+  }
+
+  // Live triangle list per vertex: the first `remaining` entries
+  auto trisOf = [&](unsigned int v) { return &adjacency[offsets[v]]; };
+
+  // Rescore a vertex and move the difference to its live triangles
+  auto updateScore = [&](unsigned int v) {
+    auto score = vertexScore(cachePos[v], remaining[v]);
+    auto diff  = score - vScore[v];
+    vScore[v]  = score;
+    for (auto k = 0u; k < remaining[v]; ++k) { tScore[trisOf(v)[k]] += diff; }
+  };
+
+  // --- Emit --------------------------------------------------------- //
+  // ----------------------------------------------------------------- //
+
+  std::vector<unsigned int> out;
+  out.reserve(indices.size());
+
+  std::vector<unsigned int> cache, newCache;
+  cache.reserve(g_cacheSize + 3);
+  newCache.reserve(g_cacheSize + 3);
+
+  unsigned int scanCursor = 0u;
+  unsigned int best       = 0u;
+  float        bestScore  = -1.f;
+  for (auto t = 0u; t < triCount; ++t) {
+    if (tScore[t] > bestScore) {
+      bestScore = tScore[t];
+      best      = t;
+    }
+  }
+
+  for (auto n = 0u; n < triCount; ++n) {
+
+    // Nothing adjacent to the cache: take the next one not emitted
+    if (bestScore < 0.f) {
+      while (emitted[scanCursor]) ++scanCursor;
+      best = scanCursor;
+    }
+
+    const unsigned int tri[3] = {indices[best * 3u],
+                                 indices[best * 3u + 1u],
+                                 indices[best * 3u + 2u]};
+    out.insert(out.end(), tri, tri + 3);
+    emitted[best] = true;
+
+    // Drop the triangle from the live lists of its vertices
+    for (auto v : tri) {
+      auto* list = trisOf(v);
+      auto* last = list + remaining[v];
+      auto* it   = std::find(list, last, best);
+      if (it != last) {
+        std::swap(*it, *(last - 1));
+        --remaining[v];
+      }
+    }
+
+    // New cache: this triangle on front, then the previous content
+    newCache.assign(tri, tri + 3);
+    for (auto v : cache) {
+      if (v != tri[0] && v != tri[1] && v != tri[2]) newCache.push_back(v);
+    }
+    for (auto i = (size_t)g_cacheSize; i < newCache.size(); ++i) {
+      cachePos[newCache[i]] = -1; // Evicted
+      updateScore(newCache[i]);
+    }
+    if (newCache.size() > (size_t)g_cacheSize) newCache.resize(g_cacheSize);
+    std::swap(cache, newCache);
+
+    for (auto i = 0u; i < cache.size(); ++i) cachePos[cache[i]] = i;
+    for (auto v : cache) updateScore(v);
+
+    // Next triangle: the best one touching the cache
+    bestScore = -1.f;
+    for (auto v : cache) {
+      for (auto k = 0u; k < remaining[v]; ++k) {
+        auto t = trisOf(v)[k];
+        if (tScore[t] > bestScore) {
+          bestScore = tScore[t];
+          best      = t;
+        }
+      }
+    }
+  }
+
+  indices.swap(out);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Reorder vertices by first use on the index buffer, so fetches are
+// sequential. Indices are remapped to the new order
+// ====================================================================== //
+
+void MeshOptimizer::optimizeVertexFetch(Renderable::data& data) {
+  const auto count = static_cast<unsigned int>(data.vertices.size());
+  std::vector<unsigned int> remap(count, ~0u);
+  unsigned int              next = 0u;
+
+  for (auto& idx : data.indices) {
+    if (remap[idx] == ~0u) remap[idx] = next++;
+    idx = remap[idx];
+  }
+
+  // Unreferenced vertices are dropped
+  auto reorder = [&](auto& attrib) {
+    if (attrib.size() != count) return;
+    std::decay_t<decltype(attrib)> sorted(next);
+    for (auto v = 0u; v < count; ++v) {
+      if (remap[v] != ~0u) sorted[remap[v]] = attrib[v];
+    }
+    attrib.swap(sorted);
+  };
+  reorder(data.vertices);
+  reorder(data.normals);
+  reorder(data.uvs);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Levels of detail by quadric error simplification (Garland-Heckbert).
+// Topology and quadrics work on positions, so vertices split by normal or
+// uv (seams, flat shading) collapse together. Each level then picks, per
+// corner, the vertex at its new position with the closest attributes.
+// Border and non-manifold vertices don't move, collapses folding a
+// triangle over are skipped
+// ====================================================================== //
+
+void MeshOptimizer::buildLods(Renderable::data& data,
+                              unsigned int      maxLods,
+                              unsigned int      minTriangles) {
+  const auto vertexCount = static_cast<unsigned int>(data.vertices.size());
+  const auto triCount    = static_cast<unsigned int>(data.indices.size() / 3u);
+  data.lods.assign(1u, {0u, triCount * 3u, 0.f});
+  if (maxLods < 2u || triCount / 2u < minTriangles) return;
+
+  // --- Weld --------------------------------------------------------- //
+  // ----------------------------------------------------------------- //
+
+  // Sorted by position, equal ones are consecutive: welded vertex w is
+  // members[groups[w]] to members[groups[w + 1] - 1]
+  std::vector<unsigned int> members(vertexCount);
+  std::iota(members.begin(), members.end(), 0u);
+  std::sort(members.begin(), members.end(), [&](auto a, auto b) {
+    const auto &pa = data.vertices[a], &pb = data.vertices[b];
+    if (pa.x != pb.x) return pa.x < pb.x;
+    if (pa.y != pb.y) return pa.y < pb.y;
+    return pa.z < pb.z;
+  });
+
+  std::vector<unsigned int> welded(vertexCount);
+  std::vector<unsigned int> groups;
+  std::vector<glm::dvec3>   pos;
+  for (auto i = 0u; i < vertexCount; ++i) {
+    const auto& p = data.vertices[members[i]];
+    if (i == 0u || p != data.vertices[members[i - 1u]]) {
+      groups.push_back(i);
+      pos.push_back(glm::dvec3(p));
+    }
+    welded[members[i]] = groups.size() - 1u;
+  }
+  const auto weldCount = static_cast<unsigned int>(groups.size());
+  groups.push_back(vertexCount);
+
+  // --- Triangles, quadrics and borders ------------------------------ //
+  // ----------------------------------------------------------------- //
+
+  std::vector<unsigned int> tris(triCount * 3u);
+  std::vector<uint8_t>      alive(triCount, 1u);
+  std::vector<quadric>      quadrics(weldCount);
+  unsigned int              live = 0u;
+
+  std::unordered_map<uint64_t, unsigned int> edgeUses;
+  auto edgeKey = [](unsigned int a, unsigned int b) {
+    return ((uint64_t)std::min(a, b) << 32) | std::max(a, b);
+  };
+
+  for (auto t = 0u; t < triCount; ++t) {
+    auto* c = &tris[t * 3u];
+    for (auto k = 0u; k < 3u; ++k) c[k] = welded[data.indices[t * 3u + k]];
+
+    auto n   = glm::cross(pos[c[1]] - pos[c[0]], pos[c[2]] - pos[c[0]]);
+    auto len = glm::length(n);
+    if (c[0] == c[1] || c[1] == c[2] || c[2] == c[0] || len <= 0.0) {
+      alive[t] = 0u;
+      continue;
+    }
+    ++live;
+    n /= len;
+    for (auto k = 0u; k < 3u; ++k) {
+      quadrics[c[k]].addPlane(n, -glm::dot(n, pos[c[0]]), len * 0.5);
+      ++edgeUses[edgeKey(c[k], c[(k + 1u) % 3u])];
+    }
+  }
+
+  std::vector<uint8_t> locked(weldCount, 0u);
+  for (const auto& e : edgeUses) {
+    if (e.second == 2u) continue;
+    locked[e.first >> 32]         = 1u;
+    locked[e.first & 0xFFFFFFFFu] = 1u;
+  }
+
+  std::vector<std::vector<unsigned int>> trisOf(weldCount);
+  for (auto t = 0u; t < triCount; ++t) {
+    if (!alive[t]) continue;
+    for (auto k = 0u; k < 3u; ++k) trisOf[tris[t * 3u + k]].push_back(t);
+  }
+
+  // --- Candidate collapses ------------------------------------------ //
+  // ----------------------------------------------------------------- //
+
+  std::vector<uint8_t>      dead(weldCount, 0u);
+  std::vector<unsigned int> stamp(weldCount, 0u);
+  std::priority_queue<collapse, std::vector<collapse>, std::greater<collapse>>
+      heap;
+
+  // Cheapest direction of an edge, locked vertices only receive
+  auto consider = [&](unsigned int a, unsigned int b) {
+    if (locked[a] && locked[b]) return;
+    auto q = quadrics[a];
+    q.add(quadrics[b]);
+    auto aToB = locked[a] ? HUGE_VAL : q.error(pos[b]);
+    auto bToA = locked[b] ? HUGE_VAL : q.error(pos[a]);
+    if (aToB <= bToA) {
+      heap.push({aToB, a, b, stamp[a], stamp[b]});
+    } else {
+      heap.push({bToA, b, a, stamp[b], stamp[a]});
+    }
+  };
+  for (auto t = 0u; t < triCount; ++t) {
+    if (!alive[t]) continue;
+    const auto* c = &tris[t * 3u];
+    for (auto k = 0u; k < 3u; ++k) {
+      if (c[k] < c[(k + 1u) % 3u]) consider(c[k], c[(k + 1u) % 3u]);
+    }
+  }
+
+  // --- Levels ------------------------------------------------------- //
+  // ----------------------------------------------------------------- //
+
+  // Vertex at welded w with the attributes closest to original vertex v
+  auto pick = [&](unsigned int w, unsigned int v) {
+    if (welded[v] == w) return v;
+    auto  best = members[groups[w]];
+    float dist = INFINITY;
+    for (auto i = groups[w]; i < groups[w + 1u]; ++i) {
+      auto  m = members[i];
+      float d = 0.f;
+      if (data.normals.size() == vertexCount) {
+        auto dn = data.normals[m] - data.normals[v];
+        d += glm::dot(dn, dn);
+      }
+      if (data.uvs.size() == vertexCount) {
+        auto du = data.uvs[m] - data.uvs[v];
+        d += glm::dot(du, du);
+      }
+      if (d < dist) {
+        dist = d;
+        best = m;
+      }
+    }
+    return best;
+  };
+
+  double maxError = 0.0;
+  auto   snapshot = [&]() {
+    std::vector<unsigned int> level;
+    level.reserve(live * 3u);
+    for (auto t = 0u; t < triCount; ++t) {
+      if (!alive[t]) continue;
+      for (auto k = 0u; k < 3u; ++k) {
+        level.push_back(pick(tris[t * 3u + k], data.indices[t * 3u + k]));
+      }
+    }
+    optimizeVertexCache(level, vertexCount);
+
+    auto first = static_cast<unsigned int>(data.indices.size());
+    data.indices.insert(data.indices.end(), level.begin(), level.end());
+    data.lods.push_back({first,
+                         static_cast<unsigned int>(level.size()),
+                         static_cast<float>(std::sqrt(maxError))});
+  };
+
+  // --- Collapse ----------------------------------------------------- //
+  // ----------------------------------------------------------------- //
+
+  auto target = live / 2u;
+  while (!heap.empty() && data.lods.size() < maxLods) {
+    auto c = heap.top();
+    heap.pop();
+    if (dead[c.from] || dead[c.to] || stamp[c.from] != c.fromStamp ||
+        stamp[c.to] != c.toStamp) {
+      continue;
+    }
+
+    // Triangles left must keep facing the same side
+    auto folds = false;
+    for (auto t : trisOf[c.from]) {
+      const auto* tc = &tris[t * 3u];
+      if (!alive[t] || tc[0] == c.to || tc[1] == c.to || tc[2] == c.to) {
+        continue;
+      }
+      glm::dvec3 p[3], q[3];
+      for (auto k = 0u; k < 3u; ++k) {
+        p[k] = pos[tc[k]];
+        q[k] = (tc[k] == c.from) ? pos[c.to] : p[k];
+      }
+      auto before = glm::cross(p[1] - p[0], p[2] - p[0]);
+      auto after  = glm::cross(q[1] - q[0], q[2] - q[0]);
+      if (glm::dot(before, after) <=
+          0.25 * glm::length(before) * glm::length(after)) {
+        folds = true;
+        break;
+      }
+    }
+    if (folds) continue;
+
+    // Collapse: shared triangles die, the rest move to the target
+    maxError      = std::max(maxError, c.cost);
+    dead[c.from]  = 1u;
+    quadrics[c.to].add(quadrics[c.from]);
+    ++stamp[c.to];
+    for (auto t : trisOf[c.from]) {
+      if (!alive[t]) continue;
+      auto* tc = &tris[t * 3u];
+      if (tc[0] == c.to || tc[1] == c.to || tc[2] == c.to) {
+        alive[t] = 0u;
+        --live;
+        continue;
+      }
+      for (auto k = 0u; k < 3u; ++k) {
+        if (tc[k] == c.from) tc[k] = c.to;
+      }
+      trisOf[c.to].push_back(t);
+    }
+    trisOf[c.from].clear();
+
+    // Edges around the target changed cost
+    auto& around = trisOf[c.to];
+    around.erase(std::remove_if(around.begin(),
+                                around.end(),
+                                [&](auto t) { return !alive[t]; }),
+                 around.end());
+    for (auto t : around) {
+      for (auto k = 0u; k < 3u; ++k) {
+        auto w = tris[t * 3u + k];
+        if (w != c.to) consider(c.to, w);
+      }
+    }
+
+    if (live <= target) {
+      snapshot();
+      target = live / 2u;
+      if (target < minTriangles) break;
+    }
+  }
+
+  // Stuck before a target (locked borders), keep it if it's worth it
+  auto last = data.lods.back().count / 3u;
+  if (data.lods.size() < maxLods && live >= minTriangles &&
+      live * 4u <= last * 3u) {
+    snapshot();
+  }
+}
+
+} // namespace imog
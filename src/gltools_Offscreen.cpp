@@ -0,0 +1,193 @@
+#include "gltools_Offscreen.hpp"
+
+#include "cpptools_Logger.hpp"
+#include "helpers/GLAssert.hpp"
+
+#if __has_include(<EGL/egl.h>)
+#define IMOG_EGL
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace imog {
+
+#ifdef IMOG_EGL
+// Windowless context, made by contextInit
+static EGLDisplay g_display = EGL_NO_DISPLAY;
+static EGLContext g_context = EGL_NO_CONTEXT;
+#endif
+
+// ====================================================================== //
+// ====================================================================== //
+// Create a windowless context and make it current. Surfaceless platform
+// first (no display server needed), default display otherwise
+// ====================================================================== //
+
+bool Offscreen::contextInit(int major, int minor) {
+#ifdef IMOG_EGL
+  EGLDisplay display = EGL_NO_DISPLAY;
+
+  auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+      "eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay) {
+    display = getPlatformDisplay(
+        EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+  }
+  if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+  EGLint eglMajor, eglMinor;
+  if (display == EGL_NO_DISPLAY ||
+      !eglInitialize(display, &eglMajor, &eglMinor)) {
+    LOGE("Couldn't initialize EGL");
+    return false;
+  }
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    LOGE("EGL has no desktop OpenGL");
+    return false;
+  }
+
+  // No surface is ever drawn, any OpenGL config will do (or none at all)
+  EGLint    configAttribs[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config          = nullptr;
+  EGLint    configs         = 0;
+  eglChooseConfig(display, configAttribs, &config, 1, &configs);
+
+  EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION,
+                             major,
+                             EGL_CONTEXT_MINOR_VERSION,
+                             minor,
+                             EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                             EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifdef DEBUG
+                             EGL_CONTEXT_OPENGL_DEBUG,
+                             EGL_TRUE,
+#endif
+                             EGL_NONE};
+  auto context = eglCreateContext(display,
+                                  (configs > 0) ? config : EGL_NO_CONFIG_KHR,
+                                  EGL_NO_CONTEXT,
+                                  contextAttribs);
+  if (context == EGL_NO_CONTEXT) {
+    LOGE("Couldn't create an OpenGL {}.{} EGL context", major, minor);
+    return false;
+  }
+  g_display = display;
+  g_context = context;
+  return makeCurrent(true);
+#else
+  LOGE("Rendering without window needs EGL, not available on this build");
+  return false;
+#endif
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// OpenGL function loader for the windowless context
+// ====================================================================== //
+
+void* Offscreen::procAddress(const char* name) {
+#ifdef IMOG_EGL
+  return (void*)eglGetProcAddress(name);
+#else
+  return nullptr;
+#endif
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Make the windowless context current on the calling thread, or release it
+// ====================================================================== //
+
+bool Offscreen::makeCurrent(bool current) {
+#ifdef IMOG_EGL
+  auto context = (current) ? g_context : EGL_NO_CONTEXT;
+  if (!eglMakeCurrent(g_display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+    LOGE("Couldn't make current a context without surface");
+    return false;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Param constructor. Needs a current context
+// ====================================================================== //
+
+Offscreen::Offscreen(int width, int height)
+    : m_fbo(0u), m_color(0u), m_depth(0u), m_width(0), m_height(0) {
+  GL_ASSERT(glGenFramebuffers(1, &m_fbo));
+  this->resize(width, height);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Destructor
+// ====================================================================== //
+
+Offscreen::~Offscreen() {
+  GL_ASSERT(glDeleteRenderbuffers(1, &m_color));
+  GL_ASSERT(glDeleteRenderbuffers(1, &m_depth));
+  GL_ASSERT(glDeleteFramebuffers(1, &m_fbo));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// (Re)create color (RGBA8) and depth (24 bits) attachments
+// ====================================================================== //
+
+void Offscreen::resize(int width, int height) {
+  if (width == m_width && height == m_height) return;
+  m_width  = width;
+  m_height = height;
+
+  GL_ASSERT(glDeleteRenderbuffers(1, &m_color));
+  GL_ASSERT(glDeleteRenderbuffers(1, &m_depth));
+  GL_ASSERT(glGenRenderbuffers(1, &m_color));
+  GL_ASSERT(glGenRenderbuffers(1, &m_depth));
+
+  GL_ASSERT(glBindRenderbuffer(GL_RENDERBUFFER, m_color));
+  GL_ASSERT(glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height));
+  GL_ASSERT(glBindRenderbuffer(GL_RENDERBUFFER, m_depth));
+  GL_ASSERT(glRenderbufferStorage(
+      GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height));
+  GL_ASSERT(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+
+  GLint previous = 0;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+  GL_ASSERT(glBindFramebuffer(GL_FRAMEBUFFER, m_fbo));
+  GL_ASSERT(glFramebufferRenderbuffer(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_color));
+  GL_ASSERT(glFramebufferRenderbuffer(
+      GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depth));
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    LOGE("Offscreen framebuffer {}x{} is incomplete", width, height);
+  }
+  GL_ASSERT(glBindFramebuffer(GL_FRAMEBUFFER, previous));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Draw and read from this framebuffer, or back to the default one
+// ====================================================================== //
+
+void Offscreen::bind() {
+  GL_ASSERT(glBindFramebuffer(GL_FRAMEBUFFER, m_fbo));
+  GL_ASSERT(glViewport(0, 0, m_width, m_height));
+}
+
+void Offscreen::unbind() { GL_ASSERT(glBindFramebuffer(GL_FRAMEBUFFER, 0)); }
+
+// ====================================================================== //
+// ====================================================================== //
+// Getters
+// ====================================================================== //
+
+unsigned int Offscreen::fbo() const { return m_fbo; }
+int          Offscreen::width() const { return m_width; }
+int          Offscreen::height() const { return m_height; }
+
+} // namespace imog
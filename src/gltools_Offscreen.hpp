@@ -0,0 +1,47 @@
+#pragma once
+
+namespace imog {
+
+// Rendering with no window. The context comes from EGL without a surface
+// (Mesa llvmpipe runs it with no display nor GPU) and frames are drawn to
+// a framebuffer object of the window size instead of the screen.
+class Offscreen {
+
+  unsigned int m_fbo;
+  unsigned int m_color;
+  unsigned int m_depth;
+  int          m_width;
+  int          m_height;
+
+public:
+  // Create a windowless context and make it current. False if EGL isn't
+  // available on this platform or can't give the requested version
+  static bool contextInit(int major, int minor);
+
+  // OpenGL function loader for the windowless context
+  static void* procAddress(const char* name);
+
+  // Make the windowless context current on the calling thread, or release
+  // it. A context is current on one thread at a time
+  static bool makeCurrent(bool current);
+
+  Offscreen(int width, int height);
+  ~Offscreen();
+
+  Offscreen(const Offscreen&) = delete;
+  Offscreen& operator=(const Offscreen&) = delete;
+
+  // (Re)create color and depth attachments
+  void resize(int width, int height);
+
+  // Draw and read from this framebuffer
+  void bind();
+  void unbind();
+
+  // Getters
+  unsigned int fbo() const;
+  int          width() const;
+  int          height() const;
+};
+
+} // namespace imog
@@ -0,0 +1,166 @@
+#include "gltools_ProgramCache.hpp"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <glad/glad.h>
+
+#include "Settings.hpp"
+#include "cpptools_Files.hpp"
+#include "cpptools_Logger.hpp"
+#include "cpptools_StringID.hpp"
+#include "cpptools_MappedFile.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// File layout: header | length bytes of driver binary
+// Bump the version when the key or the layout change
+// ====================================================================== //
+
+static const char     g_magic[8] = {'I', 'M', 'O', 'G', 'P', 'R', 'O', 'G'};
+static const uint32_t g_version  = 1u;
+
+// ====================================================================== //
+// ====================================================================== //
+// Can this context save and load program binaries?
+// ====================================================================== //
+
+bool ProgramCache::supported() {
+  static const bool ok = []() {
+    if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary) return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+  }();
+  return ok;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Key for a program: its sources, driver strings and defines. A driver
+// update changes the version string and invalidates every binary
+// ====================================================================== //
+
+uint64_t ProgramCache::key(const std::vector<std::string>& sources,
+                           const std::string&              defines) {
+  static const std::string driver = []() {
+    std::string s;
+    for (auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+      auto str = reinterpret_cast<const char*>(glGetString(name));
+      s += (str) ? str : "";
+      s += '\n';
+    }
+    return s;
+  }();
+
+  // Each piece ends with a 0 so moving chars between them changes the key
+  auto all = driver + '\0' + defines + '\0';
+  for (const auto& src : sources) { all += src + '\0'; }
+  return StringID::hash(all.data(), all.size());
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Cache file used for a program. Every permutation has its own key, and so
+// its own file. Chars other than letters, digits and _ are _ on the name
+// ====================================================================== //
+
+std::string ProgramCache::pathFor(const std::string& name, uint64_t key) {
+  auto base = name;
+  for (auto& c : base) {
+    if (!std::isalnum(static_cast<unsigned char>(c))) c = '_';
+  }
+
+  char hex[17];
+  std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+  return Settings::cacheDir + base + "." + hex + ".prog";
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Load a cached binary into program, false if missing, stale or rejected.
+// Drivers may reject a binary they wrote (e.g. other GPU on the same
+// version), then the file is removed and the program built from source
+// ====================================================================== //
+
+bool ProgramCache::load(unsigned int       program,
+                        const std::string& name,
+                        uint64_t           key) {
+  if (!supported()) return false;
+
+  auto       path = pathFor(name, key);
+  MappedFile file(path);
+  if (!file.ok() || file.size() < sizeof(header)) return false;
+
+  auto h = reinterpret_cast<const header*>(file.data());
+  if (std::memcmp(h->magic, g_magic, sizeof(g_magic)) != 0 ||
+      h->version != g_version || h->key != key ||
+      file.size() != sizeof(header) + h->length) {
+    return false;
+  }
+
+  glProgramBinary(program, h->format, h + 1, h->length);
+
+  GLint linked = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linked);
+  if (!linked) {
+    if (!Settings::quiet) LOGD("Program binary \"{}\" rejected.", path);
+    std::remove(path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Save the binary of a linked program, false if it can't be written
+// ====================================================================== //
+
+bool ProgramCache::store(unsigned int       program,
+                         const std::string& name,
+                         uint64_t           key) {
+  if (!supported()) return false;
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) return false;
+
+  std::vector<char> binary(length);
+  GLenum            format = 0;
+  glGetProgramBinary(program, length, &length, &format, binary.data());
+  if (length <= 0) return false;
+
+  if (!Files::makeDir(Settings::cacheDir)) {
+    LOGE("Couldn't create program cache folder \"{}\".", Settings::cacheDir);
+    return false;
+  }
+
+  header h{};
+  std::memcpy(h.magic, g_magic, sizeof(g_magic));
+  h.version = g_version;
+  h.format  = format;
+  h.key     = key;
+  h.length  = length;
+
+  // Write to a temp file and rename, a crash never leaves a half binary
+  auto          path = pathFor(name, key);
+  auto          tmp  = path + ".tmp";
+  std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  out.write(binary.data(), length);
+  out.close();
+
+  std::remove(path.c_str());
+  if (!out || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    LOGE("Couldn't write program binary \"{}\".", path);
+    std::remove(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+} // namespace imog
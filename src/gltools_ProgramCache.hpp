@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace imog {
+
+// Linked programs saved with glGetProgramBinary and loaded back with
+// glProgramBinary, skipping compile and link. Keyed by the final sources
+// (defines included) and the driver vendor, renderer and version, so any
+// change on them misses the cache and the program is built from source.
+// Needs OpenGL 4.1 or ARB_get_program_binary, without them it never hits.
+class ProgramCache {
+
+public:
+  struct header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t format; // Driver binary format
+    uint64_t key;
+    uint32_t length; // Binary bytes after the header
+    uint32_t pad;
+  };
+  static_assert(sizeof(header) == 32, "Fixed size header");
+
+  // Can this context save and load program binaries?
+  static bool supported();
+
+  // Key for a program: its sources, driver strings and defines
+  static uint64_t key(const std::vector<std::string>& sources,
+                      const std::string&              defines);
+
+  // Cache file used for a program
+  static std::string pathFor(const std::string& name, uint64_t key);
+
+  // Load a cached binary into program, false if missing, stale or rejected
+  static bool load(unsigned int program, const std::string& name, uint64_t key);
+
+  // Save the binary of a linked program, false if it can't be written
+  static bool store(unsigned int       program,
+                    const std::string& name,
+                    uint64_t           key);
+};
+
+} // namespace imog
@@ -0,0 +1,492 @@
+#include "gltools_RenderQueue.hpp"
+
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include "gltools_GLState.hpp"
+#include "gltools_Renderable.hpp"
+#include "cpptools_Logger.hpp"
+#include "helpers/GLAssert.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Compose a sort key. Indices wider than their field are wrapped
+// ====================================================================== //
+
+uint64_t RenderQueue::key(unsigned int shader,
+                          unsigned int texture,
+                          unsigned int vao,
+                          bool         culling,
+                          float        depth) {
+  constexpr uint64_t depthMax = (1ull << 27) - 1ull;
+  auto quantized = (uint64_t)(glm::clamp(depth, 0.f, 1.f) * depthMax);
+
+  return ((uint64_t)(shader & 0x3FFu) << 54) |
+         ((uint64_t)(texture & 0x3FFu) << 44) | ((uint64_t)(!culling) << 43) |
+         ((uint64_t)(vao & 0xFFFFu) << 27) | quantized;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Texture array layer a renderable samples, -1 for none (or not ready)
+// ====================================================================== //
+
+static float layerOf(const Renderable& r) {
+  const auto& texture = r.texture();
+  return (texture) ? static_cast<float>(texture->layer()) : -1.f;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Milliseconds between two time points, 0 if b comes first
+// ====================================================================== //
+
+static double millis(const TimePoint& a, const TimePoint& b) {
+  return std::max(0.0, (b - a).count() * 1000.0);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Add a draw with the key of its renderable state. Textures key by their
+// array, so draws with any texture of the same size share a bind
+// ====================================================================== //
+
+void RenderQueue::push(const draw& d, float depth, const glm::vec4& sphere) {
+  auto&       l       = m_lists[m_record];
+  const auto& r       = *d.renderable;
+  const auto& texture = r.texture();
+  auto        array   = (texture) ? texture->array() : nullptr;
+  auto        texIdx  = (array) ? array->index() + 1u : 0u;
+
+  auto k = key(r.shader()->handle().index, texIdx, r.vao(), r.culling(), depth);
+  l.items.push_back({k, static_cast<unsigned int>(l.draws.size())});
+  l.draws.push_back(d);
+  l.bounds.push(sphere);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Drop the draws of the list out of its camera frustum. Spheres are
+// tested in batches, then surviving items are compacted in place
+// ====================================================================== //
+
+void RenderQueue::cull(list& l) {
+  Frustum frustum(l.camera.viewproj);
+  frustum.test(l.bounds, m_visible);
+
+  auto kept = 0u;
+  for (const auto& it : l.items) {
+    if (l.draws[it.index].count == 0u) ++m_stats.tested;
+    if (m_visible[it.index]) {
+      l.items[kept++] = it;
+    } else {
+      ++m_stats.culled;
+    }
+  }
+  l.items.resize(kept);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Forget the commands of a list, keeping the memory
+// ====================================================================== //
+
+void RenderQueue::clear(list& l) {
+  l.items.clear();
+  l.draws.clear();
+  l.bounds.clear();
+  l.bytes.clear();
+  l.tasks.clear();
+  l.tested = l.culled = l.allocs = 0u;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Depth of a point for the sort key: NDC depth, front to back inside the
+// same state
+// ====================================================================== //
+
+static float depthOf(const glm::vec3& p, const std::shared_ptr<Camera>& camera) {
+  auto clip = camera->viewproj() * glm::vec4(p, 1.f);
+  return (clip.w > 0.f) ? (clip.z / clip.w) * 0.5f + 0.5f : 0.f;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Record a plain draw of a renderable. Depth is taken from camera
+// ====================================================================== //
+
+void RenderQueue::add(Renderable&                    renderable,
+                      const glm::mat4&               model,
+                      const glm::vec3&               color,
+                      const std::shared_ptr<Camera>& camera) {
+  auto depth  = depthOf(model[3].xyz(), camera);
+  auto sphere = Frustum::sphere(
+      renderable.boundsMin(), renderable.boundsMax(), model);
+  auto lod = renderable.lodFor(sphere, *camera);
+  push({&renderable, model, color, 0u, 0u, lod, false}, depth, sphere);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Record an instanced draw of a renderable
+// ====================================================================== //
+
+void RenderQueue::addInstanced(Renderable&  renderable,
+                               size_t       offset,
+                               unsigned int count,
+                               unsigned int lod) {
+  if (count == 0u) return;
+  constexpr float always = std::numeric_limits<float>::infinity();
+  push({&renderable, glm::mat4(1.f), glm::vec3(0.f), offset, count, lod, false},
+       0.f,
+       glm::vec4(0.f, 0.f, 0.f, always));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Record a draw of a streamed renderable. Its vertices are in world
+// space: identity model, culled by the sphere of their bounds
+// ====================================================================== //
+
+void RenderQueue::addStreamed(Renderable&                    renderable,
+                              size_t                         offset,
+                              const glm::vec3&               boundsMin,
+                              const glm::vec3&               boundsMax,
+                              const glm::vec3&               color,
+                              const std::shared_ptr<Camera>& camera) {
+  auto model  = glm::mat4(1.f);
+  auto sphere = Frustum::sphere(boundsMin, boundsMax, model);
+  auto depth  = depthOf(sphere.xyz(), camera);
+  push({&renderable, model, color, offset, 0u, 0u, true}, depth, sphere);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Room for size bytes on the frame bytes, returns its offset
+// ====================================================================== //
+
+size_t RenderQueue::alloc(size_t size, size_t align) {
+  auto& l      = m_lists[m_record];
+  auto  offset = (l.bytes.size() + align - 1u) / align * align;
+  l.bytes.resize(offset + size);
+  ++l.allocs;
+  return offset;
+}
+
+char* RenderQueue::data(size_t offset) {
+  return m_lists[m_record].bytes.data() + offset;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Run fn on the render thread before the draws of this frame
+// ====================================================================== //
+
+void RenderQueue::defer(std::function<void()> fn) {
+  m_lists[m_record].tasks.push_back(std::move(fn));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Account objects culled before being recorded (e.g. instances)
+// ====================================================================== //
+
+void RenderQueue::countCulling(unsigned int tested, unsigned int culled) {
+  m_lists[m_record].tested += tested;
+  m_lists[m_record].culled += culled;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Mark the start of the update of a frame, for the time breakdown
+// ====================================================================== //
+
+void RenderQueue::begin() { m_lists[m_record].begin = StdClock::now(); }
+
+// ====================================================================== //
+// ====================================================================== //
+// Hand the recorded frame to the render thread. Waits while the previous
+// one executes, so at most one frame is recorded ahead of the screen
+// ====================================================================== //
+
+void RenderQueue::publish(const std::shared_ptr<Camera>& camera) {
+  auto& recorded  = m_lists[m_record];
+  recorded.camera = {camera->view(), camera->proj(), camera->viewproj()};
+  recorded.end    = StdClock::now();
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_handoff.wait(lock, [&]() { return !m_published || m_closed; });
+  recorded.waitMs = millis(recorded.end, StdClock::now());
+  m_record ^= 1u;
+  m_published = true;
+  m_deferred  = !recorded.tasks.empty();
+  m_handoff.notify_all();
+
+  // Deferred work may touch what recording does (pools, scene graph), the
+  // next frame waits for it
+  if (m_threaded) {
+    m_handoff.wait(lock, [&]() { return !m_deferred || m_closed; });
+  }
+  lock.unlock();
+
+  // Executed already, record the next frame on it
+  auto& next = m_lists[m_record];
+  clear(next);
+  next.begin = StdClock::now();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Is a render thread executing the published frames?
+// ====================================================================== //
+
+bool RenderQueue::threaded() const { return m_threaded; }
+
+void RenderQueue::threaded(bool value) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_threaded = value;
+    m_closed   = !value;
+  }
+  m_handoff.notify_all();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Wait for a published frame and run its deferred work. False if
+// threaded was turned off and nothing is left. Starts the counters of the
+// frame: the overlap is the part of its recording done while the previous
+// one was submitted
+// ====================================================================== //
+
+bool RenderQueue::acquire() {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_handoff.wait(lock, [&]() { return m_published || m_closed; });
+  if (!m_published) return false;
+
+  const auto& l     = m_lists[m_record ^ 1u];
+  m_stats           = stats{};
+  m_stats.recordMs  = millis(l.begin, l.end);
+  m_stats.waitMs    = l.waitMs;
+  m_stats.overlapMs = millis(std::max(l.begin, m_submitBegin),
+                             std::min(l.end, m_submitEnd));
+  m_submitBegin     = StdClock::now();
+  lock.unlock();
+
+  for (auto& task : m_lists[m_record ^ 1u].tasks) task();
+  {
+    std::lock_guard<std::mutex> relock(m_mutex);
+    m_deferred = false;
+  }
+  m_handoff.notify_all();
+  return true;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Camera the acquired frame was recorded with
+// ====================================================================== //
+
+const RenderQueue::eye& RenderQueue::camera() const {
+  return m_lists[m_record ^ 1u].camera;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Give the executed list back to the update thread
+// ====================================================================== //
+
+void RenderQueue::release() {
+  m_submitEnd      = StdClock::now();
+  m_stats.submitMs = millis(m_submitBegin, m_submitEnd);
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_published = false;
+  }
+  m_handoff.notify_all();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Sort recorded draws by key. LSD radix sort, 8 bits per pass, passes
+// where every key has the same byte are skipped
+// ====================================================================== //
+
+void RenderQueue::sort() {
+  auto& items = m_lists[m_record ^ 1u].items;
+  if (items.empty()) return;
+  m_scratch.resize(items.size());
+
+  for (auto shift = 0u; shift < 64u; shift += 8u) {
+    unsigned int count[256] = {};
+    for (const auto& it : items) { ++count[(it.key >> shift) & 0xFFu]; }
+
+    // Every key shares this byte, order is already right
+    if (count[(items.front().key >> shift) & 0xFFu] == items.size()) continue;
+
+    unsigned int offset = 0u;
+    for (auto& c : count) {
+      auto n = c;
+      c      = offset;
+      offset += n;
+    }
+    for (const auto& it : items) {
+      m_scratch[count[(it.key >> shift) & 0xFFu]++] = it;
+    }
+    items.swap(m_scratch);
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Cull, sort and issue the draws of the acquired frame with the minimum
+// state changes. Frame bytes go to the frame stream with a single copy
+// ====================================================================== //
+
+void RenderQueue::submit() {
+  auto& l            = m_lists[m_record ^ 1u];
+  m_stats.tested     = l.tested;
+  m_stats.culled     = l.culled;
+  m_stats.allocs     = l.allocs;
+  m_stats.frameBytes = l.bytes.size();
+
+  cull(l);
+  if (l.items.empty()) return;
+  sort();
+
+  size_t base = 0u;
+  if (!l.bytes.empty()) {
+    auto span = Renderable::stream.alloc(l.bytes.size(), 16u);
+    if (span.data) {
+      std::memcpy(span.data, l.bytes.data(), l.bytes.size());
+      Renderable::stream.flush();
+      base = span.offset;
+    } else {
+      // Draws of plain meshes still go, the ones reading frame data can't
+      LOGE("No room for {}KB of frame data.", l.bytes.size() >> 10);
+      auto needsBytes = [&](const item& it) {
+        const auto& d = l.draws[it.index];
+        return d.streamed || d.count > 0u;
+      };
+      l.items.erase(
+          std::remove_if(l.items.begin(), l.items.end(), needsBytes),
+          l.items.end());
+      if (l.items.empty()) return;
+    }
+  }
+  auto vbo = Renderable::stream.buffer();
+
+  // Streamed renderables point at their vertices of this frame first,
+  // binding their arrays inside the draw loop would break its tracking
+  for (const auto& it : l.items) {
+    const auto& d = l.draws[it.index];
+    if (d.streamed) d.renderable->streamVBO(vbo, base + d.offset);
+  }
+
+  // Per draw constants go to mapped memory in one go, draws only bind them
+  const auto& view   = l.camera.view;
+  auto        mapped = static_cast<char*>(m_drawRing.map(l.items.size()));
+  if (!mapped) {
+    LOGE("Couldn't map the per draw constants ring.");
+    return;
+  }
+  for (auto i = 0u; i < l.items.size(); ++i) {
+    const auto& d = l.draws[l.items[i].index];
+
+    Shader::drawBlock block;
+    block.matMV = view * d.model;
+    block.matN  = glm::mat4(glm::inverseTranspose(glm::mat3(block.matMV)));
+    block.color = glm::vec4(d.color, layerOf(*d.renderable));
+
+    // Meshes are quantized within their bounds, streamed ones are not
+    const auto& r   = *d.renderable;
+    block.posOffset = glm::vec4(0.f);
+    block.posScale  = glm::vec4(1.f, 1.f, 1.f, 0.f);
+    if (r.quantized()) {
+      block.posOffset = glm::vec4(r.boundsMin(), 0.f);
+      block.posScale  = glm::vec4(r.boundsMax() - r.boundsMin(), 0.f);
+    }
+    std::memcpy(mapped + i * m_drawRing.stride(), &block, sizeof(block));
+  }
+  m_drawRing.unmap();
+
+  Shader*             currShader = nullptr;
+  const TextureArray* currArray  = nullptr;
+  unsigned int        currVAO    = 0u;
+  int                 currCull   = -1; // Unknown
+
+  for (auto i = 0u; i < l.items.size(); ++i) {
+    const auto& d = l.draws[l.items[i].index];
+    auto&       r = *d.renderable;
+
+    if (r.vao() != currVAO) {
+      currVAO = r.vao();
+      r.bind();
+      ++m_stats.vaoBinds;
+    }
+
+    auto shader = r.shader().get();
+    if (shader != currShader) {
+      currShader = shader;
+      currShader->bind();
+      ++m_stats.programSwitches;
+    }
+
+    // Samplers are set to Texture::unit on link. Draws without texture
+    // get layer -1 and don't sample, so the array bound can stay
+    const auto& texture = r.texture();
+    auto        array   = (texture) ? texture->array() : nullptr;
+    if (array && array != currArray) {
+      currArray = array;
+      currArray->bind(Texture::unit);
+      ++m_stats.textureBinds;
+    }
+
+    if ((int)r.culling() != currCull) {
+      currCull = r.culling();
+      (currCull) ? GLState::enable(GL_CULL_FACE)
+                 : GLState::disable(GL_CULL_FACE);
+      ++m_stats.cullToggles;
+    }
+
+    m_drawRing.bind(i);
+    if (d.count == 0u) {
+      r.submit(d.lod);
+    } else {
+      r.submitInstanced(vbo, base + d.offset, d.count, d.lod);
+      m_stats.instances += d.count;
+    }
+    auto copies = std::max(d.count, 1u);
+    m_stats.vertexBytes += r.vertexCount() * r.vertexStride() * copies;
+    if (d.lod < r.lods().size()) {
+      m_stats.triangles += r.lods()[d.lod].count / 3u * copies;
+    }
+    ++m_stats.draws;
+  }
+
+  // Leave the default state behind
+  if (currCull == 0) GLState::enable(GL_CULL_FACE);
+  if (currArray) currArray->unbind(Texture::unit);
+  GLState::bindVertexArray(0u);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Number of draws recorded so far
+// ====================================================================== //
+
+size_t RenderQueue::size() const { return m_lists[m_record].items.size(); }
+
+// ====================================================================== //
+// ====================================================================== //
+// Counters of the last submit
+// ====================================================================== //
+
+const RenderQueue::stats& RenderQueue::lastStats() const { return m_stats; }
+
+} // namespace imog
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+#include "gltools_Math.hpp"
+#include "gltools_Camera.hpp"
+#include "gltools_Frustum.hpp"
+#include "gltools_Shader.hpp"
+#include "gltools_UniformBuffer.hpp"
+#include "cpptools_Timer.hpp"
+
+namespace imog {
+class Renderable;
+
+// Draws of a frame recorded as 64-bit sort keys plus a payload, frustum
+// culled, radix sorted by state and submitted binding only what changes
+// between draws.
+//
+// Command lists are double buffered: the update thread records frame N+1
+// into one while the render thread, the only one with the OpenGL context,
+// executes frame N from the other. Recording touches no OpenGL, work that
+// needs it is deferred to the render thread. Both sides can also be
+// driven from a single thread, publish then acquire, submit and release.
+//
+// Key layout, most significant first:
+//   shader 10 | texture array 10 | no-cull 1 | vao 16 | depth 27
+class RenderQueue {
+
+public:
+  // Per frame counters of the last submit
+  struct stats {
+    unsigned int draws{0u};
+    unsigned int instances{0u};
+    unsigned int programSwitches{0u};
+    unsigned int textureBinds{0u};
+    unsigned int vaoBinds{0u};
+    unsigned int cullToggles{0u};
+    unsigned int tested{0u};      // Objects tested against the frustum
+    unsigned int culled{0u};      // Objects out of it, never submitted
+    size_t       vertexBytes{0u}; // Vertex data fetched, per stride
+    size_t       triangles{0u};   // Of the levels of detail drawn
+    unsigned int allocs{0u};      // Frame data allocations (alloc)
+    size_t       frameBytes{0u};  // And their bytes, streamed at once
+
+    // Frame time breakdown, milliseconds
+    double recordMs{0.0};  // Update thread, update and record
+    double waitMs{0.0};    // Update thread, blocked on the render thread
+    double submitMs{0.0};  // Render thread, execute the list
+    double overlapMs{0.0}; // Recorded while the previous frame submitted
+  };
+
+  // Recorded draw. Plain draws use model and color, instanced draws read
+  // count instances from the frame bytes at offset, streamed draws their
+  // skinned vertices. All draw a level of detail
+  struct draw {
+    Renderable*  renderable;
+    glm::mat4    model;
+    glm::vec3    color;
+    size_t       offset;
+    unsigned int count;
+    unsigned int lod;
+    bool         streamed;
+  };
+
+  // Camera matrices a frame is recorded with
+  struct eye {
+    glm::mat4 view{1.f};
+    glm::mat4 proj{1.f};
+    glm::mat4 viewproj{1.f};
+  };
+
+  // Compose a sort key. Indices wider than their field are wrapped
+  static uint64_t key(unsigned int shader,
+                      unsigned int texture,
+                      unsigned int vao,
+                      bool         culling,
+                      float        depth);
+
+private:
+  struct item {
+    uint64_t     key;
+    unsigned int index;
+  };
+
+  // Commands of a frame. World bounding sphere of each draw, and the
+  // frame bytes: instances and skinned vertices, copied to the frame
+  // stream in one go when executed
+  struct list {
+    std::vector<item>                  items;
+    std::vector<draw>                  draws;
+    Frustum::spheres                   bounds;
+    std::vector<char>                  bytes;
+    std::vector<std::function<void()>> tasks;
+    eye                                camera;
+    unsigned int                       tested{0u};
+    unsigned int                       culled{0u};
+    unsigned int                       allocs{0u};
+    TimePoint                          begin{StdClock::now()};
+    TimePoint                          end{StdClock::now()};
+    double                             waitMs{0.0};
+  };
+
+  list                 m_lists[2];
+  unsigned int         m_record{0u}; // Index of the list being recorded
+  std::vector<item>    m_scratch;
+  std::vector<uint8_t> m_visible;
+  stats                m_stats;
+
+  // Hand off between threads. Published is set from publish until the
+  // render thread releases the list, deferred until it ran its tasks
+  std::mutex              m_mutex;
+  std::condition_variable m_handoff;
+  bool                    m_published{false};
+  bool                    m_deferred{false};
+  bool                    m_threaded{false};
+  bool                    m_closed{false};
+  TimePoint               m_submitBegin{StdClock::now()};
+  TimePoint               m_submitEnd{StdClock::now()};
+
+  // Per draw constants (Draw block), written in submit order
+  UniformRing m_drawRing{Shader::drawBinding, sizeof(Shader::drawBlock), 4096u};
+
+  // Add a draw with the key of its renderable state
+  void push(const draw& d, float depth, const glm::vec4& sphere);
+
+  // Drop the draws of the list out of its camera frustum
+  void cull(list& l);
+
+  // Forget the commands of a list, keeping the memory
+  static void clear(list& l);
+
+public:
+  // -- Update thread --------------------------------------------------
+  // Record a plain draw of a renderable. Depth is taken from camera
+  void add(Renderable&                    renderable,
+           const glm::mat4&               model,
+           const glm::vec3&               color,
+           const std::shared_ptr<Camera>& camera);
+
+  // Record an instanced draw of a renderable, count instances from byte
+  // offset of the frame bytes. Never culled, its instances are tested
+  // (and their level of detail picked) by whoever records them
+  void addInstanced(Renderable&  renderable,
+                    size_t       offset,
+                    unsigned int count,
+                    unsigned int lod = 0u);
+
+  // Record a draw of a streamed renderable, its skinned vertices (world
+  // space, within bounds) at byte offset of the frame bytes
+  void addStreamed(Renderable&                    renderable,
+                   size_t                         offset,
+                   const glm::vec3&               boundsMin,
+                   const glm::vec3&               boundsMax,
+                   const glm::vec3&               color,
+                   const std::shared_ptr<Camera>& camera);
+
+  // Room for size bytes on the frame bytes, returns its offset. Write
+  // them through data() before the next alloc, which may move them
+  size_t alloc(size_t size, size_t align = 16u);
+  char*  data(size_t offset);
+
+  // Run fn on the render thread before the draws of this frame. The
+  // update thread waits for it, so it may touch anything recording does
+  void defer(std::function<void()> fn);
+
+  // Account objects culled before being recorded (e.g. instances)
+  void countCulling(unsigned int tested, unsigned int culled);
+
+  // Mark the start of the update of a frame, for the time breakdown.
+  // Otherwise it starts when the previous one is published
+  void begin();
+
+  // Hand the recorded frame to the render thread, seen from camera. Waits
+  // while the previous one executes, then records on the other list
+  void publish(const std::shared_ptr<Camera>& camera);
+
+  // Is a render thread executing the published frames?
+  bool threaded() const;
+
+  // Published frames go to a render thread (or not). Turning it off
+  // wakes that thread, its acquire fails once there is nothing left
+  void threaded(bool value);
+
+  // -- Render thread --------------------------------------------------
+
+  // Wait for a published frame and run its deferred work. False if
+  // threaded was turned off
+  bool acquire();
+
+  // Camera the acquired frame was recorded with
+  const eye& camera() const;
+
+  // Cull, sort and issue the draws of the acquired frame with the
+  // minimum state changes
+  void submit();
+
+  // Give the executed list back to the update thread
+  void release();
+
+  // Sort the acquired draws by key. LSD radix sort, 8 bits per pass,
+  // passes where every key has the same byte are skipped
+  void sort();
+
+  // Number of draws recorded so far
+  size_t size() const;
+
+  // Counters of the last submit
+  const stats& lastStats() const;
+};
+
+} // namespace imog
@@ -1,9 +1,20 @@
 #include "gltools_Renderable.hpp"
 
 #include <mutex>
+#include <cstdint>
+#include <algorithm>
+#include <cstddef>
 #include <sstream>
 
 #include "gltools_Loader.hpp"
+#include "gltools_DebugDraw.hpp"
+#include "gltools_FrameScheduler.hpp"
+#include "gltools_GLState.hpp"
+#include "gltools_IO.hpp"
+#include "gltools_MeshCache.hpp"
+#include "gltools_Skinning.hpp"
+#include "gltools_TextureLoader.hpp"
+#include "gltools_VertexPacking.hpp"
 #include "cpptools_Logger.hpp"
 #include "cpptools_Strings.hpp"
 #include "Settings.hpp"
@@ -26,13 +37,42 @@ namespace imog {
 
 unsigned int Renderable::g_RenderablesLastID{0u};
 
+// ====================================================================== //
+// ====================================================================== //
+// World transforms of every renderable, updated by poolDraw.
+// Defined before the pool: renderables release their nodes when destroyed
+// ====================================================================== //
+
+SceneGraph Renderable::scene{};
+
+// ====================================================================== //
+// ====================================================================== //
+// Vertices and indices of every mesh, sub-allocated from 16MB buffers.
+// Defined before the pool: renderables give back their ranges
+// ====================================================================== //
+
+StaticArena Renderable::arena{16u << 20};
+
+// ====================================================================== //
+// ====================================================================== //
+// Per frame dynamic data, 4MB per frame in flight (grows if needed)
+// ====================================================================== //
+
+StreamRing Renderable::stream{4u << 20};
+
 // ====================================================================== //
 // ====================================================================== //
 // Global pool for renderables
 // ====================================================================== //
 
-std::vector<std::shared_ptr<Renderable>>      Renderable::pool{};
-std::unordered_map<std::string, unsigned int> Renderable::poolIndices{};
+Registry<Renderable> Renderable::pool{};
+
+// ====================================================================== //
+// ====================================================================== //
+// Draws recorded by poolDraw, executed by poolSubmit
+// ====================================================================== //
+
+RenderQueue Renderable::queue{};
 
 // ====================================================================== //
 // ====================================================================== //
@@ -41,13 +81,30 @@ std::unordered_map<std::string, unsigned int> Renderable::poolIndices{};
 // ====================================================================== //
 
 std::shared_ptr<Renderable> Renderable::getByName(const std::string& name) {
-  auto _name = Strings::toLower(name);
-  if (poolIndices.count(_name) > 0) { return pool[poolIndices[_name]]; }
+  if (auto R = get(find(name))) { return R; }
 
   LOGE("Zero entries @ renderables pool with name {}.", name);
   return nullptr;
 }
 
+// ====================================================================== //
+// ====================================================================== //
+// Get the handle of a Renderable by name. Resolve it once at load time
+// ====================================================================== //
+
+Handle<Renderable> Renderable::find(const std::string& name) {
+  return pool.find(name);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Get a Renderable from the global pool by handle (per-frame safe)
+// ====================================================================== //
+
+const std::shared_ptr<Renderable>& Renderable::get(Handle<Renderable> handle) {
+  return pool.get(handle);
+}
+
 // ====================================================================== //
 // ====================================================================== //
 // Create a new Renderable if it isn't on the gloabl pool
@@ -62,27 +119,55 @@ std::shared_ptr<Renderable>
                        const std::shared_ptr<Shader>& shader,
                        bool                           culling) {
 
-  auto _name = Strings::toLower(name);
-  pool.push_back(std::make_shared<Renderable>(allowGlobalDraw,
-                                              _name,
-                                              objFilePath,
-                                              texturePath,
-                                              color,
-                                              shader,
-                                              culling));
-  poolIndices[_name] = pool.size() - 1;
-  return pool.at(poolIndices[_name]);
+  auto R = std::make_shared<Renderable>(allowGlobalDraw,
+                                        Strings::toLower(name),
+                                        objFilePath,
+                                        texturePath,
+                                        color,
+                                        shader,
+                                        culling);
+  R->m_handle = pool.add(R, R->m_name);
+  return R;
 }
 
 // ====================================================================== //
 // ====================================================================== //
-// Draw all renderables of the pool
+// Update world transforms, record all renderables of the pool and
+// publish the frame queue, debug lines of this thread included. Without
+// a render thread the frame is submitted right after
 // ====================================================================== //
 
 void Renderable::poolDraw(const std::shared_ptr<Camera>& camera) {
-  for (const auto& r : Renderable::pool) {
+  scene.update();
+  pool.each([&](const std::shared_ptr<Renderable>& r) {
     if (r->globalDraw) r->draw(camera);
-  }
+  });
+  // Debug lines of this thread go with the frame, inline flush commits them
+  if (queue.threaded()) DebugDraw::commit();
+  queue.publish(camera);
+  if (!queue.threaded()) poolSubmit();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Render thread: wait for a published frame and execute it. Uploads and
+// frame constants first, debug lines last, on the same frame stream.
+// Textures still loading need more frames to show up
+// ====================================================================== //
+
+bool Renderable::poolSubmit() {
+  if (!queue.acquire()) return false;
+
+  const auto& eye = queue.camera();
+  TextureLoader::update();
+  if (TextureLoader::progress() < 1.f) FrameScheduler::invalidate();
+  Shader::poolUpdate(eye.view, eye.proj, eye.viewproj);
+  queue.submit();
+  DebugDraw::flush();
+  stream.endFrame();
+
+  queue.release();
+  return true;
 }
 
 
@@ -110,20 +195,57 @@ Renderable::Renderable(bool                           allowGlobalDraw,
       m_color(color),
       m_vao(0),
       m_loc(0),
+      m_vertexCount(0),
       m_eboSize(0),
+      m_eboType(GL_UNSIGNED_INT),
+      m_streamed(false),
+      m_boundsMin(0.f),
+      m_boundsMax(0.f),
       globalDraw(allowGlobalDraw) {
 
+  m_node = scene.add(&this->transform);
+
   GL_ASSERT(glGenVertexArrays(1, &m_vao));
   if (!m_shader) { m_shader = Shader::getByName("base"); }
   if (m_name.empty()) { m_name = std::string("R_" + std::to_string(m_ID)); }
 
-  if (!objFilePath.empty()) {
-    Renderable::data renderData = loader::OBJ(objFilePath);
-    this->fillEBO(renderData.indices); // No location, just internal data.
-    this->addVBO(renderData.vertices); // Location = 0
-    this->addVBO(renderData.normals);  // Location = 1
-    this->addVBO(renderData.uvs);      // Location = 2
+  if (!objFilePath.empty()) { this->loadMesh(objFilePath); }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Upload the mesh of an OBJ file, from its binary cache if it's valid
+// ====================================================================== //
+
+void Renderable::loadMesh(const std::string& objFilePath) {
+  MeshCache cache;
+
+  if (!cache.open(objFilePath)) {
+    auto renderData = loader::OBJ(objFilePath);
+    if (renderData.indices.empty()) return;
+
+    // Parse only once, next runs map the cache
+    if (!MeshCache::store(objFilePath, renderData) ||
+        !cache.open(objFilePath)) {
+      auto vertices = MeshCache::interleave(renderData);
+      auto packed   = VertexPacking::pack(vertices.data(),
+                                        vertices.size(),
+                                        renderData.boundsMin,
+                                        renderData.boundsMax);
+      this->fillEBO(renderData.indices);
+      this->fillVBO(packed.data(), packed.size());
+      m_boundsMin = renderData.boundsMin;
+      m_boundsMax = renderData.boundsMax;
+      if (!renderData.lods.empty()) m_lods = renderData.lods;
+      return;
+    }
   }
+
+  this->fillEBO(cache.indices(), cache.indexCount(), cache.indexSize());
+  this->fillVBO(cache.vertices(), cache.vertexCount());
+  m_boundsMin = cache.boundsMin();
+  m_boundsMax = cache.boundsMax();
+  m_lods      = cache.lods();
 }
 
 // ====================================================================== //
@@ -132,6 +254,9 @@ Renderable::Renderable(bool                           allowGlobalDraw,
 // ====================================================================== //
 
 Renderable::~Renderable() {
+  scene.release(m_node);
+  arena.free(m_ebo);
+  for (auto& b : m_vbos) arena.free(b);
   if (!Settings::quiet) LOGD("Destroyed @ {}.{}", m_ID, m_name);
 }
 
@@ -141,7 +266,7 @@ Renderable::~Renderable() {
 // Bind this Renderable VAO(m_vao) as active to auto attach VBO, EBO, ...
 // ====================================================================== //
 
-void Renderable::bind() { GL_ASSERT(glBindVertexArray(m_vao)); }
+void Renderable::bind() { GLState::bindVertexArray(m_vao); }
 
 // ====================================================================== //
 // ====================================================================== //
@@ -149,7 +274,7 @@ void Renderable::bind() { GL_ASSERT(glBindVertexArray(m_vao)); }
 // ====================================================================== //
 
 void Renderable::unbind() {
-  GL_ASSERT(glBindVertexArray(0));
+  GLState::bindVertexArray(0u);
   GL_ASSERT(glBindBuffer(GL_ARRAY_BUFFER, 0));
   GL_ASSERT(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
 }
@@ -162,6 +287,13 @@ void Renderable::unbind() {
 
 unsigned int Renderable::ID() const { return m_ID; }
 
+// ====================================================================== //
+// ====================================================================== //
+// Getter for handle
+// ====================================================================== //
+
+Handle<Renderable> Renderable::handle() const { return m_handle; }
+
 // ====================================================================== //
 // ====================================================================== //
 // Getter for name
@@ -189,106 +321,274 @@ void      Renderable::color(const glm::vec3& newColor) { m_color = newColor; }
 
 // ====================================================================== //
 // ====================================================================== //
-// Add a vertex attribute to this Renderable
+// Getters for the state used to sort draws
+// ====================================================================== //
+
+unsigned int Renderable::vao() const { return m_vao; }
+const std::shared_ptr<Texture>& Renderable::texture() const {
+  return m_texture;
+}
+bool Renderable::culling() const { return m_culling; }
+
+// ====================================================================== //
+// ====================================================================== //
+// Store indices in the internal variable m_ebo
 // ====================================================================== //
 
-template <typename T>
-void Renderable::addVBO(const std::vector<T>& data) {
+void Renderable::fillEBO(const std::vector<unsigned int>& indices) {
+  auto maxIdx = std::max_element(indices.begin(), indices.end());
+  if (maxIdx == indices.end() || *maxIdx > 0xFFFFu) {
+    this->fillEBO(indices.data(), indices.size(), sizeof(unsigned int));
+    return;
+  }
+  std::vector<uint16_t> shortIndices(indices.begin(), indices.end());
+  this->fillEBO(shortIndices.data(), shortIndices.size(), sizeof(uint16_t));
+}
+
+void Renderable::fillEBO(const void* indices, size_t count, size_t indexSize) {
+  this->bind();
+  // Store indices count and type. A single level of detail until told
+  m_eboSize = count;
+  m_eboType = (indexSize == 2u) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  m_lods.assign(1u, {0u, static_cast<unsigned int>(count), 0.f});
+  // Upload indices to the mesh arena, draws start at its offset
+  arena.free(m_ebo);
+  m_ebo = arena.alloc(indices, count * indexSize);
+  GL_ASSERT(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo.buffer));
+  this->unbind();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Upload packed vertices (position, normal, uv) to locations 0, 1, 2.
+// Fetch normalizes position and normal, shaders finish the decode
+// ====================================================================== //
+
+void Renderable::fillVBO(const packedVertex* vertices, size_t count) {
   this->bind();
   {
-    // Upload data to OpenGL
-    unsigned int vbo;
-    GL_ASSERT(glGenBuffers(1, &vbo));
-    GL_ASSERT(glBindBuffer(GL_ARRAY_BUFFER, vbo));
-    GL_ASSERT(glBufferData(
-        GL_ARRAY_BUFFER, data.size() * sizeof(T), &data[0], GL_DYNAMIC_DRAW));
-    // Link data to a vertex attribute (in order of entry)
-    GL_ASSERT(glEnableVertexAttribArray(m_loc));
-    GL_ASSERT(glVertexAttribPointer(
-        m_loc, data[0].length(), GL_FLOAT, GL_FALSE, 0, 0));
-    // Increment location index for vertex attribs
-    // [!] Check that order in your shader is the order in which you add VBOs
-    ++m_loc;
+    m_vertexCount = count;
+    m_vbos.push_back(arena.alloc(vertices, count * sizeof(packedVertex)));
+    const auto& b = m_vbos.back();
+    GL_ASSERT(glBindBuffer(GL_ARRAY_BUFFER, b.buffer));
+
+    auto attrib = [&](unsigned int size,
+                      unsigned int type,
+                      bool         normalized,
+                      size_t       offset) {
+      GL_ASSERT(glEnableVertexAttribArray(m_loc));
+      GL_ASSERT(glVertexAttribPointer(m_loc,
+                                      size,
+                                      type,
+                                      normalized,
+                                      sizeof(packedVertex),
+                                      (void*)(b.offset + offset)));
+      ++m_loc;
+    };
+    attrib(3u, GL_UNSIGNED_SHORT, true, offsetof(packedVertex, pos));
+    attrib(2u, GL_SHORT, true, offsetof(packedVertex, normal));
+    attrib(2u, GL_HALF_FLOAT, false, offsetof(packedVertex, uv));
   }
   this->unbind();
 }
 
-
 // ====================================================================== //
 // ====================================================================== //
-// Store indices in the internal variable m_ebo
+// Skinned meshes: uvs as half floats on the arena (location 2). Positions
+// and normals change every frame, see streamVBO
 // ====================================================================== //
 
-void Renderable::fillEBO(const std::vector<unsigned int>& indices) {
+void Renderable::fillStreamed(const std::vector<glm::vec2>& uvs) {
+  std::vector<uint16_t> halves(uvs.size() * 2u);
+  for (auto i = 0u; i < uvs.size(); ++i) {
+    VertexPacking::halfEncode(uvs[i], &halves[i * 2u]);
+  }
+
   this->bind();
-  // Store indices count
-  m_eboSize = indices.size();
-  // Upload indices to OpenGL
-  unsigned int ebo;
-  GL_ASSERT(glGenBuffers(1, &ebo));
-  GL_ASSERT(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo));
-  GL_ASSERT(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                         m_eboSize * sizeof(unsigned int),
-                         &indices[0],
-                         GL_DYNAMIC_DRAW));
+  {
+    m_vertexCount = uvs.size();
+    m_streamed    = true;
+    m_vbos.push_back(arena.alloc(halves.data(), halves.size() * 2u));
+    const auto& b = m_vbos.back();
+    GL_ASSERT(glBindBuffer(GL_ARRAY_BUFFER, b.buffer));
+    GL_ASSERT(glEnableVertexAttribArray(2));
+    GL_ASSERT(glVertexAttribPointer(
+        2, 2, GL_HALF_FLOAT, GL_FALSE, 0, (void*)b.offset));
+    m_loc = 3u;
+  }
   this->unbind();
 }
 
 // ====================================================================== //
 // ====================================================================== //
-// Draw execute the Renderable in the viewport using its shader and vbos
+// Point locations 0 and 1 at skinned vertices of buffer vbo from byte
+// offset. The stream buffer may change between frames, so it's pointed
+// every time
 // ====================================================================== //
 
-void Renderable::draw(const std::shared_ptr<Camera>& camera) {
+void Renderable::streamVBO(unsigned int vbo, size_t offset) {
+  using V = Skinning::vertex;
   this->bind();
-  m_shader->bind();
+  {
+    GL_ASSERT(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+    GL_ASSERT(glEnableVertexAttribArray(0));
+    GL_ASSERT(glVertexAttribPointer(0,
+                                    3,
+                                    GL_FLOAT,
+                                    GL_FALSE,
+                                    sizeof(V),
+                                    (void*)(offset + offsetof(V, pos))));
+    GL_ASSERT(glEnableVertexAttribArray(1));
+    GL_ASSERT(glVertexAttribPointer(1,
+                                    2,
+                                    GL_SHORT,
+                                    GL_TRUE,
+                                    sizeof(V),
+                                    (void*)(offset + offsetof(V, normal))));
+  }
+  this->unbind();
+}
 
-  (m_texture)
-      ? m_shader->uInt1("u_texture", m_texture->bind())
-      : m_shader->uInt1("u_texture", Texture::pool.size()); // "Disable" texture
+// ====================================================================== //
+// ====================================================================== //
+// Getters for the object space bounding box
+// ====================================================================== //
 
-  m_shader->uFloat3("u_color", m_color);
+glm::vec3 Renderable::boundsMin() const { return m_boundsMin; }
+glm::vec3 Renderable::boundsMax() const { return m_boundsMax; }
 
-  auto currModel = this->transform.asMatrix();
+// ====================================================================== //
+// ====================================================================== //
+// Getter for the number of vertices uploaded
+// ====================================================================== //
 
-  glm::mat4 matMV = camera->view() * currModel;
-  m_shader->uMat4("u_matMV", matMV);
-  m_shader->uMat4("u_matN", glm::transpose(glm::inverse(matMV)));
+unsigned int Renderable::vertexCount() const { return m_vertexCount; }
 
-  m_shader->uMat4("u_matM", currModel);
-  m_shader->uMat4("u_matMVP", camera->viewproj() * currModel);
+// ====================================================================== //
+// ====================================================================== //
+// False for streamed vertices, their positions aren't within the bounds
+// ====================================================================== //
 
-  if (!m_culling) { glDisable(GL_CULL_FACE); }
-  GL_ASSERT(glDrawElements(GL_TRIANGLES, m_eboSize, GL_UNSIGNED_INT, 0));
-  if (!m_culling) { glEnable(GL_CULL_FACE); }
+bool Renderable::quantized() const { return !m_streamed; }
 
-  if (m_texture) m_texture->unbind();
-  m_shader->unbind();
-  this->unbind();
+// ====================================================================== //
+// ====================================================================== //
+// Bytes read per vertex: packed ones, or skinned from the frame stream
+// plus half float uvs from the arena
+// ====================================================================== //
+
+size_t Renderable::vertexStride() const {
+  return (m_streamed) ? sizeof(Skinning::vertex) + 2u * sizeof(uint16_t)
+                      : sizeof(packedVertex);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Getter for the levels of detail, finest first
+// ====================================================================== //
+
+const std::vector<Renderable::lod>& Renderable::lods() const {
+  return m_lods;
 }
 
+// ====================================================================== //
+// ====================================================================== //
+// Coarsest level of detail whose error stays under Settings::lodPixelError
+// pixels. Errors are scaled as the bounds are, then projected at the
+// nearest depth of the sphere with Camera::proj()
+// ====================================================================== //
+
+unsigned int Renderable::lodFor(const glm::vec4& sphere,
+                                const Camera&    camera) const {
+  if (m_lods.size() < 2u || Settings::lodPixelError <= 0.f) return 0u;
+
+  auto radius = glm::length(m_boundsMax - m_boundsMin) * 0.5f;
+  auto depth  = -(camera.view() * glm::vec4(glm::vec3(sphere), 1.f)).z;
+  depth -= sphere.w;
+  if (radius <= 0.f || depth <= 0.f) return 0u;
+
+  // Pixels a world unit covers at that depth. Settings before a window
+  auto height = (IO::windowHeight() > 0) ? IO::windowHeight()
+                                         : Settings::windowHeight;
+  auto pixels = camera.proj()[1][1] * 0.5f * height / depth;
+  auto scale  = sphere.w / radius;
+  for (auto i = m_lods.size() - 1u; i > 0u; --i) {
+    if (m_lods[i].error * scale * pixels <= Settings::lodPixelError) return i;
+  }
+  return 0u;
+}
 
 // ====================================================================== //
 // ====================================================================== //
-// Draw a line between 2points
+// Scene node, follows transform. Parent it to attach this Renderable
 // ====================================================================== //
-//
-std::shared_ptr<Renderable>
-    Renderable::line(const glm::vec3& P1, const glm::vec3& P2, float scale) {
-  auto stick = Renderable::getByName("stick");
-  {
-    stick->transform.pos = (P1 + P2) * 0.5f;
-    // ---
-    auto C1                   = stick->transform.pos + glm::vec3(0, 0.5f, 0);
-    auto C2                   = stick->transform.pos - glm::vec3(0, 0.5f, 0);
-    auto vP                   = glm::normalize(P1 - P2);
-    auto vC                   = glm::normalize(C1 - C2);
-    stick->transform.rotAngle = glm::angle(vC, vP);
-    stick->transform.rotAxis  = glm::cross(vC, vP);
-    // ---
-    stick->transform.scl = glm::vec3{1.f, scale, 1.0f};
+
+SceneGraph::node Renderable::node() const { return m_node; }
+
+// ====================================================================== //
+// ====================================================================== //
+// Record a draw of the Renderable, with its world transform and color,
+// on the frame queue
+// ====================================================================== //
+
+void Renderable::draw(const std::shared_ptr<Camera>& camera) {
+  queue.add(*this, scene.world(m_node), m_color, camera);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Issue a draw. VAO, program, texture, culling and the Draw block must be
+// already set, the render queue takes care of them
+// ====================================================================== //
+
+void Renderable::submit(unsigned int lod) {
+  if (m_lods.empty()) return;
+  const auto& l      = m_lods[std::min<size_t>(lod, m_lods.size() - 1u)];
+  auto        stride = (m_eboType == GL_UNSIGNED_SHORT) ? 2u : 4u;
+  auto        offset = m_ebo.offset + l.first * stride;
+  GL_ASSERT(glDrawElements(GL_TRIANGLES, l.count, m_eboType, (void*)offset));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Issue count instances in one draw, read from buffer vbo starting at
+// byte offset. Same state requirements than submit
+// ====================================================================== //
+
+void Renderable::submitInstanced(unsigned int vbo,
+                                 size_t       offset,
+                                 unsigned int count,
+                                 unsigned int lod) {
+  if (m_lods.empty()) return;
+  m_shader->set(m_shader->u.instanced, 1);
+
+  // Instance attributes: a mat4 takes four locations, then the color and
+  // the three columns of the normal matrix (xyz only).
+  // Pointed on every call, offset changes per mesh on the shared buffer
+  GL_ASSERT(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+  for (auto i = 0u; i < 8u; ++i) {
+    auto loc = instanceLocation + i;
+    GL_ASSERT(glEnableVertexAttribArray(loc));
+    GL_ASSERT(glVertexAttribPointer(loc,
+                                    (i < 5u) ? 4 : 3,
+                                    GL_FLOAT,
+                                    GL_FALSE,
+                                    sizeof(instance),
+                                    (void*)(offset + i * sizeof(glm::vec4))));
+    GL_ASSERT(glVertexAttribDivisor(loc, 1));
+  }
+
+  const auto& l      = m_lods[std::min<size_t>(lod, m_lods.size() - 1u)];
+  auto        stride = (m_eboType == GL_UNSIGNED_SHORT) ? 2u : 4u;
+  auto        first  = m_ebo.offset + l.first * stride;
+  GL_ASSERT(glDrawElementsInstanced(
+      GL_TRIANGLES, l.count, m_eboType, (void*)first, count));
+
+  // Plain draws of this VAO must not read instance data
+  for (auto i = 0u; i < 8u; ++i) {
+    GL_ASSERT(glDisableVertexAttribArray(instanceLocation + i));
   }
-  return stick;
+  m_shader->set(m_shader->u.instanced, 0);
 }
 
 } // namespace imog
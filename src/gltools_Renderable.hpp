@@ -2,15 +2,20 @@
 
 #include <memory>
 #include <vector>
+#include <cstdint>
 
 #include "gltools_Math.hpp"
 #include "helpers/Colors.hpp"
+#include "cpptools_Registry.hpp"
 
 #include "gltools_Transform.hpp"
+#include "gltools_SceneGraph.hpp"
+#include "gltools_GpuBuffer.hpp"
 #include "gltools_Texture.hpp"
 
 #include "gltools_Camera.hpp"
 #include "gltools_Shader.hpp"
+#include "gltools_RenderQueue.hpp"
 
 
 namespace imog {
@@ -22,22 +27,77 @@ private:
   static unsigned int g_RenderablesLastID;
 
 public:
+  // Level of detail: a range of the mesh indices. Error is how far it may
+  // be from the full mesh, in object space units
+  struct lod {
+    unsigned int first;
+    unsigned int count;
+    float        error;
+  };
+
   // Default data struct to compose a Renderable
   struct data {
     std::vector<glm::vec3>    vertices;
     std::vector<glm::vec3>    normals;
     std::vector<glm::vec2>    uvs;
     std::vector<unsigned int> indices;
+    std::vector<lod>          lods; // Finest first, none is all indices
+    glm::vec3                 boundsMin{0.f};
+    glm::vec3                 boundsMax{0.f};
+  };
+
+  // Interleaved vertex at full precision, as loaded
+  struct vertex {
+    glm::vec3 pos;
+    glm::vec3 normal;
+    glm::vec2 uv;
   };
+  static_assert(sizeof(vertex) == 32, "Tightly packed interleaved vertex");
+
+  // Interleaved vertex as stored and uploaded to OpenGL (locations 0, 1
+  // and 2). See VertexPacking for the encodings
+  struct packedVertex {
+    uint16_t pos[4];    // Unorm within the mesh bounds, w unused
+    int16_t  normal[2]; // Octahedral, snorm
+    uint16_t uv[2];     // Half floats
+  };
+  static_assert(sizeof(packedVertex) == 16, "Tightly packed vertex");
+
+  // Per-instance data of instanced draws (locations 3..6, 7 and 8..10)
+  struct instance {
+    glm::mat4 model;
+    glm::vec4 color;     // Alpha is the texture array layer, -1 for none
+    glm::vec4 normal[3]; // Inverse transpose of the model 3x3, xyz columns
+  };
+  static_assert(sizeof(instance) == 128, "Tightly packed instance");
+  static constexpr unsigned int instanceLocation = 3u;
 
   // Global pool for renderables
-  static std::vector<std::shared_ptr<Renderable>>      pool;
-  static std::unordered_map<std::string, unsigned int> poolIndices;
+  static Registry<Renderable> pool;
+
+  // Draws recorded by poolDraw, executed by poolSubmit
+  static RenderQueue queue;
+
+  // World transforms of every renderable, updated by poolDraw
+  static SceneGraph scene;
+
+  // Vertices and indices of every mesh, sub-allocated from shared buffers
+  static StaticArena arena;
+
+  // Per frame dynamic data, fenced at the end of poolSubmit
+  static StreamRing stream;
 
   // Get a shared ptr to Renderable obj from global pool by name
   static std::shared_ptr<Renderable> getByName(const std::string& name);
 
-  // Create a new Renderable if it isn't on the gloabl pool
+  // Get the handle of a Renderable by name. Resolve it once at load time
+  static Handle<Renderable> find(const std::string& name);
+
+  // Get a Renderable from the global pool by handle (per-frame safe)
+  static const std::shared_ptr<Renderable>& get(Handle<Renderable> handle);
+
+  // Create a new Renderable if it isn't on the gloabl pool. Needs the
+  // context: before the loop, or deferred to the render thread
   static std::shared_ptr<Renderable>
       create(bool                           allowGlobalDraw = true,
              const std::string&             name            = "",
@@ -47,13 +107,20 @@ public:
              const std::shared_ptr<Shader>& shader          = nullptr,
              bool                           culling         = true);
 
-  // Draw all renderables of the pool
+  // Update world transforms, record all renderables of the pool and
+  // publish the frame queue. No OpenGL on the way: without a render
+  // thread, the frame is submitted right after
   static void poolDraw(const std::shared_ptr<Camera>& camera);
 
+  // Render thread: wait for a published frame and execute it. False once
+  // the render thread is stopped
+  static bool poolSubmit();
+
 private:
-  unsigned int m_ID;
-  std::string  m_name;
-  std::string  m_meshPath;
+  unsigned int       m_ID;
+  Handle<Renderable> m_handle;
+  std::string        m_name;
+  std::string        m_meshPath;
 
   std::shared_ptr<Shader>  m_shader;
   std::shared_ptr<Texture> m_texture;
@@ -64,7 +131,25 @@ private:
 
   unsigned int m_vao;
   unsigned int m_loc;
+  unsigned int m_vertexCount;
   unsigned int m_eboSize;
+  unsigned int m_eboType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+  bool         m_streamed; // Positions and normals from streamVBO
+
+  // Ranges of the mesh on the arena
+  StaticArena::block              m_ebo;
+  std::vector<StaticArena::block> m_vbos;
+
+  // Levels of detail, finest first. Ranges of m_ebo
+  std::vector<lod> m_lods;
+
+  glm::vec3 m_boundsMin;
+  glm::vec3 m_boundsMax;
+
+  SceneGraph::node m_node;
+
+  // Upload the mesh of an OBJ file, from its binary cache if it's valid
+  void loadMesh(const std::string& objFilePath);
 
 
 public:
@@ -94,6 +179,9 @@ public:
   // Getter for ID
   unsigned int ID() const;
 
+  // Getter for handle
+  Handle<Renderable> handle() const;
+
   // Getter for name
   std::string name() const;
 
@@ -105,19 +193,68 @@ public:
   glm::vec3 color() const;
   void      color(const glm::vec3& newColor);
 
-  // Add a vertex attribute to this Renderable
-  template <typename T>
-  void addVBO(const std::vector<T>& data);
+  // Getters for the state used to sort draws
+  unsigned int                    vao() const;
+  const std::shared_ptr<Texture>& texture() const;
+  bool                            culling() const;
 
-  // Store indices in the internal variable m_ebo
+  // Upload packed vertices (position, normal, uv) to locations 0, 1, 2.
+  // Positions must be quantized within the mesh bounds
+  void fillVBO(const packedVertex* vertices, size_t count);
+
+  // Skinned meshes: uvs (location 2) stay on the arena, positions and
+  // normals (locations 0, 1) are pointed at the frame stream by streamVBO
+  void fillStreamed(const std::vector<glm::vec2>& uvs);
+
+  // Point locations 0 and 1 at Skinning::vertex data of buffer vbo from
+  // byte offset. Render thread, once per frame
+  void streamVBO(unsigned int vbo, size_t offset);
+
+  // Store indices in the internal variable m_ebo. 16-bit when they fit
   void fillEBO(const std::vector<unsigned int>& indices);
+  void fillEBO(const void* indices, size_t count, size_t indexSize);
+
+  // Getters for the object space bounding box
+  glm::vec3 boundsMin() const;
+  glm::vec3 boundsMax() const;
 
-  // Draw execute the Renderable in the viewport using its shader and vbos
+  // Getter for the number of vertices uploaded
+  unsigned int vertexCount() const;
+
+  // False for streamed vertices, their positions aren't within the bounds
+  bool quantized() const;
+
+  // Bytes read per vertex: packed ones, or skinned from the frame stream
+  // plus half float uvs from the arena
+  size_t vertexStride() const;
+
+  // Getter for the levels of detail, finest first
+  const std::vector<lod>& lods() const;
+
+  // Coarsest level of detail whose error stays under
+  // Settings::lodPixelError pixels, for the world bounding sphere (xyz
+  // center, w radius) of a draw
+  unsigned int lodFor(const glm::vec4& sphere, const Camera& camera) const;
+
+  // Scene node, follows transform. Parent it to attach this Renderable
+  SceneGraph::node node() const;
+
+  // Record a draw of the Renderable, with its world transform and color,
+  // on the frame queue
   void draw(const std::shared_ptr<Camera>& camera);
 
-  // Draw cyl between 2points
-  static std::shared_ptr<Renderable>
-      line(const glm::vec3& P1, const glm::vec3& P2, float scale = 10.f);
+  // Issue a draw of a level of detail. VAO, program, texture, culling and
+  // the Draw block must be already set, the render queue takes care of
+  // them
+  void submit(unsigned int lod = 0u);
+
+  // Issue count instances in one draw, read from buffer vbo starting at
+  // byte offset. Same state requirements than submit. Shader must handle
+  // u_instanced
+  void submitInstanced(unsigned int vbo,
+                       size_t       offset,
+                       unsigned int count,
+                       unsigned int lod = 0u);
 };
 
 } // namespace imog
@@ -0,0 +1,322 @@
+#include "gltools_Replay.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+#include "gltools_IO.hpp"
+#include "cpptools_Files.hpp"
+#include "cpptools_Logger.hpp"
+#include "cpptools_Timer.hpp"
+#include "Settings.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// File layout: magic + version, then one record per event:
+//   u8 kind | u32 time(us) | payload (see kind)
+// ====================================================================== //
+
+static const char    g_magic[8] = {'I', 'M', 'O', 'G', 'I', 'N', 'P', 'T'};
+static const uint8_t g_version  = 1u;
+
+// Payload size per kind: frame, key, mouseMove, mouseClick, scroll
+static const size_t g_payload[] = {0u, 6u, 8u, 3u, 8u};
+
+// ====================================================================== //
+// ====================================================================== //
+// Private variables definition
+// ====================================================================== //
+
+bool Replay::m_recording{false};
+bool Replay::m_replaying{false};
+bool Replay::m_feeding{false};
+
+std::ofstream              Replay::m_out{};
+std::vector<Replay::event> Replay::m_events{};
+size_t                     Replay::m_cursor{0u};
+double                     Replay::m_initTime{0.0};
+unsigned int               Replay::m_frames{0u};
+
+std::function<float()> Replay::m_tick{};
+double                 Replay::m_nextTick{0.0};
+
+
+// * private
+
+// ====================================================================== //
+// ====================================================================== //
+// Microseconds since the log started
+// ====================================================================== //
+
+uint32_t Replay::elapsed() {
+  auto now = Seconds(StdClock::now().time_since_epoch()).count();
+  return static_cast<uint32_t>((now - m_initTime) * 1e6);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Append an event to the log file
+// ====================================================================== //
+
+void Replay::write(const event& e) {
+  uint8_t buf[16];
+  size_t  len = 0u;
+
+  auto put = [&](const void* src, size_t size) {
+    std::memcpy(buf + len, src, size);
+    len += size;
+  };
+  auto putI16 = [&](int v) { int16_t x = v; put(&x, 2u); };
+  auto putU8  = [&](int v) { uint8_t x = v; put(&x, 1u); };
+
+  putU8(static_cast<int>(e.type));
+  put(&e.time, 4u);
+
+  switch (e.type) {
+    case kind::frame: break;
+    case kind::key:
+      putI16(e.i0); // key
+      putI16(e.i1); // scancode
+      putU8(e.i2);  // action
+      putU8(e.i3);  // mods
+      break;
+    case kind::mouseMove:
+    case kind::scroll:
+      put(&e.f0, 4u);
+      put(&e.f1, 4u);
+      break;
+    case kind::mouseClick:
+      putU8(e.i0); // button
+      putU8(e.i1); // action
+      putU8(e.i2); // mods
+      break;
+  }
+
+  m_out.write(reinterpret_cast<const char*>(buf), len);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Dispatch an event to the IO callbacks
+// ====================================================================== //
+
+void Replay::dispatch(const event& e) {
+  auto w = IO::window();
+  switch (e.type) {
+    case kind::frame: break;
+    case kind::key: IO::keyboardOnPress(w, e.i0, e.i1, e.i2, e.i3); break;
+    case kind::mouseMove: IO::mouseOnMove(w, e.f0, e.f1); break;
+    case kind::mouseClick: IO::mouseOnClick(w, e.i0, e.i1, e.i2); break;
+    case kind::scroll: IO::mouseOnScroll(w, e.f0, e.f1); break;
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Run the ticks due up to this virtual time. Same frame marks, same ticks
+// ====================================================================== //
+
+void Replay::advance(uint32_t time) {
+  if (!m_tick) return;
+  auto now = time * 1e-6;
+  while (m_nextTick <= now) m_nextTick += std::max(m_tick(), 1e-4f);
+}
+
+
+// * public
+
+// ====================================================================== //
+// ====================================================================== //
+// Start to record the input on a file, false if it can't be opened
+// ====================================================================== //
+
+bool Replay::record(const std::string& path) {
+  stop();
+  m_out.open(path, std::ios::binary | std::ios::trunc);
+  if (!m_out) {
+    LOGE("Couldn't open input log \"{}\" to record.", path);
+    return false;
+  }
+  m_out.write(g_magic, sizeof(g_magic));
+  m_out.put(static_cast<char>(g_version));
+
+  m_initTime  = Seconds(StdClock::now().time_since_epoch()).count();
+  m_frames    = 0u;
+  m_recording = true;
+  if (!Settings::quiet) LOGD("Recording input @ \"{}\"", path);
+  return true;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Load a log and start to feed it, false if it can't be read
+// ====================================================================== //
+
+bool Replay::play(const std::string& path) {
+  stop();
+  if (!Files::ok(path, true)) { return false; }
+
+  std::ifstream        in(path, std::ios::binary);
+  std::vector<uint8_t> data{std::istreambuf_iterator<char>(in),
+                            std::istreambuf_iterator<char>()};
+
+  if (data.size() < sizeof(g_magic) + 1u ||
+      std::memcmp(data.data(), g_magic, sizeof(g_magic)) != 0 ||
+      data[sizeof(g_magic)] != g_version) {
+    LOGE("Bad input log \"{}\".", path);
+    return false;
+  }
+
+  size_t pos = sizeof(g_magic) + 1u;
+  auto   get = [&](void* dst, size_t size) {
+    std::memcpy(dst, data.data() + pos, size);
+    pos += size;
+  };
+  auto getI16 = [&]() { int16_t x; get(&x, 2u); return (int)x; };
+  auto getU8  = [&]() { uint8_t x; get(&x, 1u); return (int)x; };
+
+  m_events.clear();
+  while (pos + 5u <= data.size()) {
+    event e{};
+    auto  k = getU8();
+    if (k > static_cast<int>(kind::scroll) ||
+        pos + 4u + g_payload[k] > data.size()) {
+      LOGE("Truncated input log \"{}\".", path);
+      break;
+    }
+    e.type = static_cast<kind>(k);
+    get(&e.time, 4u);
+
+    switch (e.type) {
+      case kind::frame: break;
+      case kind::key:
+        e.i0 = getI16();
+        e.i1 = getI16();
+        e.i2 = getU8();
+        e.i3 = getU8();
+        break;
+      case kind::mouseMove:
+      case kind::scroll:
+        get(&e.f0, 4u);
+        get(&e.f1, 4u);
+        break;
+      case kind::mouseClick:
+        e.i0 = getU8();
+        e.i1 = getU8();
+        e.i2 = getU8();
+        break;
+    }
+    m_events.push_back(e);
+  }
+
+  m_cursor    = 0u;
+  m_frames    = 0u;
+  m_initTime  = Seconds(StdClock::now().time_since_epoch()).count();
+  m_replaying = true;
+  if (!Settings::quiet) LOGD("Replaying {} input events", m_events.size());
+  return true;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Stop recording or replaying
+// ====================================================================== //
+
+void Replay::stop() {
+  if ((m_recording || m_replaying) && !Settings::quiet) {
+    auto secs = elapsed() * 1e-6;
+    LOGD("Input {}: {} frames in {}s ({}ms/frame)",
+         (m_recording) ? "recorded" : "replayed",
+         m_frames,
+         secs,
+         (m_frames > 0u) ? secs * 1e3 / m_frames : 0.0);
+  }
+  if (m_out.is_open()) m_out.close();
+  m_events.clear();
+  m_tick      = nullptr;
+  m_recording = m_replaying = m_feeding = false;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Step a tick from the frame loop by the virtual clock instead of its own
+// timer. The first tick runs on the next frame
+// ====================================================================== //
+
+void Replay::drive(const std::function<float()>& tick) {
+  m_tick     = tick;
+  m_nextTick = 0.0;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// State getters
+// ====================================================================== //
+
+bool Replay::recording() { return m_recording; }
+bool Replay::replaying() { return m_replaying; }
+bool Replay::feeding() { return m_feeding; }
+
+// ====================================================================== //
+// ====================================================================== //
+// Capture input events (only while recording)
+// ====================================================================== //
+
+void Replay::key(int key, int scancode, int action, int mods) {
+  if (m_recording) write({kind::key, elapsed(), key, scancode, action, mods});
+}
+
+void Replay::mouseMove(double x, double y) {
+  if (m_recording)
+    write({kind::mouseMove, elapsed(), 0, 0, 0, 0, (float)x, (float)y});
+}
+
+void Replay::mouseClick(int button, int action, int mods) {
+  if (m_recording) write({kind::mouseClick, elapsed(), button, action, mods});
+}
+
+void Replay::scroll(double xOff, double yOff) {
+  if (m_recording)
+    write({kind::scroll, elapsed(), 0, 0, 0, 0, (float)xOff, (float)yOff});
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Per frame: mark the frame on record, or feed the events of the frame on
+// replay. Returns false when a replay reaches its end
+// ====================================================================== //
+
+bool Replay::frame() {
+  // Input of the frame was polled before, ticks up to now go after it
+  if (m_recording) {
+    auto now = elapsed();
+    write({kind::frame, now});
+    advance(now);
+    ++m_frames;
+  }
+
+  if (m_replaying) {
+    if (m_cursor >= m_events.size()) {
+      stop();
+      return false;
+    }
+    // Events recorded before this frame mark, same order as recorded
+    // Then the ticks up to the recorded time of the mark, as recorded
+    m_feeding = true;
+    while (m_cursor < m_events.size()) {
+      const auto& e = m_events[m_cursor++];
+      if (e.type == kind::frame) {
+        advance(e.time);
+        break;
+      }
+      dispatch(e);
+    }
+    m_feeding = false;
+    ++m_frames;
+  }
+
+  return true;
+}
+
+} // namespace imog
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+
+namespace imog {
+
+// Record user input (keyboard, mouse and frame marks) to a compact binary
+// log and feed it back frame by frame, so performance runs are repeatable.
+// While recording or replaying, the time of the frame marks is a virtual
+// clock that steps the driven ticks (animation) from the frame loop, so a
+// log gives the same input and tick interleaving on every run.
+class Replay {
+
+public:
+  enum struct kind : uint8_t { frame, key, mouseMove, mouseClick, scroll };
+
+  struct event {
+    kind     type;
+    uint32_t time; // Microseconds since the log started
+    int      i0, i1, i2, i3;
+    float    f0, f1;
+  };
+
+private:
+  static bool m_recording;
+  static bool m_replaying;
+  static bool m_feeding;
+
+  static std::ofstream      m_out;
+  static std::vector<event> m_events;
+  static size_t             m_cursor;
+  static double             m_initTime;
+  static unsigned int       m_frames;
+
+  // Ticks stepped by the virtual clock, and when the next one is due
+  static std::function<float()> m_tick;
+  static double                 m_nextTick;
+
+  // Run the ticks due up to this virtual time (microseconds)
+  static void advance(uint32_t time);
+
+  // Microseconds since the log started
+  static uint32_t elapsed();
+
+  // Append an event to the log file
+  static void write(const event& e);
+
+  // Dispatch an event to the IO callbacks
+  static void dispatch(const event& e);
+
+public:
+  // Start to record the input on a file, false if it can't be opened
+  static bool record(const std::string& path);
+
+  // Load a log and start to feed it, false if it can't be read
+  static bool play(const std::string& path);
+
+  // Stop recording or replaying
+  static void stop();
+
+  // Step a tick from the frame loop by the virtual clock instead of its own
+  // timer. The function runs one tick and returns seconds until the next
+  static void drive(const std::function<float()>& tick);
+
+  // State getters
+  static bool recording();
+  static bool replaying();
+
+  // Returns true while events come from the log. IO callbacks use it to
+  // ignore real input during a replay
+  static bool feeding();
+
+  // Capture input events (only while recording)
+  static void key(int key, int scancode, int action, int mods);
+  static void mouseMove(double x, double y);
+  static void mouseClick(int button, int action, int mods);
+  static void scroll(double xOffset, double yOffset);
+
+  // Per frame: mark the frame on record, or feed the events of the frame on
+  // replay. Returns false when a replay reaches its end
+  static bool frame();
+};
+
+} // namespace imog
@@ -0,0 +1,166 @@
+#include "gltools_SceneGraph.hpp"
+
+#include "cpptools_Logger.hpp"
+
+namespace imog {
+
+// * private
+
+// ====================================================================== //
+// ====================================================================== //
+// Sort nodes by depth on the hierarchy (counting sort), so a linear walk
+// always finds the parent world matrix already updated
+// ====================================================================== //
+
+void SceneGraph::sortNodes() {
+  std::vector<unsigned int> depth(m_parent.size(), 0u);
+  unsigned int              maxDepth = 0u;
+
+  for (auto n = 0u; n < m_parent.size(); ++n) {
+    for (auto p = m_parent[n]; p != none; p = m_parent[p]) ++depth[n];
+    maxDepth = glm::max(maxDepth, depth[n]);
+  }
+
+  std::vector<unsigned int> first(maxDepth + 2u, 0u);
+  for (auto d : depth) ++first[d + 1u];
+  for (auto d = 1u; d < first.size(); ++d) first[d] += first[d - 1u];
+
+  m_order.resize(m_parent.size());
+  for (auto n = 0u; n < m_parent.size(); ++n) m_order[first[depth[n]]++] = n;
+  m_orderDirty = false;
+}
+
+
+// * public
+
+// ====================================================================== //
+// ====================================================================== //
+// Add a node, optionally following a transform and under a parent
+// ====================================================================== //
+
+SceneGraph::node SceneGraph::add(const Transform* source, node parent) {
+  auto n = static_cast<node>(m_parent.size());
+
+  m_parent.push_back(none);
+  m_source.push_back(source);
+  m_sourceState.emplace_back();
+  m_local.emplace_back(1.f);
+  m_world.emplace_back(1.f);
+  m_dirty.push_back(1u);
+  m_moved.push_back(0u);
+  m_order.push_back(n); // Roots can go last, no sort needed
+
+  if (source) {
+    m_sourceState[n] = *source;
+    m_local[n]       = m_sourceState[n].asMatrix();
+  }
+  if (parent != none) setParent(n, parent);
+  return n;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Stop following the transform and detach the node and its children,
+// call it before the transform dies
+// ====================================================================== //
+
+void SceneGraph::release(node n) {
+  if (n >= m_parent.size()) return;
+  for (auto c = 0u; c < m_parent.size(); ++c) {
+    if (m_parent[c] == n) setParent(c, none);
+  }
+  setParent(n, none);
+  m_source[n] = nullptr;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Move a node under other one (or none). False if it would make a loop
+// ====================================================================== //
+
+bool SceneGraph::setParent(node n, node parent) {
+  if (n >= m_parent.size()) return false;
+  if (parent != none) {
+    if (parent >= m_parent.size()) return false;
+    for (auto p = parent; p != none; p = m_parent[p]) {
+      if (p == n) {
+        LOGE("Scene node {} can't be a child of its descendant {}", n, parent);
+        return false;
+      }
+    }
+  }
+  if (m_parent[n] == parent) return true;
+
+  m_parent[n]  = parent;
+  m_dirty[n]   = 1u;
+  m_orderDirty = true;
+  return true;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Set local matrix of a node that doesn't follow a transform
+// ====================================================================== //
+
+void SceneGraph::setLocal(node n, const glm::mat4& local) {
+  m_local[n] = local;
+  m_dirty[n] = 1u;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Getters
+// ====================================================================== //
+
+SceneGraph::node SceneGraph::parent(node n) const { return m_parent[n]; }
+
+const glm::mat4& SceneGraph::local(node n) const { return m_local[n]; }
+
+const glm::mat4& SceneGraph::world(node n) const { return m_world[n]; }
+
+// ====================================================================== //
+// ====================================================================== //
+// World matrix changed on last update
+// ====================================================================== //
+
+bool SceneGraph::moved(node n) const { return m_moved[n]; }
+
+// ====================================================================== //
+// ====================================================================== //
+// Recompute world matrices of changed nodes and their children.
+// Parents come first on m_order, so "moved" flows down in one pass
+// ====================================================================== //
+
+unsigned int SceneGraph::update() {
+  if (m_orderDirty) sortNodes();
+
+  auto updated = 0u;
+  for (auto n : m_order) {
+    if (auto src = m_source[n]) {
+      if (!src->sameAs(m_sourceState[n])) {
+        m_sourceState[n] = *src;
+        m_local[n]       = m_sourceState[n].asMatrix();
+        m_dirty[n]       = 1u;
+      }
+    }
+
+    auto p     = m_parent[n];
+    auto dirty = m_dirty[n] || (p != none && m_moved[p]);
+    m_moved[n] = dirty;
+    if (!dirty) continue;
+
+    m_world[n] = (p != none) ? m_world[p] * m_local[n] : m_local[n];
+    m_dirty[n] = 0u;
+    ++updated;
+  }
+  return updated;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Number of nodes
+// ====================================================================== //
+
+size_t SceneGraph::size() const { return m_parent.size(); }
+
+} // namespace imog
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "gltools_Math.hpp"
+#include "gltools_Transform.hpp"
+
+namespace imog {
+
+// Transform hierarchy stored as flat arrays indexed by node. Each node caches
+// its local and world matrices, a node is recomputed only when its local
+// matrix changed or its parent moved, so static nodes cost a compare per
+// update. Nodes may follow a Transform, which is read on every update and
+// compared with the copy its local matrix was built from. The graph owns
+// every cached matrix, use it from one thread only.
+class SceneGraph {
+
+public:
+  using node                 = unsigned int;
+  static constexpr node none = ~0u;
+
+private:
+  std::vector<node>             m_parent;
+  std::vector<const Transform*> m_source;
+  std::vector<Transform>        m_sourceState; // Values local was built from
+  std::vector<glm::mat4>        m_local;
+  std::vector<glm::mat4>        m_world;
+  std::vector<uint8_t>          m_dirty; // Local changed since last update
+  std::vector<uint8_t>          m_moved; // World changed on last update
+
+  // Nodes with parents always after them, rebuilt if hierarchy changes
+  std::vector<node> m_order;
+  bool              m_orderDirty{false};
+
+  // Sort nodes by depth on the hierarchy
+  void sortNodes();
+
+public:
+  // Add a node, optionally following a transform and under a parent
+  node add(const Transform* source = nullptr, node parent = none);
+
+  // Stop following the transform and detach the node and its children,
+  // call it before the transform dies
+  void release(node n);
+
+  // Move a node under other one (or none). False if it would make a loop
+  bool setParent(node n, node parent);
+
+  // Set local matrix of a node that doesn't follow a transform
+  void setLocal(node n, const glm::mat4& local);
+
+  // Getters
+  node             parent(node n) const;
+  const glm::mat4& local(node n) const;
+  const glm::mat4& world(node n) const;
+
+  // World matrix changed on last update
+  bool moved(node n) const;
+
+  // Recompute world matrices of changed nodes and their children.
+  // Returns how many nodes were recomputed
+  unsigned int update();
+
+  // Number of nodes
+  size_t size() const;
+};
+
+} // namespace imog
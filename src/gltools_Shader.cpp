@@ -1,11 +1,16 @@
 #include "gltools_Shader.hpp"
 
 #include <vector>
+#include <algorithm>
 
 #include <glad/glad.h>
 
 #include "Settings.hpp"
+#include "gltools_GLState.hpp"
+#include "gltools_Texture.hpp"
+#include "gltools_ProgramCache.hpp"
 #include "cpptools_Files.hpp"
+#include "cpptools_Timer.hpp"
 #include "cpptools_Logger.hpp"
 #include "cpptools_Strings.hpp"
 #include "helpers/Consts.hpp"
@@ -20,8 +25,15 @@ namespace imog {
 // Global pool for shaders
 // ====================================================================== //
 
-std::vector<std::shared_ptr<Shader>>          Shader::pool{};
-std::unordered_map<std::string, unsigned int> Shader::poolIndices{};
+Registry<Shader> Shader::pool{};
+
+// ====================================================================== //
+// ====================================================================== //
+// Per frame block, shared by all the programs
+// ====================================================================== //
+
+UniformBuffer Shader::m_frameUBO{Shader::frameBinding,
+                                 sizeof(Shader::frameBlock)};
 
 // ====================================================================== //
 // ====================================================================== //
@@ -30,8 +42,28 @@ std::unordered_map<std::string, unsigned int> Shader::poolIndices{};
 // ====================================================================== //
 
 std::shared_ptr<Shader> Shader::getFromCache(const std::string& paths) {
-  if (poolIndices.count(paths) > 0) { return pool[poolIndices[paths]]; }
-  return nullptr;
+  return pool.get(pool.find(paths));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Source of a shader file with the defines after its #version line, which
+// must be the first thing on the file. #line keeps log lines right
+// ====================================================================== //
+
+std::string Shader::sourceWithDefines(const std::string& filePath,
+                                      const std::string& defines) {
+  auto source = Strings::fromFile(filePath);
+  if (defines.empty()) return source;
+
+  auto version = source.find("#version");
+  auto eol     = (version != std::string::npos) ? source.find('\n', version)
+                                                : std::string::npos;
+  if (eol == std::string::npos) return defines + source;
+
+  auto line = std::count(source.begin(), source.begin() + eol, '\n') + 2;
+  return source.substr(0u, eol + 1u) + defines +
+         "#line " + std::to_string(line) + "\n" + source.substr(eol + 1u);
 }
 
 // ====================================================================== //
@@ -40,8 +72,7 @@ std::shared_ptr<Shader> Shader::getFromCache(const std::string& paths) {
 // ====================================================================== //
 
 std::shared_ptr<Shader> Shader::getByName(const std::string& name) {
-  auto _name = Strings::toLower(name);
-  if (poolIndices.count(_name) > 0) { return pool[poolIndices[_name]]; }
+  if (auto S = get(find(name))) { return S; }
 
   if (!Settings::quiet) LOGE("Zero entries @ shaders pool with name {}.", name);
   return nullptr;
@@ -49,13 +80,49 @@ std::shared_ptr<Shader> Shader::getByName(const std::string& name) {
 
 // ====================================================================== //
 // ====================================================================== //
-// Create a new shader if it isn't on the gloabl pool
+// Get the handle of a shader by name. Resolve it once at load time
 // ====================================================================== //
 
-std::shared_ptr<Shader> Shader::create(const std::string& name,
-                                       const std::string& vertexPath,
-                                       const std::string& geomPath,
-                                       const std::string& fragPath) {
+Handle<Shader> Shader::find(const std::string& name) { return pool.find(name); }
+
+// ====================================================================== //
+// ====================================================================== //
+// Get a shader from the global pool by handle (per-frame safe)
+// ====================================================================== //
+
+const std::shared_ptr<Shader>& Shader::get(Handle<Shader> handle) {
+  return pool.get(handle);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Name of a permutation: the shader name and its sorted defines,
+// "base" without defines, "base:SKINNED:MAX_BONES 64" with them
+// ====================================================================== //
+
+std::string Shader::permutation(const std::string&              name,
+                                const std::vector<std::string>& defines) {
+  auto sorted = defines;
+  std::sort(sorted.begin(), sorted.end());
+
+  auto out = Strings::toLower(name);
+  for (const auto& d : sorted) { out += ":" + d; }
+  return out;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Create a new shader if it isn't on the gloabl pool. Each define
+// ("NAME" or "NAME value") is a #define on every stage. Same defines in
+// other order are the same permutation
+// ====================================================================== //
+
+std::shared_ptr<Shader>
+    Shader::create(const std::string&              name,
+                   const std::string&              vertexPath,
+                   const std::string&              geomPath,
+                   const std::string&              fragPath,
+                   const std::vector<std::string>& defines) {
 
   if (vertexPath.empty() || fragPath.empty()) {
     if (!Settings::quiet) LOGE("Undefined non-optional shaders");
@@ -68,17 +135,22 @@ std::shared_ptr<Shader> Shader::create(const std::string& name,
     if (!Files::ok(fp, true)) { return nullptr; }
   }
 
-  auto paths = vertexPath + geomPath + fragPath;
-  if (auto S = getFromCache(paths)) { return S; }
+  auto sorted = defines;
+  std::sort(sorted.begin(), sorted.end());
+  std::string defineBlock;
+  for (const auto& d : sorted) { defineBlock += "#define " + d + "\n"; }
 
-  auto _name = Strings::toLower(name);
-  pool.push_back(
-      std::make_shared<Shader>(_name, vertexPath, geomPath, fragPath));
+  auto paths = vertexPath + geomPath + fragPath + defineBlock;
+  if (auto S = getFromCache(paths)) { return S; }
 
-  auto idx           = pool.size() - 1;
-  poolIndices[_name] = idx;
-  poolIndices[paths] = idx;
-  return pool.at(idx);
+  auto S = std::make_shared<Shader>(permutation(name, defines),
+                                    vertexPath,
+                                    geomPath,
+                                    fragPath,
+                                    defineBlock);
+  S->m_handle = pool.add(S, S->m_name);
+  pool.alias(paths, S->m_handle);
+  return S;
 }
 
 // ====================================================================== //
@@ -86,9 +158,11 @@ std::shared_ptr<Shader> Shader::create(const std::string& name,
 // Create a new shader by a gived name, searching it in default forlder
 // ====================================================================== //
 
-std::shared_ptr<Shader> Shader::createByName(const std::string& name,
-                                             bool               hasGeometry,
-                                             bool hasTesselation) {
+std::shared_ptr<Shader>
+    Shader::createByName(const std::string&              name,
+                         bool                            hasGeometry,
+                         bool                            hasTesselation,
+                         const std::vector<std::string>& defines) {
   auto        _name = Strings::toLower(name);
   std::string sPath = Paths::shaders + _name + "/" + _name;
   std::string sV    = sPath + ".vert";
@@ -97,16 +171,31 @@ std::shared_ptr<Shader> Shader::createByName(const std::string& name,
   // std::string sTE   = (hasTesselation) ? sPath + ".tese" : "";
   std::string sF = sPath + ".frag";
   // return Shader::create(_name, sV, sG, sTC, sTE, sF);
-  return Shader::create(_name, sV, sG, sF);
+  return Shader::create(_name, sV, sG, sF, defines);
 }
 
 // ====================================================================== //
 // ====================================================================== //
-// Update all shaders of the pool
+// Upload per frame data (camera, clear color) once for all the pool
 // ====================================================================== //
 
 void Shader::poolUpdate(const std::shared_ptr<Camera>& camera) {
-  for (const auto& s : pool) { s->update(camera); }
+  if (!camera) {
+    poolUpdate(glm::mat4{}, glm::mat4{}, glm::mat4{});
+    return;
+  }
+  poolUpdate(camera->view(), camera->proj(), camera->viewproj());
+}
+
+void Shader::poolUpdate(const glm::mat4& view,
+                        const glm::mat4& proj,
+                        const glm::mat4& viewproj) {
+  frameBlock block{};
+  block.clearColor = glm::vec4(Settings::clearColor, 1.f);
+  block.matV       = view;
+  block.matP       = proj;
+  block.matVP      = viewproj;
+  m_frameUBO.update(&block);
 }
 
 // * private
@@ -114,16 +203,16 @@ void Shader::poolUpdate(const std::shared_ptr<Camera>& camera) {
 
 // ====================================================================== //
 // ====================================================================== //
-// Return the OpenGL state machine ID for a filePath
-// shader, if source compilation fails returns 0
+// Return the OpenGL state machine ID for a shader source,
+// if source compilation fails returns 0
 // ====================================================================== //
 
 unsigned int Shader::loadShader(const std::string& filePath,
+                                const std::string& source,
                                 unsigned int       type) {
   // Data
-  std::string sourceStr  = Strings::fromFile(filePath);
-  const char* sourceChar = sourceStr.c_str();
-  int         sourceLen  = sourceStr.length();
+  const char* sourceChar = source.c_str();
+  int         sourceLen  = source.length();
 
   // Request shader to opengl
   unsigned int shader = glCreateShader(type);
@@ -156,51 +245,102 @@ unsigned int Shader::loadShader(const std::string& filePath,
 // Param constructor
 //
 // 1. Create new program
-// 2. Compile shaders:
+// 2. Load it from the program cache if there, jump to 6 then
+// 3. Compile shaders:
 //    - required = vertex, fragment.
 //    - optional = geometry.
-// 3. Apped it to a created program
-// 4. Link program
-// 5. Verify that its linked (if not, delete it and prompt an alert)
+// 4. Apped it to a created program
+// 5. Link program, verify it (if not, delete it and prompt an alert) and
+//    store its binary on the program cache
+// 6. Link uniform blocks to their binding points
+// 7. Resolve builtin uniforms, samplers point to the texture unit
 // ====================================================================== //
 
 Shader::Shader(const std::string& name,
                const std::string& vertexPath,
                const std::string& geomPath,
-               const std::string& fragPath)
-    : m_name(name) {
-
-  auto addShader = [&](unsigned int p, const std::string& s, unsigned int t) {
-    if (!s.empty() && Files::ok(s, true)) {
-      unsigned int sID = loadShader(s, t);
-      glAttachShader(p, sID);
-      glDeleteShader(sID);
-    }
+               const std::string& fragPath,
+               const std::string& defines)
+    : m_name(name), m_fromBinary(false) {
+  Timer timer("Program \"" + m_name + "\"");
+
+  struct stage {
+    const std::string& path;
+    unsigned int       type;
+    std::string        source;
   };
+  stage stages[] = {{vertexPath, GL_VERTEX_SHADER, ""},
+                    {fragPath, GL_FRAGMENT_SHADER, ""},
+                    {geomPath, GL_GEOMETRY_SHADER, ""}};
+
+  std::vector<std::string> sources;
+  for (auto& st : stages) {
+    if (st.path.empty() || !Files::ok(st.path, true)) continue;
+    st.source = sourceWithDefines(st.path, defines);
+    sources.push_back(st.source);
+  }
+  auto key = ProgramCache::key(sources, defines);
 
   // 1. Request program to opengl
   m_program = glCreateProgram();
 
-  // 2&3. MUST Shaders
-  addShader(m_program, vertexPath, GL_VERTEX_SHADER);
-  addShader(m_program, fragPath, GL_FRAGMENT_SHADER);
+  // 2. Cached binary, same sources on same driver
+  m_fromBinary = ProgramCache::load(m_program, m_name, key);
+
+  if (!m_fromBinary) {
+    // 3&4. MUST Shaders, then OPTIONAL ones
+    auto compiled = true;
+    for (const auto& st : stages) {
+      if (st.source.empty()) continue;
+      unsigned int sID = loadShader(st.path, st.source, st.type);
+      if (!sID) {
+        compiled = false;
+        continue;
+      }
+      glAttachShader(m_program, sID);
+      glDeleteShader(sID);
+    }
+
+    // 5. Link program, asking the driver to keep its binary
+    if (ProgramCache::supported()) {
+      glProgramParameteri(
+          m_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(m_program);
+
+    int linked;
+    glGetProgramiv(m_program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+      int len = 0;
+      glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &len);
+      std::vector<char> msg(len);
+      glGetProgramInfoLog(m_program, len, &len, &msg[0]);
+      LOGE("Program {} \n{}", m_name, std::string(msg.data(), msg.size()));
+      glDeleteProgram(m_program);
+      return;
+    }
 
-  // 2&3. OPTIONAL Shaders
-  addShader(m_program, geomPath, GL_GEOMETRY_SHADER);
+    // A program missing a stage may still link, never cache it
+    if (compiled) ProgramCache::store(m_program, m_name, key);
+  }
 
-  // 4. Link program
-  glLinkProgram(m_program);
+  // 6. Link uniform blocks to their binding points. Not part of the
+  //    binary, set every time
+  auto bindBlock = [&](const char* blockName, unsigned int binding) {
+    auto idx = glGetUniformBlockIndex(m_program, blockName);
+    if (idx != GL_INVALID_INDEX) glUniformBlockBinding(m_program, idx, binding);
+  };
+  bindBlock("Frame", frameBinding);
+  bindBlock("Draw", drawBinding);
 
-  // 5. Check errors
-  int linked;
-  glGetProgramiv(m_program, GL_LINK_STATUS, &linked);
-  if (!linked) {
-    int len = 0;
-    glGetProgramiv(m_program, GL_INFO_LOG_LENGTH, &len);
-    std::vector<char> msg(len);
-    glGetProgramInfoLog(m_program, len, &len, &msg[0]);
-    LOGE("Program {} \n{}", m_name, std::string(msg.data(), msg.size()));
-    glDeleteProgram(m_program);
+  // 7. Resolve builtin uniforms. Not every program uses all of them
+  u.texture.location   = glGetUniformLocation(m_program, "u_texture");
+  u.instanced.location = glGetUniformLocation(m_program, "u_instanced");
+
+  // Every texture array is bound to the same unit, set the sampler once
+  if (u.texture.location >= 0) {
+    GLState::useProgram(m_program);
+    glUniform1i(u.texture.location, Texture::unit);
   }
 }
 
@@ -219,60 +359,75 @@ Shader::~Shader() {
 // Bind set this program as active and use it to draw
 // ====================================================================== //
 
-void Shader::bind() { glUseProgram(m_program); }
+void Shader::bind() { GLState::useProgram(m_program); }
 
 // ====================================================================== //
 // ====================================================================== //
 // Unbind unset this program as active so won't be used to draw
 // ====================================================================== //
 
-void Shader::unbind() { glUseProgram(0); }
+void Shader::unbind() { GLState::useProgram(0); }
 
 // ====================================================================== //
 // ====================================================================== //
-// Update upload to the shader camera data
+// Getter for handle
 // ====================================================================== //
 
-void Shader::update(const std::shared_ptr<Camera>& camera) {
+Handle<Shader> Shader::handle() const { return m_handle; }
 
-  uFloat3("u_clearColor", Settings::clearColor);
+// ====================================================================== //
+// ====================================================================== //
+// Was it loaded from the program cache instead of built from source?
+// ====================================================================== //
 
-  if (camera) {
-    uMat4("u_matV", camera->view());
-    uMat4("u_matP", camera->proj());
-    uMat4("u_matVP", camera->viewproj());
-  }
-}
+bool Shader::fromBinary() const { return m_fromBinary; }
 
 // ====================================================================== //
 // ====================================================================== //
-// Returns the ID of the uniform associated to that string,
+// Returns the ID of the uniform associated to that name,
 // if its cached, return from cache, else request it to OpenGL
 // and store on cache.
 // ====================================================================== //
 
-int Shader::uniform(const std::string& uName) {
+int Shader::uniform(StringID uName) {
 
-  if (m_uCache.count(uName) > 0) { return m_uCache.at(uName); }
-  int uLoc = glGetUniformLocation(m_program, uName.c_str());
+  if (auto cached = m_uCache.find(uName)) { return *cached; }
+  int uLoc = glGetUniformLocation(m_program, uName.str());
 
-  if (uLoc > -1) {
-    m_uCache.insert({uName, uLoc});
-  } else if (!Settings::quiet && !m_alertCache[uName]) {
-    LOGE("@{}: not found/used \"{}\"", m_name, uName);
-    m_alertCache[uName] = true;
+  if (uLoc < 0 && !Settings::quiet) {
+    LOGE("@{}: not found/used \"{}\"", m_name, uName.str());
   }
+  m_uCache.set(uName, uLoc);
 
   return uLoc;
 }
 
 
+// ====================================================================== //
+// ====================================================================== //
+// Upload through a typed handle, no lookups involved
+// ====================================================================== //
+
+void Shader::set(Uniform<int> u, int i) {
+  glProgramUniform1i(m_program, u.location, i);
+}
+void Shader::set(Uniform<float> u, float f) {
+  glProgramUniform1f(m_program, u.location, f);
+}
+void Shader::set(Uniform<glm::vec3> u, const glm::vec3& v) {
+  glProgramUniform3fv(m_program, u.location, 1, glm::value_ptr(v));
+}
+void Shader::set(Uniform<glm::mat4> u, const glm::mat4& m) {
+  glProgramUniformMatrix4fv(
+      m_program, u.location, 1, GL_FALSE, glm::value_ptr(m));
+}
+
 // ====================================================================== //
 // ====================================================================== //
 // Upload a mat4 (view, proj, ...)
 // ====================================================================== //
 
-void Shader::uMat4(const std::string& uName, const glm::mat4& mat) {
+void Shader::uMat4(StringID uName, const glm::mat4& mat) {
   glProgramUniformMatrix4fv(
       m_program, uniform(uName), 1, GL_FALSE, glm::value_ptr(mat));
 }
@@ -282,7 +437,7 @@ void Shader::uMat4(const std::string& uName, const glm::mat4& mat) {
 // Upload a float (height, intensity, ...)
 // ====================================================================== //
 
-void Shader::uFloat1(const std::string& uName, float f) {
+void Shader::uFloat1(StringID uName, float f) {
   glProgramUniform1f(m_program, uniform(uName), f);
 }
 
@@ -291,7 +446,7 @@ void Shader::uFloat1(const std::string& uName, float f) {
 // Upload a vec3 (lightPos, color, ...)
 // ====================================================================== //
 
-void Shader::uFloat3(const std::string& uName, float f1, float f2, float f3) {
+void Shader::uFloat3(StringID uName, float f1, float f2, float f3) {
   glProgramUniform3f(m_program, uniform(uName), f1, f2, f3);
 }
 
@@ -300,7 +455,7 @@ void Shader::uFloat3(const std::string& uName, float f1, float f2, float f3) {
 // Upload a vec3 (lightPos, color, ...)
 // ====================================================================== //
 
-void Shader::uFloat3(const std::string& uName, const glm::vec3& floats) {
+void Shader::uFloat3(StringID uName, const glm::vec3& floats) {
   glProgramUniform3fv(m_program, uniform(uName), 1, glm::value_ptr(floats));
 }
 
@@ -309,7 +464,7 @@ void Shader::uFloat3(const std::string& uName, const glm::vec3& floats) {
 // Upload a int1 (textures, ...)
 // ====================================================================== //
 
-void Shader::uInt1(const std::string& uName, int i) {
+void Shader::uInt1(StringID uName, int i) {
   glProgramUniform1i(m_program, uniform(uName), i);
 }
 
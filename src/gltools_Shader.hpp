@@ -1,72 +1,137 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <memory>
-#include <unordered_map>
 
 #include "gltools_Math.hpp"
 #include "gltools_Camera.hpp"
+#include "cpptools_IDMap.hpp"
+#include "cpptools_Registry.hpp"
+#include "gltools_UniformBuffer.hpp"
 
 
 namespace imog {
 
 class Shader {
 
+public:
+  // Typed uniform location. Resolve it once, upload it with set()
+  template <typename T>
+  struct Uniform {
+    int location{-1};
+  };
+
+  // std140 blocks declared by every shader (see assets/shaders)
+  struct frameBlock {
+    glm::mat4 matV;
+    glm::mat4 matP;
+    glm::mat4 matVP;
+    glm::vec4 clearColor;
+  };
+  struct drawBlock {
+    glm::mat4 matMV;
+    glm::mat4 matN;
+    glm::vec4 color;     // Alpha is the texture array layer, -1 for none
+    glm::vec4 posOffset; // Packed positions decode to offset + q * scale
+    glm::vec4 posScale;
+  };
+  static constexpr unsigned int frameBinding = 0u;
+  static constexpr unsigned int drawBinding  = 1u;
+
 private:
+  // Per frame block, shared by all the programs
+  static UniformBuffer m_frameUBO;
+
   // Get a shared ptr to the shader from the global pool
   // by the concatenation of shaders paths
   static std::shared_ptr<Shader> getFromCache(const std::string& paths);
 
+  // Source of a shader file with the defines after its #version line
+  static std::string sourceWithDefines(const std::string& filePath,
+                                       const std::string& defines);
+
 public:
   // Global pool for shaders
-  static std::vector<std::shared_ptr<Shader>>          pool;
-  static std::unordered_map<std::string, unsigned int> poolIndices;
+  static Registry<Shader> pool;
 
   // Get a shared ptr to the shader from the global pool by name
   static std::shared_ptr<Shader> getByName(const std::string& name);
 
-  // Create a new shader if it isn't on the gloabl pool
-  static std::shared_ptr<Shader> create(const std::string& name,
-                                        const std::string& vertexPath,
-                                        const std::string& geomPath,
-                                        const std::string& fragPath);
+  // Get the handle of a shader by name. Resolve it once at load time
+  static Handle<Shader> find(const std::string& name);
+
+  // Get a shader from the global pool by handle (per-frame safe)
+  static const std::shared_ptr<Shader>& get(Handle<Shader> handle);
+
+  // Name of a permutation: the shader name and its sorted defines,
+  // "base" without defines, "base:SKINNED:MAX_BONES 64" with them
+  static std::string permutation(const std::string&              name,
+                                 const std::vector<std::string>& defines);
+
+  // Create a new shader if it isn't on the gloabl pool. Each define
+  // ("NAME" or "NAME value") is a #define on every stage
+  static std::shared_ptr<Shader>
+      create(const std::string&              name,
+             const std::string&              vertexPath,
+             const std::string&              geomPath,
+             const std::string&              fragPath,
+             const std::vector<std::string>& defines = {});
 
   // Create a new shader by a gived name, searching it in default forlder
-  static std::shared_ptr<Shader> createByName(const std::string& name,
-                                              bool hasGeometry    = false,
-                                              bool hasTesselation = false);
+  static std::shared_ptr<Shader>
+      createByName(const std::string&              name,
+                   bool                            hasGeometry    = false,
+                   bool                            hasTesselation = false,
+                   const std::vector<std::string>& defines        = {});
 
-  // Update all shaders of the pool
+  // Upload per frame data (camera, clear color) once for all the pool
   static void poolUpdate(const std::shared_ptr<Camera>& camera);
+  static void poolUpdate(const glm::mat4& view,
+                         const glm::mat4& proj,
+                         const glm::mat4& viewproj);
 
 
 private:
-  std::string m_name;
+  std::string    m_name;
+  Handle<Shader> m_handle;
 
   unsigned int m_program;
+  bool         m_fromBinary; // Loaded from the program cache
 
-  std::unordered_map<std::string, int>  m_uCache;
-  std::unordered_map<std::string, bool> m_alertCache; // Alert only once :D
+  IDMap<int> m_uCache; // Missing ones are cached too (-1), alert only once
 
-  // Return the OpenGL state machine ID for a filePath
-  // shader, if source compilation fails returns 0
-  unsigned int loadShader(const std::string& filePath, unsigned int type);
+  // Return the OpenGL state machine ID for a shader source,
+  // if source compilation fails returns 0
+  unsigned int loadShader(const std::string& filePath,
+                          const std::string& source,
+                          unsigned int       type);
 
 
 public:
+  // Uniforms used by the renderer, resolved at link time
+  struct builtins {
+    Uniform<int> texture;
+    Uniform<int> instanced;
+  } u;
+
   // Param constructor //! DO NOT CALL THIS DIRECTLY, use Create.
   //
   // 1. Create new program
-  // 2. Compile shaders:
+  // 2. Load it from the program cache if there, jump to 6 then
+  // 3. Compile shaders:
   //    - required = vertex, fragment.
   //    - optional = geometry.
-  // 3. Apped it to a created program
-  // 4. Link program
-  // 5. Verify that its linked (if not, delete it and prompt an alert)
+  // 4. Apped it to a created program
+  // 5. Link program, verify it (if not, delete it and prompt an alert) and
+  //    store its binary on the program cache
+  // 6. Link uniform blocks to their binding points
+  // 7. Resolve builtin uniforms
   Shader(const std::string& name,
          const std::string& vertexPath,
          const std::string& geomPath,
-         const std::string& fragPath);
+         const std::string& fragPath,
+         const std::string& defines = "");
 
   // Destructor
   ~Shader();
@@ -79,29 +144,44 @@ public:
   void unbind();
 
 
-  // Update upload to the shader camera data
-  void update(const std::shared_ptr<Camera>& camera);
+  // Getter for handle
+  Handle<Shader> handle() const;
+
+  // Was it loaded from the program cache instead of built from source?
+  bool fromBinary() const;
 
 
-  // Returns the ID of the uniform associated to that string,
+  // Returns the ID of the uniform associated to that name,
   // if its cached, return from cache, else request it to OpenGL
-  // and store it.
-  int uniform(const std::string& uniformName);
+  // and store it. Literal names are hashed at compile time.
+  int uniform(StringID uniformName);
+
+  // Typed handle of a uniform. Meant for load time, NOT for per-frame code
+  template <typename T>
+  Uniform<T> uniformHandle(StringID uniformName) {
+    return Uniform<T>{uniform(uniformName)};
+  }
+
+  // Upload through a typed handle, no lookups involved
+  void set(Uniform<int> u, int i);
+  void set(Uniform<float> u, float f);
+  void set(Uniform<glm::vec3> u, const glm::vec3& v);
+  void set(Uniform<glm::mat4> u, const glm::mat4& m);
 
   // Upload a mat4 (view, proj, ...)
-  void uMat4(const std::string& uniformName, const glm::mat4& mat);
+  void uMat4(StringID uniformName, const glm::mat4& mat);
 
   // Upload a float1 (height, intensity, ...)
-  void uFloat1(const std::string& uniformName, float f);
+  void uFloat1(StringID uniformName, float f);
 
   // Upload a vec3 (lightPos, color, ...)
-  void uFloat3(const std::string& uniformName, float f1, float f2, float f3);
+  void uFloat3(StringID uniformName, float f1, float f2, float f3);
 
   // Upload a vec3 (lightPos, color, ...)
-  void uFloat3(const std::string& uniformName, const glm::vec3& floats);
+  void uFloat3(StringID uniformName, const glm::vec3& floats);
 
   // Upload a int1 (textures, ...)
-  void uInt1(const std::string& uniformName, int i);
+  void uInt1(StringID uniformName, int i);
 };
 
 } // namespace imog
@@ -0,0 +1,372 @@
+#include "gltools_Skinning.hpp"
+
+#include <memory>
+#include <random>
+#include <algorithm>
+
+#include "Settings.hpp"
+#include "cpptools_Timer.hpp"
+#include "cpptools_Logger.hpp"
+#include "cpptools_ThreadPool.hpp"
+#include "gltools_VertexPacking.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IMOG_AVX2
+#include <immintrin.h>
+#endif
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Workers of big meshes, created on first use. Chunks smaller than this
+// cost more to hand over than to skin
+// ====================================================================== //
+
+static std::unique_ptr<ThreadPool> g_workers;
+static constexpr size_t            g_chunkVertices = 8192u;
+
+static ThreadPool& workers() {
+  if (!g_workers) {
+    auto threads = std::max(Settings::skinThreads, 0);
+    g_workers    = std::make_unique<ThreadPool>(threads);
+  }
+  return *g_workers;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Bind pose stored per component
+// ====================================================================== //
+
+void Skinning::bindPose::push(const glm::vec3& pos,
+                              const glm::vec3& normal,
+                              const int32_t*   joints,
+                              const float*     weights) {
+  px.push_back(pos.x);
+  py.push_back(pos.y);
+  pz.push_back(pos.z);
+  nx.push_back(normal.x);
+  ny.push_back(normal.y);
+  nz.push_back(normal.z);
+  for (auto k = 0u; k < influences; ++k) {
+    joint[k].push_back(joints[k]);
+    weight[k].push_back(weights[k]);
+  }
+}
+
+void Skinning::bindPose::clear() {
+  for (auto* v : {&px, &py, &pz, &nx, &ny, &nz}) v->clear();
+  for (auto k = 0u; k < influences; ++k) {
+    joint[k].clear();
+    weight[k].clear();
+  }
+}
+
+size_t Skinning::bindPose::size() const { return px.size(); }
+
+// ====================================================================== //
+// ====================================================================== //
+// Portable kernel, one vertex at a time. Joints of weight 0 are skipped
+// ====================================================================== //
+
+static Skinning::bounds skinScalar(const Skinning::bindPose& pose,
+                                   const glm::mat4*          palette,
+                                   size_t                    first,
+                                   size_t                    last,
+                                   Skinning::vertex*         out) {
+  Skinning::bounds b;
+  for (auto i = first; i < last; ++i) {
+    glm::mat4 m(0.f);
+    for (auto k = 0u; k < Skinning::influences; ++k) {
+      auto w = pose.weight[k][i];
+      if (w != 0.f) m += palette[pose.joint[k][i]] * w;
+    }
+
+    glm::vec3 n{pose.nx[i], pose.ny[i], pose.nz[i]};
+    auto&     v = out[i];
+    v.pos = glm::vec3(m * glm::vec4(pose.px[i], pose.py[i], pose.pz[i], 1.f));
+    VertexPacking::octEncode(glm::mat3(m) * n, v.normal);
+
+    b.min = glm::min(b.min, v.pos);
+    b.max = glm::max(b.max, v.pos);
+  }
+  return b;
+}
+
+#ifdef IMOG_AVX2
+
+// ====================================================================== //
+// ====================================================================== //
+// AVX2 kernel, 8 vertices at a time. Each of the 12 used elements of the
+// blended matrix gathers its joints from the palette. Normals go through
+// the same blended matrix and straight to octahedral: the encoding divides
+// by the L1 norm, no need to normalize first. The last vertices that
+// don't fill a register go to the portable kernel
+// ====================================================================== //
+
+__attribute__((target("avx2,fma"))) static Skinning::bounds
+    skinAVX2(const Skinning::bindPose& pose,
+             const glm::mat4*          palette,
+             size_t                    first,
+             size_t                    last,
+             Skinning::vertex*         out) {
+  const auto* base = &palette[0][0][0];
+  const auto  zero = _mm256_setzero_ps();
+  const auto  one  = _mm256_set1_ps(1.f);
+  const auto  sign = _mm256_set1_ps(-0.f);
+  const auto  snorm = _mm256_set1_ps(32767.f);
+
+  auto mnX = _mm256_set1_ps(std::numeric_limits<float>::max());
+  auto mnY = mnX, mnZ = mnX;
+  auto mxX = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+  auto mxY = mxX, mxZ = mxX;
+
+  auto i = first;
+  for (; i + 8u <= last; i += 8u) {
+    // Blended matrix, column c row r at m[c * 3 + r]
+    __m256 m[12];
+    for (auto& e : m) e = zero;
+    for (auto k = 0u; k < Skinning::influences; ++k) {
+      auto w = _mm256_loadu_ps(&pose.weight[k][i]);
+      if (!_mm256_movemask_ps(_mm256_cmp_ps(w, zero, _CMP_NEQ_OQ))) continue;
+      auto j = _mm256_slli_epi32(
+          _mm256_loadu_si256((const __m256i*)&pose.joint[k][i]), 4);
+      for (auto c = 0u; c < 4u; ++c) {
+        for (auto r = 0u; r < 3u; ++r) {
+          auto e       = _mm256_i32gather_ps(base + c * 4u + r, j, 4);
+          m[c * 3 + r] = _mm256_fmadd_ps(w, e, m[c * 3 + r]);
+        }
+      }
+    }
+
+    auto px = _mm256_loadu_ps(&pose.px[i]);
+    auto py = _mm256_loadu_ps(&pose.py[i]);
+    auto pz = _mm256_loadu_ps(&pose.pz[i]);
+    auto nx = _mm256_loadu_ps(&pose.nx[i]);
+    auto ny = _mm256_loadu_ps(&pose.ny[i]);
+    auto nz = _mm256_loadu_ps(&pose.nz[i]);
+
+    __m256 p[3], n[3];
+    for (auto r = 0u; r < 3u; ++r) {
+      p[r] = _mm256_fmadd_ps(
+          m[r],
+          px,
+          _mm256_fmadd_ps(
+              m[3 + r], py, _mm256_fmadd_ps(m[6 + r], pz, m[9 + r])));
+      n[r] = _mm256_fmadd_ps(
+          m[r], nx, _mm256_fmadd_ps(m[3 + r], ny, _mm256_mul_ps(m[6 + r], nz)));
+    }
+
+    mnX = _mm256_min_ps(mnX, p[0]);
+    mnY = _mm256_min_ps(mnY, p[1]);
+    mnZ = _mm256_min_ps(mnZ, p[2]);
+    mxX = _mm256_max_ps(mxX, p[0]);
+    mxY = _mm256_max_ps(mxY, p[1]);
+    mxZ = _mm256_max_ps(mxZ, p[2]);
+
+    // Octahedral: project on |x| + |y| + |z| = 1, fold the lower half
+    auto ax  = _mm256_andnot_ps(sign, n[0]);
+    auto ay  = _mm256_andnot_ps(sign, n[1]);
+    auto az  = _mm256_andnot_ps(sign, n[2]);
+    auto l1  = _mm256_add_ps(_mm256_add_ps(ax, ay), az);
+    auto inv = _mm256_and_ps(_mm256_cmp_ps(l1, zero, _CMP_GT_OQ),
+                             _mm256_div_ps(one, l1));
+    auto ex  = _mm256_mul_ps(n[0], inv);
+    auto ey  = _mm256_mul_ps(n[1], inv);
+
+    auto sx = _mm256_blendv_ps(
+        one, _mm256_set1_ps(-1.f), _mm256_cmp_ps(ex, zero, _CMP_LT_OQ));
+    auto sy = _mm256_blendv_ps(
+        one, _mm256_set1_ps(-1.f), _mm256_cmp_ps(ey, zero, _CMP_LT_OQ));
+    auto fx = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(sign, ey)), sx);
+    auto fy = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(sign, ex)), sy);
+    auto below = _mm256_cmp_ps(n[2], zero, _CMP_LT_OQ);
+    ex         = _mm256_blendv_ps(ex, fx, below);
+    ey         = _mm256_blendv_ps(ey, fy, below);
+
+    auto qx = _mm256_cvtps_epi32(_mm256_mul_ps(
+        _mm256_min_ps(_mm256_max_ps(ex, _mm256_set1_ps(-1.f)), one), snorm));
+    auto qy = _mm256_cvtps_epi32(_mm256_mul_ps(
+        _mm256_min_ps(_mm256_max_ps(ey, _mm256_set1_ps(-1.f)), one), snorm));
+    auto bits = _mm256_castsi256_ps(
+        _mm256_or_si256(_mm256_slli_epi32(qy, 16),
+                        _mm256_and_si256(qx, _mm256_set1_epi32(0xFFFF))));
+
+    // Transpose x, y, z, normal bits to 8 interleaved vertices
+    auto t0 = _mm256_unpacklo_ps(p[0], p[1]);
+    auto t1 = _mm256_unpackhi_ps(p[0], p[1]);
+    auto t2 = _mm256_unpacklo_ps(p[2], bits);
+    auto t3 = _mm256_unpackhi_ps(p[2], bits);
+    auto v0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    auto v1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    auto v2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    auto v3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+
+    auto* dst = reinterpret_cast<float*>(out + i);
+    _mm256_storeu_ps(dst + 0, _mm256_permute2f128_ps(v0, v1, 0x20));
+    _mm256_storeu_ps(dst + 8, _mm256_permute2f128_ps(v2, v3, 0x20));
+    _mm256_storeu_ps(dst + 16, _mm256_permute2f128_ps(v0, v1, 0x31));
+    _mm256_storeu_ps(dst + 24, _mm256_permute2f128_ps(v2, v3, 0x31));
+  }
+
+  auto b = skinScalar(pose, palette, i, last, out);
+  if (i > first) {
+    float lanes[6][8];
+    _mm256_storeu_ps(lanes[0], mnX);
+    _mm256_storeu_ps(lanes[1], mnY);
+    _mm256_storeu_ps(lanes[2], mnZ);
+    _mm256_storeu_ps(lanes[3], mxX);
+    _mm256_storeu_ps(lanes[4], mxY);
+    _mm256_storeu_ps(lanes[5], mxZ);
+    for (auto l = 0u; l < 8u; ++l) {
+      b.min = glm::min(b.min, {lanes[0][l], lanes[1][l], lanes[2][l]});
+      b.max = glm::max(b.max, {lanes[3][l], lanes[4][l], lanes[5][l]});
+    }
+  }
+  return b;
+}
+
+#endif
+
+// ====================================================================== //
+// ====================================================================== //
+// True if this CPU runs the AVX2 kernel
+// ====================================================================== //
+
+static bool hasAVX2() {
+#ifdef IMOG_AVX2
+  static const bool avx2 =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Skin vertices [first, last) of pose with the best kernel of this CPU
+// ====================================================================== //
+
+Skinning::bounds Skinning::skin(const bindPose&  pose,
+                                const glm::mat4* palette,
+                                size_t           first,
+                                size_t           last,
+                                vertex*          out) {
+#ifdef IMOG_AVX2
+  if (hasAVX2()) return skinAVX2(pose, palette, first, last, out);
+#endif
+  return skinScalar(pose, palette, first, last, out);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Skin the whole pose. Chunks are multiples of 8 vertices, one per thread
+// at most, the calling thread takes the last one
+// ====================================================================== //
+
+Skinning::bounds Skinning::skin(const bindPose&  pose,
+                                const glm::mat4* palette,
+                                vertex*          out) {
+  auto count = pose.size();
+  if (count < g_chunkVertices * 2u) return skin(pose, palette, 0u, count, out);
+
+  auto& pool   = workers();
+  auto  chunks = std::min<size_t>(pool.size() + 1u, count / g_chunkVertices);
+  auto  size   = (count / chunks + 7u) & ~size_t(7u);
+
+  std::vector<bounds> partial(chunks);
+  for (auto c = 0u; c + 1u < chunks; ++c) {
+    pool.submit([&, c]() {
+      partial[c] = skin(pose, palette, c * size, (c + 1u) * size, out);
+    });
+  }
+  partial.back() = skin(pose, palette, (chunks - 1u) * size, count, out);
+  pool.wait();
+
+  bounds b;
+  for (const auto& p : partial) {
+    b.min = glm::min(b.min, p.min);
+    b.max = glm::max(b.max, p.max);
+  }
+  return b;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Kernel used by skin
+// ====================================================================== //
+
+const char* Skinning::kernel() { return hasAVX2() ? "avx2" : "scalar"; }
+
+// ====================================================================== //
+// ====================================================================== //
+// Skin a random pose of that size over joints joints with every kernel,
+// and log the results. Vertices get 1 to 4 influences, like a character
+// ====================================================================== //
+
+Skinning::throughput Skinning::benchmark(size_t vertices, unsigned int joints) {
+  std::mt19937                          rng(7u);
+  std::uniform_real_distribution<float> unit(-1.f, 1.f);
+  std::uniform_int_distribution<int>    jointOf(0, std::max(joints, 1u) - 1);
+
+  bindPose pose;
+  for (auto i = 0u; i < vertices; ++i) {
+    int32_t j[influences];
+    float   w[influences]{};
+    auto    used = 1u + i % influences;
+    for (auto k = 0u; k < influences; ++k) {
+      j[k] = jointOf(rng);
+      if (k < used) w[k] = 1.f / used;
+    }
+    glm::vec3 p{unit(rng), unit(rng), unit(rng)};
+    pose.push(p * 50.f, glm::normalize(p + glm::vec3(0.f, 0.f, 1e-3f)), j, w);
+  }
+
+  std::vector<glm::mat4> palette(std::max(joints, 1u));
+  for (auto& m : palette) {
+    auto axis = glm::normalize(glm::vec3{unit(rng), unit(rng), 1.f});
+    m = glm::translate(glm::mat4(1.f), glm::vec3{unit(rng), unit(rng), 0.f});
+    m = glm::rotate(m, unit(rng) * 3.f, axis);
+  }
+  std::vector<vertex> out(vertices);
+
+  // Best of a few runs, in vertices per millisecond per thread
+  auto measure = [&](unsigned int threads, auto fn) {
+    auto best = 0.0;
+    for (auto run = 0u; run < 5u; ++run) {
+      auto start = StdClock::now();
+      fn();
+      auto ms = Seconds(StdClock::now() - start).count() * 1000.0;
+      best    = std::max(best, vertices / std::max(ms, 1e-6) / threads);
+    }
+    return best;
+  };
+
+  throughput t;
+  t.threads = workers().size() + 1u;
+  t.scalar  = measure(1u, [&]() {
+    skinScalar(pose, palette.data(), 0u, vertices, out.data());
+  });
+  t.simd = measure(1u, [&]() {
+    skin(pose, palette.data(), 0u, vertices, out.data());
+  });
+  t.threaded = measure(t.threads, [&]() {
+    skin(pose, palette.data(), out.data());
+  });
+
+  LOGD("Skinning {} vertices over {} joints, vertices/ms/core: scalar {:.0f}, "
+      "{} {:.0f}, {} on {} threads {:.0f}",
+      vertices,
+      joints,
+      t.scalar,
+      kernel(),
+      t.simd,
+      kernel(),
+      t.threads,
+      t.threaded);
+  return t;
+}
+
+} // namespace imog
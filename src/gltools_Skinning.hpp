@@ -0,0 +1,83 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "gltools_Math.hpp"
+
+namespace imog {
+
+// Linear blend skinning on the CPU, so characters deform on machines
+// without a GPU worth the name. Bind pose vertices are moved by up to four
+// joint matrices each: 8 vertices at once with AVX2 (checked at run
+// time), big meshes split in chunks over worker threads. No OpenGL here,
+// callers stream the output, see Renderable::streamVBO.
+class Skinning {
+
+public:
+  static constexpr unsigned int influences = 4u;
+
+  // Bind pose stored per component, the layout the kernels want. Weights
+  // of a vertex add up to 1, unused influences weigh 0
+  struct bindPose {
+    std::vector<float>   px, py, pz;
+    std::vector<float>   nx, ny, nz;
+    std::vector<int32_t> joint[influences];
+    std::vector<float>   weight[influences];
+
+    void   push(const glm::vec3& pos,
+                const glm::vec3& normal,
+                const int32_t*   joints,
+                const float*     weights);
+    void   clear();
+    size_t size() const;
+  };
+
+  // Skinned vertex as streamed to OpenGL (locations 0 and 1): position at
+  // full precision, normal octahedral snorm like packed meshes
+  struct vertex {
+    glm::vec3 pos;
+    int16_t   normal[2];
+  };
+  static_assert(sizeof(vertex) == 16, "Tightly packed skinned vertex");
+
+  // Box of the skinned positions
+  struct bounds {
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+  };
+
+  // Vertices skinned per millisecond per core, best of several runs
+  struct throughput {
+    double       scalar{0.0};   // One thread, portable kernel
+    double       simd{0.0};     // One thread, kernel()
+    double       threaded{0.0}; // kernel() on every thread, per thread
+    unsigned int threads{1u};
+  };
+
+  // Skin vertices [first, last) of pose. Palette has a matrix per joint
+  // index used by the pose: joint world matrix * inverse bind matrix
+  static bounds skin(const bindPose&  pose,
+                     const glm::mat4* palette,
+                     size_t           first,
+                     size_t           last,
+                     vertex*          out);
+
+  // Skin the whole pose. Big ones go in chunks to Settings::skinThreads
+  // workers, the calling thread takes one too
+  static bounds skin(const bindPose&  pose,
+                     const glm::mat4* palette,
+                     vertex*          out);
+
+  // Kernel used by skin: "avx2" or "scalar"
+  static const char* kernel();
+
+  // Skin a random pose of that size over joints joints with every
+  // kernel, and log the results
+  static throughput benchmark(size_t       vertices = 1u << 20,
+                              unsigned int joints   = 64u);
+};
+
+} // namespace imog
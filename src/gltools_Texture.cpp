@@ -1,12 +1,11 @@
 #include "gltools_Texture.hpp"
 
-#include <mutex>
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
+#include <limits>
+#include <algorithm>
 
 #include "cpptools_Files.hpp"
 #include "Settings.hpp"
+#include "gltools_TextureLoader.hpp"
 #include "helpers/GLAssert.hpp"
 
 
@@ -25,47 +24,22 @@ namespace imog {
 // Global pool and indexmap for textures
 // ====================================================================== //
 
-std::unordered_map<std::string, std::shared_ptr<Texture>> Texture::pool{};
+Registry<Texture> Texture::pool{true};
 
 
 // ====================================================================== //
 // ====================================================================== //
-// Init variables and load img to OpenGL context
+// Init variables, storage is got on allocate
 // ====================================================================== //
 
 Texture::Texture(const std::string& path)
-    : m_glID(0), m_path(path), m_bytes(0), m_width(0), m_height(0) {
-
-  static std::once_flag onceflag_stbflip;
-  std::call_once(onceflag_stbflip, stbi_set_flip_vertically_on_load, 1);
-
-  GL_ASSERT(glGenTextures(1, &m_glID));
-  GL_ASSERT(glBindTexture(GL_TEXTURE_2D, m_glID));
-
-
-  if (auto img = stbi_load(m_path.c_str(), &m_width, &m_height, &m_bytes, 4)) {
-    GL_ASSERT(glTexStorage2D(GL_TEXTURE_2D, 10, GL_RGBA8, m_width, m_height);)
-    GL_ASSERT(glTexSubImage2D(GL_TEXTURE_2D,
-                              0,
-                              0,
-                              0,
-                              m_width,
-                              m_height,
-                              GL_RGBA,
-                              GL_UNSIGNED_BYTE,
-                              img);)
-    GL_ASSERT(glGenerateMipmap(GL_TEXTURE_2D)); // This after glTexImg2D
-    stbi_image_free(img);
-  } else {
-    if (!Settings::quiet) LOGE("Failed loading texture \"{}\"", path);
-  }
-
-  GL_ASSERT(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);)
-  GL_ASSERT(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);)
-  GL_ASSERT(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);)
-  GL_ASSERT(glTexParameteri(
-                GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);)
-}
+    : m_array(nullptr),
+      m_layer(-1),
+      m_path(path),
+      m_width(0),
+      m_height(0),
+      m_levels(0),
+      m_baseLevel(std::numeric_limits<int>::max()) {}
 
 
 // ====================================================================== //
@@ -74,8 +48,16 @@ Texture::Texture(const std::string& path)
 // ====================================================================== //
 
 std::shared_ptr<Texture> Texture::getByPath(const std::string& path) {
-  if (pool.count(path) > 0) { return pool[path]; }
-  return nullptr;
+  return pool.get(pool.find(path));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Get a texture from the global pool by handle (per-frame safe)
+// ====================================================================== //
+
+const std::shared_ptr<Texture>& Texture::get(Handle<Texture> handle) {
+  return pool.get(handle);
 }
 
 // ====================================================================== //
@@ -86,38 +68,112 @@ std::shared_ptr<Texture> Texture::getByPath(const std::string& path) {
 std::shared_ptr<Texture> Texture::create(const std::string& path) {
   if (path.empty() || !Files::ok(path, true)) { return nullptr; }
   if (auto T = getByPath(path)) { return T; }
-  pool[path] = std::make_shared<Texture>(path);
-  return pool[path];
+  auto T      = std::make_shared<Texture>(path);
+  T->m_handle = pool.add(T, path);
+  TextureLoader::request(T);
+  return T;
 }
 
 // ====================================================================== //
 // ====================================================================== //
-// Just remove texture from OpenGL context
+// Give back its layer
 // ====================================================================== //
 
 Texture::~Texture() {
   if (!Settings::quiet) LOGD("Destroying texture: {}", m_path);
-  GL_ASSERT(glDeleteTextures(1, &m_glID));
+  if (m_array) m_array->release(m_layer);
 }
 
 // ====================================================================== //
 // ====================================================================== //
-// Active this texture binding it to its OpenGL slot
+// Bind its array to the texture unit
 // ====================================================================== //
 
-unsigned int Texture::bind() const {
-  GL_ASSERT(glActiveTexture(GL_TEXTURE0 + m_glID));
-  GL_ASSERT(glBindTexture(GL_TEXTURE_2D, m_glID));
-  return m_glID;
+void Texture::bind() const {
+  if (m_array) m_array->bind(unit);
 }
 
 // ====================================================================== //
 // ====================================================================== //
-// Disable this texture unbinding from its OpenGL slot
+// Unbind its array from the texture unit
 // ====================================================================== //
 
-void Texture::unbind() const { GL_ASSERT(glBindTexture(GL_TEXTURE_2D, 0)); }
+void Texture::unbind() const {
+  if (m_array) m_array->unbind(unit);
+}
+
+
+// ====================================================================== //
+// ====================================================================== //
+// A layer on an array of its size and mip levels. Once, by the loader.
+// Nothing is sampled until every level is done
+// ====================================================================== //
+
+void Texture::allocate(int width, int height, int levels) {
+  m_width     = width;
+  m_height    = height;
+  m_levels    = levels;
+  m_baseLevel = levels;
+
+  auto slot = TextureArray::acquire(width, height, levels);
+  m_array   = slot.array;
+  m_layer   = slot.layer;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Upload rows of a mip level from the bound pixel unpack buffer
+// ====================================================================== //
+
+void Texture::upload(int level, int y, int rows, size_t offset) {
+  if (m_array) m_array->upload(m_layer, level, y, rows, offset);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Mark a level as uploaded. Levels come coarse to fine. Sampling a coarse
+// level alone (as BASE_LEVEL did) isn't possible, that's per array
+// ====================================================================== //
+
+void Texture::levelDone(int level) {
+  if (level < m_baseLevel.load(std::memory_order_relaxed)) {
+    m_baseLevel.store(level, std::memory_order_release);
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Is every level uploaded?
+// ====================================================================== //
+
+bool Texture::ready() const {
+  // Level 0 is the last one, everything else is set by then
+  return m_baseLevel.load(std::memory_order_acquire) == 0 && m_array &&
+         m_levels > 0;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Array holding it, null until ready
+// ====================================================================== //
+
+const TextureArray* Texture::array() const {
+  return this->ready() ? m_array.get() : nullptr;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Layer on its array, -1 until ready
+// ====================================================================== //
+
+int Texture::layer() const { return this->ready() ? m_layer : -1; }
+
+// ====================================================================== //
+// ====================================================================== //
+// Getter for handle
+// ====================================================================== //
 
+Handle<Texture> Texture::handle() const { return m_handle; }
 
 // ====================================================================== //
 // ====================================================================== //
@@ -1,46 +1,89 @@
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <memory>
 #include <unordered_map>
 
+#include "cpptools_Registry.hpp"
+#include "gltools_TextureArray.hpp"
 
 namespace imog {
 
+// OpenGL 2D texture, as a layer of a TextureArray shared with the textures
+// of its size. Created empty and filled by the TextureLoader, which
+// decodes on worker threads and uploads coarse mip levels first. Until
+// every level is there it has no layer, and isn't sampled.
 class Texture {
 
 public:
-  // Global pool for textures
-  static std::unordered_map<std::string, std::shared_ptr<Texture>> pool;
+  // Global pool for textures, named by path
+  static Registry<Texture> pool;
+
+  // Texture unit every texture (array) is bound to
+  static constexpr unsigned int unit = 0u;
 
 
 private:
-  unsigned int m_glID;
-  std::string  m_path;
-  int          m_bytes;
-  int          m_width;
-  int          m_height;
+  std::shared_ptr<TextureArray> m_array;
+  int                           m_layer;
+  Handle<Texture>               m_handle;
+  std::string                   m_path;
+  int                           m_width;
+  int                           m_height;
+  int                           m_levels;
+
+  // Finest level uploaded so far. Set by the loader on the render thread,
+  // read when frames are recorded on the update one
+  std::atomic<int> m_baseLevel;
 
 public:
-  // Init variables and load img to OpenGL context
+  // Init variables, storage is got on allocate
   Texture(const std::string& path);
 
   // Get a shared ptr to the texture from the global pool
   static std::shared_ptr<Texture> getByPath(const std::string& path);
 
-  // Create a new texture if it isn't on the gloabl pool
+  // Get a texture from the global pool by handle (per-frame safe)
+  static const std::shared_ptr<Texture>& get(Handle<Texture> handle);
+
+  // Create a new texture if it isn't on the gloabl pool. Returns at once,
+  // the image is loaded on the background
   static std::shared_ptr<Texture> create(const std::string& path);
 
-  // Just remove texture from OpenGL context
+  // Give back its layer
   ~Texture();
 
-  // Active this texture binding it to its OpenGL slot
-  unsigned int bind() const;
+  // Bind its array to the texture unit
+  void bind() const;
 
-  // Disable this texture unbinding from its OpenGL slot
+  // Unbind its array from the texture unit
   void unbind() const;
 
 
+  // A layer on an array of its size and mip levels. Once, by the loader
+  void allocate(int width, int height, int levels);
+
+  // Upload rows of a mip level from the bound pixel unpack buffer
+  void upload(int level, int y, int rows, size_t offset);
+
+  // Mark a level as uploaded. Levels come coarse to fine
+  void levelDone(int level);
+
+  // Is every level uploaded?
+  bool ready() const;
+
+
+  // Array holding it, null until ready
+  const TextureArray* array() const;
+
+  // Layer on its array, -1 until ready
+  int layer() const;
+
+
+  // Getter for handle
+  Handle<Texture> handle() const;
+
   // Getter for path
   std::string path() const;
 
@@ -0,0 +1,195 @@
+#include "gltools_TextureArray.hpp"
+
+#include <algorithm>
+
+#include "cpptools_Logger.hpp"
+#include "gltools_GLState.hpp"
+#include "helpers/GLAssert.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Every array, by creation order. Its position is its index
+// ====================================================================== //
+
+std::vector<std::shared_ptr<TextureArray>> TextureArray::m_arrays{};
+
+// ====================================================================== //
+// ====================================================================== //
+// Max layers of an array on this context (256 at least)
+// ====================================================================== //
+
+static int maxLayers() {
+  static const int layers = []() {
+    GLint n = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &n);
+    return std::max(n, 1);
+  }();
+  return layers;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// (Re)create storage for capacity layers, copying used ones. The copy
+// reads each old layer and level through a framebuffer (OpenGL 3.0 on),
+// all on the GPU
+// ====================================================================== //
+
+void TextureArray::grow(int capacity) {
+  unsigned int old = m_glID;
+
+  GL_ASSERT(glGenTextures(1, &m_glID));
+  GLState::bindTexture(GL_TEXTURE_2D_ARRAY, m_glID);
+  GL_ASSERT(glTexStorage3D(
+      GL_TEXTURE_2D_ARRAY, m_levels, GL_RGBA8, m_width, m_height, capacity));
+  GL_ASSERT(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT));
+  GL_ASSERT(glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT));
+  GL_ASSERT(glTexParameteri(
+      GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+  GL_ASSERT(glTexParameteri(
+      GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
+  m_capacity = capacity;
+
+  if (old && m_used > 0) {
+    static unsigned int copyFBO = 0u;
+    if (!copyFBO) { GL_ASSERT(glGenFramebuffers(1, &copyFBO)); }
+
+    GLint previous = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+    GL_ASSERT(glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFBO));
+    for (auto level = 0; level < m_levels; ++level) {
+      auto w = std::max(m_width >> level, 1);
+      auto h = std::max(m_height >> level, 1);
+      for (auto layer = 0; layer < m_used; ++layer) {
+        GL_ASSERT(glFramebufferTextureLayer(
+            GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, old, level, layer));
+        GL_ASSERT(glCopyTexSubImage3D(
+            GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, 0, 0, w, h));
+      }
+    }
+    GL_ASSERT(glBindFramebuffer(GL_READ_FRAMEBUFFER, previous));
+  }
+
+  if (old) {
+    GL_ASSERT(glDeleteTextures(1, &old));
+    GLState::textureDeleted(old);
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Param constructor. Storage for a first layer
+// ====================================================================== //
+
+TextureArray::TextureArray(unsigned int index, int width, int height, int levels)
+    : m_glID(0u),
+      m_index(index),
+      m_width(width),
+      m_height(height),
+      m_levels(levels),
+      m_capacity(0),
+      m_used(0) {
+  this->grow(1);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Destructor
+// ====================================================================== //
+
+TextureArray::~TextureArray() {
+  GL_ASSERT(glDeleteTextures(1, &m_glID));
+  GLState::textureDeleted(m_glID);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Get a free layer on an array of that size, created if needed. Released
+// layers first, then unused ones, then the array doubles
+// ====================================================================== //
+
+TextureArray::slot TextureArray::acquire(int width, int height, int levels) {
+  for (auto& a : m_arrays) {
+    if (a->m_width != width || a->m_height != height ||
+        a->m_levels != levels) {
+      continue;
+    }
+    if (!a->m_free.empty()) {
+      auto layer = a->m_free.back();
+      a->m_free.pop_back();
+      return {a, layer};
+    }
+    if (a->m_used == a->m_capacity && a->m_capacity < maxLayers()) {
+      a->grow(std::min(a->m_capacity * 2, maxLayers()));
+    }
+    if (a->m_used < a->m_capacity) return {a, a->m_used++};
+  }
+
+  auto index = static_cast<unsigned int>(m_arrays.size());
+  m_arrays.push_back(
+      std::make_shared<TextureArray>(index, width, height, levels));
+  auto& a = m_arrays.back();
+  return {a, a->m_used++};
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Give back a layer got from acquire
+// ====================================================================== //
+
+void TextureArray::release(int layer) {
+  if (layer >= 0 && layer < m_used) m_free.push_back(layer);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Upload rows of a mip level of a layer from the bound pixel unpack
+// buffer
+// ====================================================================== //
+
+void TextureArray::upload(int layer, int level, int y, int rows, size_t offset) {
+  auto width = std::max(m_width >> level, 1);
+  GLState::bindTexture(GL_TEXTURE_2D_ARRAY, m_glID);
+  GL_ASSERT(glTexSubImage3D(GL_TEXTURE_2D_ARRAY,
+                            level,
+                            0,
+                            y,
+                            layer,
+                            width,
+                            rows,
+                            1,
+                            GL_RGBA,
+                            GL_UNSIGNED_BYTE,
+                            reinterpret_cast<const void*>(offset)));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Bind to / unbind from a texture unit
+// ====================================================================== //
+
+void TextureArray::bind(unsigned int unit) const {
+  GLState::bindTexture(unit, GL_TEXTURE_2D_ARRAY, m_glID);
+}
+
+void TextureArray::unbind(unsigned int unit) const {
+  GLState::bindTexture(unit, GL_TEXTURE_2D_ARRAY, 0u);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Getters
+// ====================================================================== //
+
+unsigned int TextureArray::index() const { return m_index; }
+int          TextureArray::capacity() const { return m_capacity; }
+
+// ====================================================================== //
+// ====================================================================== //
+// Number of arrays created
+// ====================================================================== //
+
+size_t TextureArray::count() { return m_arrays.size(); }
+
+} // namespace imog
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+namespace imog {
+
+// Textures of the same size (and so the same mip levels) packed as layers
+// of one GL_TEXTURE_2D_ARRAY. Draws of renderables with any of them share
+// a single bind, and pick theirs by layer index. Arrays start with one
+// layer and double when full, copying what they had on the GPU.
+class TextureArray {
+
+public:
+  // A layer of an array. Shared, so textures outlive the list of arrays
+  // whatever the order of static destruction
+  struct slot {
+    std::shared_ptr<TextureArray> array;
+    int                           layer{-1};
+  };
+
+private:
+  // Every array, by creation order. Its position is its index
+  static std::vector<std::shared_ptr<TextureArray>> m_arrays;
+
+  unsigned int     m_glID;
+  unsigned int     m_index;
+  int              m_width;
+  int              m_height;
+  int              m_levels;
+  int              m_capacity; // Layers allocated
+  int              m_used;     // Layers given at some point
+  std::vector<int> m_free;     // Released layers, given first
+
+  // (Re)create storage for capacity layers, copying used ones
+  void grow(int capacity);
+
+public:
+  TextureArray(unsigned int index, int width, int height, int levels);
+  ~TextureArray();
+
+  TextureArray(const TextureArray&) = delete;
+  TextureArray& operator=(const TextureArray&) = delete;
+
+  // Get a free layer on an array of that size, created if needed
+  static slot acquire(int width, int height, int levels);
+
+  // Give back a layer got from acquire
+  void release(int layer);
+
+  // Upload rows of a mip level of a layer from the bound pixel unpack
+  // buffer
+  void upload(int layer, int level, int y, int rows, size_t offset);
+
+  // Bind to / unbind from a texture unit
+  void bind(unsigned int unit) const;
+  void unbind(unsigned int unit) const;
+
+  // Getters
+  unsigned int index() const;
+  int          capacity() const;
+
+  // Number of arrays created
+  static size_t count();
+};
+
+} // namespace imog
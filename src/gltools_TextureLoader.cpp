@@ -0,0 +1,244 @@
+#include "gltools_TextureLoader.hpp"
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include "Settings.hpp"
+#include "cpptools_Image.hpp"
+#include "cpptools_Timer.hpp"
+#include "cpptools_Logger.hpp"
+#include "cpptools_ThreadPool.hpp"
+#include "gltools_GpuBuffer.hpp"
+#include "helpers/GLAssert.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// A texture on its way: decoded by a worker, then uploaded level by level
+// (coarse to fine) and band of rows by band of rows on the render thread
+// ====================================================================== //
+
+struct loadJob {
+  Handle<Texture> texture;
+  std::string     path;
+  TimePoint       requested;
+  double          decodeMs{0.0};
+  bool            ok{false};
+  Image::chain    image;
+  bool            allocated{false};
+  int             level{-1}; // Next level to upload, -1 when done
+  int             row{0};    // Next row on it
+};
+
+// Workers -> render thread
+static std::mutex           g_decodedMutex;
+static std::vector<loadJob> g_decoded;
+
+// Render thread only
+static std::deque<loadJob>         g_uploading;
+static unsigned int                g_pending{0u};
+static TextureLoader::metrics      g_metrics{};
+static std::unique_ptr<StreamRing> g_staging;
+
+// Declared last, so it's destroyed (and joined) first
+static std::unique_ptr<ThreadPool> g_workers;
+
+// ====================================================================== //
+// ====================================================================== //
+// Queue a texture to be loaded from its path. Decode and mips on a worker
+// ====================================================================== //
+
+void TextureLoader::request(const std::shared_ptr<Texture>& texture) {
+  if (!texture) return;
+  if (!g_workers) {
+    auto threads = std::max(Settings::loaderThreads, 0);
+    g_workers    = std::make_unique<ThreadPool>(threads);
+  }
+  ++g_metrics.requested;
+  ++g_pending;
+
+  loadJob job;
+  job.texture   = texture->handle();
+  job.path      = texture->path();
+  job.requested = StdClock::now();
+
+  g_workers->submit([job]() mutable {
+    TimePoint start = StdClock::now();
+
+    int  width = 0, height = 0;
+    auto rgba = Image::read(job.path, width, height, true);
+    job.ok    = !rgba.empty();
+    if (job.ok) {
+      job.image = Image::mipChain(rgba, width, height);
+      job.level = job.image.levels.size() - 1;
+    }
+    job.decodeMs = Seconds(StdClock::now() - start).count() * 1000.0;
+
+    std::lock_guard<std::mutex> lock(g_decodedMutex);
+    g_decoded.push_back(std::move(job));
+  });
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Upload what is decoded within the frame budget. Bands of rows are copied
+// to the staging ring first, then uploaded once it's flushed
+// ====================================================================== //
+
+void TextureLoader::update() {
+  {
+    std::lock_guard<std::mutex> lock(g_decodedMutex);
+    for (auto& job : g_decoded) {
+      if (job.ok) {
+        ++g_metrics.decoded;
+        g_metrics.decodeMs += job.decodeMs;
+      } else {
+        ++g_metrics.failed;
+        if (!Settings::quiet) LOGE("Failed loading texture \"{}\"", job.path);
+      }
+      g_uploading.push_back(std::move(job));
+    }
+    g_decoded.clear();
+  }
+
+  g_metrics.bytesLastFrame = 0u;
+  if (g_uploading.empty()) return;
+
+  // Staging partition fits the budget and a row of the widest texture
+  // waiting. Wider ones coming later make it grow, see endFrame below
+  size_t budget = std::max(Settings::textureUploadKB, 1) * 1024u;
+  if (!g_staging) {
+    size_t widest = 0u;
+    for (const auto& job : g_uploading) {
+      if (job.ok) widest = std::max<size_t>(widest, job.image.levels[0].width);
+    }
+    g_staging = std::make_unique<StreamRing>(std::max(budget, widest * 4u) +
+                                             256u);
+  }
+
+  struct band {
+    Texture* texture;
+    int      level;
+    int      y;
+    int      rows;
+    size_t   offset;
+    bool     last; // Of its level
+  };
+  std::vector<band> bands;
+
+  size_t spent = 0u;
+  auto   full  = false;
+  for (auto& job : g_uploading) {
+    const auto& texture = Texture::get(job.texture);
+    if (!texture || !job.ok) {
+      job.level = -1; // Failed, or destroyed while loading
+      continue;
+    }
+    if (!job.allocated) {
+      const auto& base = job.image.levels[0];
+      texture->allocate(base.width, base.height, job.image.levels.size());
+      job.allocated = true;
+    }
+
+    while (job.level >= 0 && !full) {
+      const auto& l        = job.image.levels[job.level];
+      size_t      rowBytes = static_cast<size_t>(l.width) * 4u;
+      size_t      left     = (spent < budget) ? budget - spent : 0u;
+
+      // At least one row per frame, even if it doesn't fit the budget
+      auto rows = std::min<size_t>(l.height - job.row, left / rowBytes);
+      if (rows == 0u && spent > 0u) {
+        full = true;
+        break;
+      }
+      rows       = std::max<size_t>(rows, 1u);
+      auto bytes = rows * rowBytes;
+      auto span  = g_staging->alloc(bytes);
+      if (!span.data) {
+        full = true;
+        break;
+      }
+
+      auto src = job.image.pixels.data() + l.offset + job.row * rowBytes;
+      std::memcpy(span.data, src, bytes);
+      bands.push_back(
+          {texture.get(), job.level, job.row, (int)rows, span.offset, false});
+      spent += bytes;
+
+      job.row += rows;
+      if (job.row == l.height) {
+        bands.back().last = true;
+        --job.level;
+        job.row = 0;
+      }
+    }
+    if (full) break;
+  }
+
+  if (!bands.empty()) {
+    g_staging->flush();
+    GL_ASSERT(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, g_staging->buffer()));
+    for (const auto& b : bands) {
+      b.texture->upload(b.level, b.y, b.rows, b.offset);
+      if (b.last) b.texture->levelDone(b.level);
+    }
+    GL_ASSERT(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+  }
+  // Even with nothing staged: a row that didn't fit asked the ring to grow,
+  // which only happens when the next frame partition is opened
+  g_staging->endFrame();
+  g_metrics.bytesLastFrame = spent;
+  g_metrics.bytesUploaded += spent;
+
+  // Retire finished jobs
+  TimePoint now = StdClock::now();
+  for (auto it = g_uploading.begin(); it != g_uploading.end();) {
+    if (it->level >= 0) {
+      ++it;
+      continue;
+    }
+    if (it->ok && it->allocated) {
+      auto ms = Seconds(now - it->requested).count() * 1000.0;
+      ++g_metrics.uploaded;
+      g_metrics.meanLatencyMs +=
+          (ms - g_metrics.meanLatencyMs) / g_metrics.uploaded;
+      g_metrics.maxLatencyMs = std::max(g_metrics.maxLatencyMs, ms);
+    }
+    --g_pending;
+    it = g_uploading.erase(it);
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Wait until every requested texture is decoded and uploaded. Still by
+// frame budget steps, so staging memory doesn't grow
+// ====================================================================== //
+
+void TextureLoader::finish() {
+  if (g_workers) g_workers->wait();
+  while (g_pending > 0u) update();
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Done textures (uploaded or failed) over requested ones, 1 if idle
+// ====================================================================== //
+
+float TextureLoader::progress() {
+  if (g_metrics.requested == 0u) return 1.f;
+  return 1.f - static_cast<float>(g_pending) / g_metrics.requested;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Loading progress and latency
+// ====================================================================== //
+
+TextureLoader::metrics TextureLoader::stats() { return g_metrics; }
+
+} // namespace imog
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+
+#include "gltools_Texture.hpp"
+
+namespace imog {
+
+// Background texture loading. Worker threads decode the image and build
+// its mip chain on the CPU, the render thread uploads it through a
+// streaming pixel buffer, coarse levels first, with at most
+// Settings::textureUploadKB bytes per frame. Big levels go in bands of
+// rows, so one texture never stalls a frame.
+class TextureLoader {
+
+public:
+  // Loading progress and latency (ms, request to last level uploaded)
+  struct metrics {
+    unsigned int requested{0u};
+    unsigned int decoded{0u};
+    unsigned int failed{0u};
+    unsigned int uploaded{0u};
+    size_t       bytesUploaded{0u};
+    size_t       bytesLastFrame{0u};
+    double       decodeMs{0.0}; // Decode and mips, summed over workers
+    double       meanLatencyMs{0.0};
+    double       maxLatencyMs{0.0};
+  };
+
+  // Queue a texture to be loaded from its path
+  static void request(const std::shared_ptr<Texture>& texture);
+
+  // Upload what is decoded within the frame budget. Render thread, once
+  // per frame
+  static void update();
+
+  // Wait until every requested texture is decoded and uploaded
+  static void finish();
+
+  // Done textures (uploaded or failed) over requested ones, 1 if idle
+  static float progress();
+
+  // Loading progress and latency
+  static metrics stats();
+};
+
+} // namespace imog
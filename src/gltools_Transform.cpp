@@ -24,7 +24,7 @@ glm::vec3 Transform::right() const {
   return glm::normalize(glm::cross(this->front(), Math::unitVecY));
 }
 glm::vec3 Transform::front() const {
-  return glm::normalize(this->asMatrix()[2]);
+  return glm::normalize(glm::vec3(this->asMatrix()[2]));
 }
 
 // ====================================================================== //
@@ -34,7 +34,7 @@ glm::vec3 Transform::front() const {
 // ====================================================================== //
 
 glm::mat4 Transform::asMatrix() const {
-  if (overrideMatrix != glm::mat4(0.f)) { return overrideMatrix; }
+  if (useOverride) { return overrideMatrix; }
 
   glm::mat4 aux(1.f);
   Math::translate(aux, pos);
@@ -46,4 +46,16 @@ glm::mat4 Transform::asMatrix() const {
   return aux;
 }
 
+// ====================================================================== //
+// ====================================================================== //
+// Same matrix would be generated by both transforms
+// ====================================================================== //
+
+bool Transform::sameAs(const Transform& other) const {
+  if (useOverride != other.useOverride) return false;
+  if (useOverride) return overrideMatrix == other.overrideMatrix;
+  return pos == other.pos && scl == other.scl && rot == other.rot &&
+         rotAngle == other.rotAngle && rotAxis == other.rotAxis;
+}
+
 } // namespace imog
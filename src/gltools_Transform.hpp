@@ -14,9 +14,10 @@ struct Transform {
   float     rotAngle; // arround rotAxis
   glm::vec3 rotAxis;  // if is defined ignore 'rot'
 
-  // If its defined, ignore other values of transform
+  // If useOverride is set, ignore other values of transform
   // and use this as matrix when transform is requested as matrix
-  glm::mat4 overrideMatrix{0.f}; //! MUST be initialize to {0.f}
+  glm::mat4 overrideMatrix{1.f};
+  bool      useOverride{false};
 
   // Get transform direction vectors
   glm::vec3 up() const;
@@ -24,12 +25,11 @@ struct Transform {
   glm::vec3 front() const;
 
   // Generate matrix with transform values or return override matrix
-  // if is defined
+  // if is defined. Pure read, no cache
   glm::mat4 asMatrix() const;
 
-
-
-  // -----------------------
+  // Same matrix would be generated by both transforms
+  bool sameAs(const Transform& other) const;
 };
 
 } // namespace imog
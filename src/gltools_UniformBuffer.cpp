@@ -0,0 +1,92 @@
+#include "gltools_UniformBuffer.hpp"
+
+#include <algorithm>
+
+#include "helpers/GLAssert.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// UniformBuffer
+// ====================================================================== //
+
+UniformBuffer::UniformBuffer(unsigned int binding, size_t size)
+    : m_binding(binding), m_ubo(0u), m_size(size) {}
+
+void UniformBuffer::update(const void* data) {
+  if (!m_ubo) {
+    GL_ASSERT(glGenBuffers(1, &m_ubo));
+    GL_ASSERT(glBindBuffer(GL_UNIFORM_BUFFER, m_ubo));
+    GL_ASSERT(
+        glBufferData(GL_UNIFORM_BUFFER, m_size, nullptr, GL_DYNAMIC_DRAW));
+    GL_ASSERT(glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_ubo));
+  }
+  GL_ASSERT(glBindBuffer(GL_UNIFORM_BUFFER, m_ubo));
+  GL_ASSERT(glBufferSubData(GL_UNIFORM_BUFFER, 0, m_size, data));
+  GL_ASSERT(glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_ubo));
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// UniformRing
+// ====================================================================== //
+
+UniformRing::UniformRing(unsigned int binding,
+                         size_t       blockSize,
+                         size_t       capacity)
+    : m_binding(binding),
+      m_ubo(0u),
+      m_blockSize(blockSize),
+      m_stride(0u),
+      m_capacity(capacity),
+      m_head(0u),
+      m_base(0u) {}
+
+size_t UniformRing::stride() const { return m_stride; }
+
+void* UniformRing::map(size_t count) {
+  if (count == 0u) return nullptr;
+
+  if (!m_ubo) {
+    int align = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+    m_stride = (m_blockSize + align - 1) / align * align;
+    GL_ASSERT(glGenBuffers(1, &m_ubo));
+    m_head = m_capacity; // Force the first allocation
+  }
+  GL_ASSERT(glBindBuffer(GL_UNIFORM_BUFFER, m_ubo));
+
+  // Wrap: orphan the storage (grown if needed), the GPU keeps the old one
+  if (m_head + count > m_capacity) {
+    m_capacity = std::max(m_capacity, count * 2u);
+    GL_ASSERT(glBufferData(
+        GL_UNIFORM_BUFFER, m_capacity * m_stride, nullptr, GL_STREAM_DRAW));
+    m_head = 0u;
+  }
+
+  m_base = m_head;
+  m_head += count;
+
+  // Untouched range since last orphan, no need to wait for the GPU
+  return glMapBufferRange(GL_UNIFORM_BUFFER,
+                          m_base * m_stride,
+                          count * m_stride,
+                          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+                              GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void UniformRing::unmap() {
+  GL_ASSERT(glBindBuffer(GL_UNIFORM_BUFFER, m_ubo));
+  GL_ASSERT(glUnmapBuffer(GL_UNIFORM_BUFFER));
+}
+
+void UniformRing::bind(size_t i) {
+  glBindBufferRange(GL_UNIFORM_BUFFER,
+                    m_binding,
+                    m_ubo,
+                    (m_base + i) * m_stride,
+                    m_blockSize);
+}
+
+} // namespace imog
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+
+namespace imog {
+
+// Uniform buffer bound to a fixed binding point. Content shared by every
+// program declaring the block. The GL buffer is created on first update.
+class UniformBuffer {
+
+private:
+  unsigned int m_binding;
+  unsigned int m_ubo;
+  size_t       m_size;
+
+public:
+  UniformBuffer(unsigned int binding, size_t size);
+
+  // Upload the whole block and bind it to its binding point
+  void update(const void* data);
+};
+
+// Stream of equally sized blocks for per-draw constants. Each frame writes
+// its blocks straight into mapped memory, then binds one block per draw.
+// Ranges are never rewritten while the GPU could read them: when the ring
+// wraps the storage is orphaned.
+class UniformRing {
+
+private:
+  unsigned int m_binding;
+  unsigned int m_ubo;
+  size_t       m_blockSize;
+  size_t       m_stride;   // Block size padded to the offset alignment
+  size_t       m_capacity; // In blocks
+  size_t       m_head;     // Next free block
+  size_t       m_base;     // First block of the last map
+
+public:
+  UniformRing(unsigned int binding, size_t blockSize, size_t capacity);
+
+  // Bytes between two consecutive blocks (write stride)
+  size_t stride() const;
+
+  // Map count blocks for writing, nullptr on failure. Call unmap after
+  void* map(size_t count);
+  void  unmap();
+
+  // Bind block i of the last map to the binding point
+  void bind(size_t i);
+};
+
+} // namespace imog
@@ -0,0 +1,274 @@
+#include "gltools_VertexPacking.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <glm/gtc/packing.hpp>
+
+#include "cpptools_Logger.hpp"
+
+namespace imog {
+
+// ====================================================================== //
+// ====================================================================== //
+// Sign, but 1 for 0. Keeps the octahedron folds closed on the axes
+// ====================================================================== //
+
+static glm::vec2 signNotZero(const glm::vec2& v) {
+  return {(v.x >= 0.f) ? 1.f : -1.f, (v.y >= 0.f) ? 1.f : -1.f};
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// 16-bit unorm position within [min, max]. Flat axes encode to 0
+// ====================================================================== //
+
+void VertexPacking::quantize(const glm::vec3& p,
+                             const glm::vec3& min,
+                             const glm::vec3& max,
+                             uint16_t*        out) {
+  for (auto i = 0; i < 3; ++i) {
+    auto extent = max[i] - min[i];
+    auto t      = (extent > 0.f) ? (p[i] - min[i]) / extent : 0.f;
+    out[i]      = glm::packUnorm1x16(t);
+  }
+}
+
+glm::vec3 VertexPacking::dequantize(const uint16_t*  q,
+                                    const glm::vec3& min,
+                                    const glm::vec3& max) {
+  // Same math than the vertex shaders: offset + unorm * scale
+  glm::vec3 t{glm::unpackUnorm1x16(q[0]),
+              glm::unpackUnorm1x16(q[1]),
+              glm::unpackUnorm1x16(q[2])};
+  return min + t * (max - min);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Octahedral unit vector as two 16-bit snorm. The sphere is projected on
+// the octahedron |x| + |y| + |z| = 1, and its lower half folded over the
+// upper one, so it unwraps to the [-1, 1] square. Null vectors encode +Z
+// ====================================================================== //
+
+void VertexPacking::octEncode(const glm::vec3& n, int16_t* out) {
+  auto      l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  glm::vec2 e{0.f};
+  if (l1 > 0.f) {
+    e = glm::vec2{n.x, n.y} / l1;
+    if (n.z < 0.f) {
+      e = (1.f - glm::abs(glm::vec2{e.y, e.x})) * signNotZero(e);
+    }
+  }
+  for (auto i = 0; i < 2; ++i) {
+    auto bits = glm::packSnorm1x16(e[i]);
+    std::memcpy(&out[i], &bits, sizeof(int16_t));
+  }
+}
+
+glm::vec3 VertexPacking::octDecode(const int16_t* e) {
+  uint16_t bits[2];
+  std::memcpy(bits, e, sizeof(bits));
+  glm::vec2 f{glm::unpackSnorm1x16(bits[0]), glm::unpackSnorm1x16(bits[1])};
+
+  glm::vec3 v{f.x, f.y, 1.f - std::abs(f.x) - std::abs(f.y)};
+  if (v.z < 0.f) {
+    auto xy = (1.f - glm::abs(glm::vec2{v.y, v.x})) * signNotZero(f);
+    v.x     = xy.x;
+    v.y     = xy.y;
+  }
+  return glm::normalize(v);
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Half float uv
+// ====================================================================== //
+
+void VertexPacking::halfEncode(const glm::vec2& uv, uint16_t* out) {
+  out[0] = glm::packHalf1x16(uv.x);
+  out[1] = glm::packHalf1x16(uv.y);
+}
+
+glm::vec2 VertexPacking::halfDecode(const uint16_t* h) {
+  return {glm::unpackHalf1x16(h[0]), glm::unpackHalf1x16(h[1])};
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Whole vertices
+// ====================================================================== //
+
+Renderable::packedVertex VertexPacking::pack(const Renderable::vertex& v,
+                                             const glm::vec3&          min,
+                                             const glm::vec3&          max) {
+  Renderable::packedVertex p{};
+  quantize(v.pos, min, max, p.pos);
+  octEncode(v.normal, p.normal);
+  halfEncode(v.uv, p.uv);
+  return p;
+}
+
+Renderable::vertex VertexPacking::unpack(const Renderable::packedVertex& p,
+                                         const glm::vec3&                min,
+                                         const glm::vec3&                max) {
+  Renderable::vertex v;
+  v.pos    = dequantize(p.pos, min, max);
+  v.normal = octDecode(p.normal);
+  v.uv     = halfDecode(p.uv);
+  return v;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Pack count vertices of a mesh with those bounds
+// ====================================================================== //
+
+std::vector<Renderable::packedVertex>
+    VertexPacking::pack(const Renderable::vertex* vertices,
+                        size_t                    count,
+                        const glm::vec3&          min,
+                        const glm::vec3&          max) {
+  std::vector<Renderable::packedVertex> out(count);
+  for (auto i = 0u; i < count; ++i) out[i] = pack(vertices[i], min, max);
+  return out;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Encode and decode every vertex, max error against the source. Null
+// normals (meshes without them) don't count
+// ====================================================================== //
+
+VertexPacking::error
+    VertexPacking::roundTrip(const Renderable::vertex* vertices,
+                             size_t                    count,
+                             const glm::vec3&          min,
+                             const glm::vec3&          max) {
+  error e;
+  for (auto i = 0u; i < count; ++i) {
+    const auto& src = vertices[i];
+    auto        dst = unpack(pack(src, min, max), min, max);
+
+    auto dPos  = glm::compMax(glm::abs(dst.pos - src.pos));
+    auto dUV   = glm::compMax(glm::abs(dst.uv - src.uv));
+    e.position = std::max(e.position, dPos);
+    e.uv       = std::max(e.uv, dUV);
+
+    // Angle from the chord, acos of a float can't resolve these
+    auto len = glm::length(src.normal);
+    if (len > 0.f) {
+      auto chord  = glm::length(glm::dvec3(src.normal / len - dst.normal));
+      auto angle  = glm::degrees(2.0 * std::asin(std::min(chord * 0.5, 1.0)));
+      e.normalDeg = std::max(e.normalDeg, static_cast<float>(angle));
+    }
+  }
+  return e;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Round trip the edge cases of every encoder, no assets needed. Bounds:
+// half a step of 16-bit unorm for positions, a few 16-bit snorm steps
+// for normals, half a half float ulp for uvs in [-1, 2], and exact for
+// uvs a half float can hold
+// ====================================================================== //
+
+bool VertexPacking::selfCheck() {
+  std::vector<Renderable::vertex> v;
+  auto add = [&](glm::vec3 p, glm::vec3 n, glm::vec2 uv) {
+    v.push_back({p, n, uv});
+  };
+
+  // Positions: corners, center and a flat axis (z)
+  glm::vec3 min{-3.f, -0.5f, 2.f}, max{7.f, 250.f, 2.f};
+  for (auto c = 0u; c < 8u; ++c) {
+    glm::vec3 p{(c & 1u) ? max.x : min.x,
+                (c & 2u) ? max.y : min.y,
+                (c & 4u) ? max.z : min.z};
+    add(p, glm::vec3{0.f}, glm::vec2{0.f});
+  }
+  for (auto i = 0u; i <= 1000u; ++i) {
+    add(glm::mix(min, max, i / 1000.f), glm::vec3{0.f}, glm::vec2{0.f});
+  }
+  auto posBound = glm::compMax(max - min) * 0.5f / 65535.f * 1.01f;
+  auto pos      = roundTrip(v.data(), v.size(), min, max);
+  v.clear();
+
+  // Normals: poles (+Z center of the square, -Z its corners), axes, edge
+  // and corner diagonals, both sides of the fold around the equator and a
+  // Fibonacci sphere for the rest
+  for (auto x = -1; x <= 1; ++x) {
+    for (auto y = -1; y <= 1; ++y) {
+      for (auto z = -1; z <= 1; ++z) {
+        if (x || y || z) add(glm::vec3{0.f}, glm::vec3(x, y, z), {0.f, 0.f});
+      }
+    }
+  }
+  for (auto i = 0u; i < 3600u; ++i) {
+    auto a = glm::radians(i * 0.1f);
+    for (auto z : {-1e-4f, -1e-7f, 0.f, 1e-7f, 1e-4f}) {
+      add(glm::vec3{0.f}, {std::cos(a), std::sin(a), z}, {0.f, 0.f});
+    }
+  }
+  for (auto i = 0u; i < 3600u; ++i) {
+    auto a = glm::radians(i * 0.1f);
+    for (auto z : {-1.f, 1.f}) {
+      add(glm::vec3{0.f}, {1e-4f * std::cos(a), 1e-4f * std::sin(a), z},
+          {0.f, 0.f});
+    }
+  }
+  const auto golden = glm::pi<float>() * (3.f - std::sqrt(5.f));
+  for (auto i = 0u; i < 100000u; ++i) {
+    auto z = 1.f - 2.f * (i + 0.5f) / 100000.f;
+    auto r = std::sqrt(1.f - z * z);
+    add(glm::vec3{0.f},
+        {r * std::cos(i * golden), r * std::sin(i * golden), z},
+        {0.f, 0.f});
+  }
+  auto normalBound = 0.01f;
+  auto normal      = roundTrip(v.data(), v.size(), min, max);
+  v.clear();
+
+  // Uvs: common range, and values a half float holds exactly, limits
+  // (max finite, smallest normal and subnormal) included
+  for (auto i = 0u; i <= 3000u; ++i) {
+    auto t = -1.f + i / 1000.f;
+    add(glm::vec3{0.f}, glm::vec3{0.f}, {t, 1.f - t});
+  }
+  auto uvBound = std::ldexp(1.f, -11);
+  auto uv      = roundTrip(v.data(), v.size(), min, max);
+  v.clear();
+
+  for (auto t : {0.f,
+                 -0.f,
+                 1.f,
+                 0.5f,
+                 2048.f,
+                 65504.f,
+                 -65504.f,
+                 std::ldexp(1.f, -14),
+                 std::ldexp(1.f, -24),
+                 -std::ldexp(1.f, -24)}) {
+    add(glm::vec3{0.f}, glm::vec3{0.f}, {t, -t});
+  }
+  auto exact = roundTrip(v.data(), v.size(), min, max);
+
+  auto ok = pos.position <= posBound && normal.normalDeg <= normalBound &&
+            uv.uv <= uvBound && exact.uv == 0.f;
+  LOGD("Vertex packing round trip, max error (bound): position {:.3g} "
+       "({:.3g}), normal {:.3g} deg ({:.3g}), uv {:.3g} ({:.3g}), "
+       "exact uv {:.3g} (0): {}",
+       pos.position,
+       posBound,
+       normal.normalDeg,
+       normalBound,
+       uv.uv,
+       uvBound,
+       exact.uv,
+       (ok) ? "ok" : "FAILED");
+  return ok;
+}
+
+} // namespace imog
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include "gltools_Renderable.hpp"
+
+namespace imog {
+
+// Encoders for Renderable::packedVertex, and their CPU decoders. Positions
+// are 16-bit unorm within the mesh bounds, normals octahedral 16-bit
+// snorm and uvs half floats: 16 bytes a vertex instead of 32. Vertex
+// shaders decode them, see the Draw block posOffset / posScale.
+class VertexPacking {
+
+public:
+  // Max error of a round trip (encode, then decode) over a mesh
+  struct error {
+    float position{0.f}; // Object space units
+    float normalDeg{0.f};
+    float uv{0.f};
+  };
+
+  // 16-bit unorm position within [min, max]. Flat axes encode to 0
+  static void      quantize(const glm::vec3& p,
+                            const glm::vec3& min,
+                            const glm::vec3& max,
+                            uint16_t*        out);
+  static glm::vec3 dequantize(const uint16_t*  q,
+                              const glm::vec3& min,
+                              const glm::vec3& max);
+
+  // Octahedral unit vector as two 16-bit snorm. Null vectors encode +Z
+  static void      octEncode(const glm::vec3& n, int16_t* out);
+  static glm::vec3 octDecode(const int16_t* e);
+
+  // Half float uv
+  static void      halfEncode(const glm::vec2& uv, uint16_t* out);
+  static glm::vec2 halfDecode(const uint16_t* h);
+
+  // Whole vertices
+  static Renderable::packedVertex pack(const Renderable::vertex& v,
+                                       const glm::vec3&          min,
+                                       const glm::vec3&          max);
+  static Renderable::vertex       unpack(const Renderable::packedVertex& p,
+                                         const glm::vec3&                min,
+                                         const glm::vec3&                max);
+
+  // Pack count vertices of a mesh with those bounds
+  static std::vector<Renderable::packedVertex>
+      pack(const Renderable::vertex* vertices,
+           size_t                    count,
+           const glm::vec3&          min,
+           const glm::vec3&          max);
+
+  // Encode and decode every vertex, max error against the source
+  static error roundTrip(const Renderable::vertex* vertices,
+                         size_t                    count,
+                         const glm::vec3&          min,
+                         const glm::vec3&          max);
+
+  // Round trip the edge cases of every encoder, no assets needed: bound
+  // corners and flat axes, octahedral poles and seams, half float uv
+  // limits. Logs the max errors, false if one is over its bound
+  static bool selfCheck();
+};
+
+} // namespace imog
@@ -1,11 +1,18 @@
 
 #include <glad/glad.h>
 #include "../cpptools_Logger.hpp"
+#include "../gltools_GLState.hpp"
 
-#define GL_ASSERT(funcToCheck) \
-  glErrClear();                \
-  funcToCheck;                 \
-  glAssert(__FILE__, __LINE__);
+// Release builds don't check. Debug ones get errors from the KHR_debug
+// callback, or poll glGetError around each call if the context lacks it
+#ifdef DEBUG
+#define GL_ASSERT(funcToCheck)                                        \
+  if (!imog::GLState::debugOutputOn()) glErrClear();                  \
+  funcToCheck;                                                        \
+  if (!imog::GLState::debugOutputOn()) glAssert(__FILE__, __LINE__);
+#else
+#define GL_ASSERT(funcToCheck) funcToCheck;
+#endif
 
 
 /// GL_ERRORS :: Avoid fake error
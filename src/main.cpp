@@ -4,6 +4,8 @@
 #include "Settings.hpp"
 #include "mgtools_Skeleton.hpp"
 #include "gltools_Renderable.hpp"
+#include "gltools_Skinning.hpp"
+#include "gltools_VertexPacking.hpp"
 #include "helpers/Consts.hpp"
 #include "helpers/Colors.hpp"
 #include "helpers/Debug.hpp"
@@ -15,6 +17,16 @@ int main(int argc, char const* argv[]) {
   // --- Initialization --------------------------------------
 
   Settings::init(Paths::settings);
+
+  // CPU skinning throughput of this machine, no window needed
+  if (Settings::skinBenchmark) {
+    Skinning::benchmark();
+    return 0;
+  }
+
+  // Vertex packing accuracy on its edge cases, no window needed
+  if (Settings::packingCheck) { return VertexPacking::selfCheck() ? 0 : 1; }
+
   auto camera = std::make_shared<Camera>(Settings::mainCameraSpeed,
                                          Settings::mainCameraFov);
   IO::windowInit(camera);
@@ -34,7 +46,6 @@ int main(int argc, char const* argv[]) {
   auto jump = Motion::create("jump", Motions::jump, loopMode::shortLoop, 10u);
 
   // Motions for static state
-  std::string staticMoName = "tPose";
   auto tPose    = Motion::create("tPose", Motions::tPose, loopMode::none, 0u);
   auto dance    = Motion::create("dance", Motions::dance, loopMode::loop, 10u);
   auto backflip = Motion::create(
@@ -47,26 +58,41 @@ int main(int argc, char const* argv[]) {
   dance->joints    = tPose->joints;
   backflip->joints = tPose->joints;
 
-  sk.onKey(GLFW_KEY_1, [&]() { staticMoName = "tPose"; });
-  sk.onKey(GLFW_KEY_2, [&]() { staticMoName = "dance"; });
-  sk.onKey(GLFW_KEY_3, [&]() { staticMoName = "backflip"; });
-  sk.onKey(GLFW_KEY_4, [&]() { staticMoName = "jump"; });
-  sk.onKey(GLFW_KEY_5, [&]() { staticMoName = "walk"; });
-  sk.onKey(GLFW_KEY_6, [&]() { staticMoName = "run"; });
-
   // Motion addition
-  sk.addMotion(walk);
-  sk.addMotion(run);
-  sk.addMotion(jump);
-  sk.addMotion(tPose);
-  sk.addMotion(dance);
-  sk.addMotion(backflip);
+  auto walkID     = sk.addMotion(walk);
+  auto runID      = sk.addMotion(run);
+  auto jumpID     = sk.addMotion(jump);
+  auto tPoseID    = sk.addMotion(tPose);
+  auto danceID    = sk.addMotion(dance);
+  auto backflipID = sk.addMotion(backflip);
+
+  // Input state, only used on the animation thread. Key callbacks queue
+  // its changes as skeleton commands, applied in order before each tick
+  enum input : uint { staticMo, jumpKey, frontKey, rightKey, backKey, leftKey };
+  uint inputs[6] = {tPoseID, 0u, 0u, 0u, 0u, 0u};
+  sk.inputFn     = [&](uint in, uint value) { inputs[in] = value; };
+
+  // Motion for static state
+  auto staticMotion = [&](uint id) {
+    return [&sk, id]() { sk.queueInput(staticMo, id); };
+  };
+  sk.onKey(GLFW_KEY_1, staticMotion(tPoseID));
+  sk.onKey(GLFW_KEY_2, staticMotion(danceID));
+  sk.onKey(GLFW_KEY_3, staticMotion(backflipID));
+  sk.onKey(GLFW_KEY_4, staticMotion(jumpID));
+  sk.onKey(GLFW_KEY_5, staticMotion(walkID));
+  sk.onKey(GLFW_KEY_6, staticMotion(runID));
 
   // Input setup
   float rotSpeed    = 5.f;
   bool  changeSpeed = true;
-  bool  _jump, mustToggleCamera, front, right, back, left;
-  _jump = mustToggleCamera = front = right = back = left = false;
+
+  auto& staticMoID = inputs[staticMo];
+  auto& _jump      = inputs[jumpKey];
+  auto& front      = inputs[frontKey];
+  auto& right      = inputs[rightKey];
+  auto& back       = inputs[backKey];
+  auto& left       = inputs[leftKey];
 
   auto isMoving = [&]() { return front || right || back || left; };
 
@@ -86,13 +112,13 @@ int main(int argc, char const* argv[]) {
         sk.speed *= 0.5f;
         changeSpeed = false;
       }
-      sk.setMotion("jump");
+      sk.setMotion(jumpID);
     } else {
       if (!changeSpeed) {
         sk.speed *= 2.0f;
         changeSpeed = true;
       }
-      isMoving() ? sk.setMotion("walk") : sk.setMotion(staticMoName);
+      isMoving() ? sk.setMotion(walkID) : sk.setMotion(staticMoID);
     }
 
     if (front) sk.transform.rot += angle(0.f) * rotSpeed;
@@ -103,7 +129,7 @@ int main(int argc, char const* argv[]) {
     if (isMoving() || _jump) {
       sk.transform.pos += step();
 
-      if (sk.camera->target) {
+      if (sk.camera->following()) {
         auto afs = abs(Settings::floorSize) * 0.95f;
 
         if (bool teleport = Settings::floorSize >= 500.f) {
@@ -118,16 +144,21 @@ int main(int argc, char const* argv[]) {
 
   // toggle play state
   sk.onKey(GLFW_KEY_0,
-           [&]() { sk.play = !sk.play; },
+           [&]() { sk.togglePlay(); },
            emptyFn,
-           [&]() { sk.play = !sk.play; });
+           [&]() { sk.togglePlay(); });
 
-  // sk interaction
-  sk.onKey(GLFW_KEY_SPACE, [&]() { _jump = true; }, [&]() { _jump = false; });
-  sk.onKey(GLFW_KEY_W, [&]() { front = true; }, [&]() { front = false; });
-  sk.onKey(GLFW_KEY_D, [&]() { right = true; }, [&]() { right = false; });
-  sk.onKey(GLFW_KEY_S, [&]() { back = true; }, [&]() { back = false; });
-  sk.onKey(GLFW_KEY_A, [&]() { left = true; }, [&]() { left = false; });
+  // sk interaction, held keys
+  auto holdKey = [&](int key, input in) {
+    sk.onKey(key,
+             [&sk, in]() { sk.queueInput(in, 1u); },
+             [&sk, in]() { sk.queueInput(in, 0u); });
+  };
+  holdKey(GLFW_KEY_SPACE, jumpKey);
+  holdKey(GLFW_KEY_W, frontKey);
+  holdKey(GLFW_KEY_D, rightKey);
+  holdKey(GLFW_KEY_S, backKey);
+  holdKey(GLFW_KEY_A, leftKey);
 
   // camera
   sk.onKey(GLFW_KEY_F, [&]() { sk.toggleCameraFollow(); });
@@ -146,8 +177,7 @@ int main(int argc, char const* argv[]) {
   sk.onKey(GLFW_KEY_L, incAlpha, emptyFn, incAlpha);
 
   // un/link run motion to walk motion
-  sk.onKey(GLFW_KEY_9,
-           [&]() { walk->linked = (!walk->linked) ? run : nullptr; });
+  sk.onKey(GLFW_KEY_9, [&]() { sk.toggleLink(walkID, runID); });
 
   // === ANIMATE ===
   sk.animate();
@@ -160,13 +190,15 @@ int main(int argc, char const* argv[]) {
   // ---------------------------------------------------------
   // --- Loop ------------------------------------------------
 
+  auto floorRE = Renderable::find("Floor");
+
   auto initFn = [&]() {
-    auto _floor             = Renderable::getByName("Floor");
-    _floor->transform.pos.y = sk.footHeight() - sk.transform.pos.y;
+    auto& _floor            = Renderable::get(floorRE);
+    _floor->transform.pos.y = sk.footHeight() - sk.position().y;
   };
 
   auto updateFn = [&]() {
-    auto _floor             = Renderable::getByName("Floor");
+    auto& _floor            = Renderable::get(floorRE);
     _floor->transform.scl.x = Settings::floorSize;
     _floor->transform.scl.z = Settings::floorSize;
   };
@@ -175,15 +207,16 @@ int main(int argc, char const* argv[]) {
     sk.draw();
 
     camera->frame();
-    Shader::poolUpdate(camera);
+    Skeleton::batchDraw(camera);
     Renderable::poolDraw(camera);
 
     static std::once_flag initFlag;
-    std::call_once(initFlag, initFn);
+    if (sk.posed()) std::call_once(initFlag, initFn);
   };
 
   // Init winow loop
-  IO::windowVisibility(true); //! Do not remove. Avoid white screen on loading.
+  //! Do not remove. Avoid white screen on loading. Headless runs stay hidden.
+  IO::windowVisibility(!Settings::headless);
   IO::windowLoop(renderFn, updateFn);
 
   // ---------------------------------------------- / Loop ---
@@ -226,7 +226,7 @@ std::shared_ptr<Motion> Motion::create(const std::string& name,
 // that conect both smoothly
 // ====================================================================== //
 
-Motion::mixMap Motion::mix(const std::shared_ptr<Motion>& m2) {
+Motion::transitions Motion::mix(const std::shared_ptr<Motion>& m2) {
 
   // @lambda for transitions creation
   auto createTransitionMotion = [&](uint idxF1, uint idxF2) {
@@ -251,7 +251,8 @@ Motion::mixMap Motion::mix(const std::shared_ptr<Motion>& m2) {
 
   //---
 
-  mixMap mm;
+  transitions mm;
+  mm.reserve(this->frames.size());
   {
 
     uint  auxF2   = 0;
@@ -275,9 +276,9 @@ Motion::mixMap Motion::mix(const std::shared_ptr<Motion>& m2) {
       // Write to ref frames. For mark winner frames on heatmap
       refFrames << f1 << " " << auxF2 << "\n";
 
-      // Insert winner frames and its transition on the map
+      // Insert winner frames and its transition at f1 position
       auto tMo = createTransitionMotion(f1, auxF2);
-      mm.insert({f1, {auxF2, tMo}});
+      mm.push_back({auxF2, tMo});
     }
   }
 
@@ -41,8 +41,13 @@ class Motion {
 public:
   static std::string plotFolder();
 
-  using mixMap =
-      std::unordered_map<uint, std::pair<int, std::shared_ptr<Motion>>>;
+  // Where to land on the destination motion and how to get there
+  struct transition {
+    uint                    frame;
+    std::shared_ptr<Motion> motion;
+  };
+  // One transition per frame of the source motion, indexed by frame
+  using transitions = std::vector<transition>;
 
   static std::shared_ptr<Motion> create(const std::string& name,
                                         const std::string& filepath,
@@ -67,7 +72,7 @@ public:
 
   // Mix any motion with other and get a new animation
   // that conect both smoothly
-  mixMap mix(const std::shared_ptr<Motion>& m2);
+  transitions mix(const std::shared_ptr<Motion>& m2);
 };
 
 } // namespace imog
@@ -3,10 +3,14 @@
 #include "gltools_IO.hpp"
 #include "cpptools_Strings.hpp"
 #include "cpptools_Async.hpp"
+#include "cpptools_Metrics.hpp"
 #include "cpptools_Logger.hpp"
 #include "gltools_Loader.hpp"
 #include "Settings.hpp"
 #include "gltools_Renderable.hpp"
+#include "gltools_DebugDraw.hpp"
+#include "gltools_FrameScheduler.hpp"
+#include "gltools_Replay.hpp"
 #include "helpers/Consts.hpp"
 
 namespace imog {
@@ -23,13 +27,29 @@ Skeleton::Skeleton(const std::shared_ptr<imog::Camera>& camera,
       m_animThread(true),
       m_currFrame(0u),
       m_nextFrame(0u),
+      m_boneRE(Renderable::find("Stick")),
+      m_headRE(Renderable::find("Monkey")),
+      m_rootState(),
+      m_rootNode(Renderable::scene.add(&m_rootState)),
+      m_headNode(Renderable::scene.add()),
+      m_headMesh(Renderable::scene.add(nullptr, m_headNode)),
       m_currMotion(nullptr),
       m_nextMotion(nullptr),
+      m_currID(noMotion),
+      m_nextID(noMotion),
       m_linkedAlpha(0.f),
+      m_skinRoot(nullptr),
+      m_skinBuilds(0u),
+      m_skinBuilt(0u),
       play(true),
       speed(speed),
       camera(camera),
-      linkedSteps(10u) {}
+      linkedSteps(10u) {
+
+  // Head mesh a bit over the end-site and bigger than the bones
+  auto headLocal = glm::translate(glm::mat4(1.f), glm::vec3{0.f, 1.f, 0.f});
+  Renderable::scene.setLocal(m_headMesh, glm::scale(headLocal, glm::vec3{3.f}));
+}
 
 // ====================================================================== //
 // ====================================================================== //
@@ -40,10 +60,21 @@ Skeleton::~Skeleton() {
   if (!Settings::quiet) LOGD("Skeleton destroyed!");
   this->play   = false;
   m_animThread = false;
+  if (camera->following()) camera->follow(nullptr, SceneGraph::none);
+  Renderable::scene.release(m_headMesh);
+  Renderable::scene.release(m_headNode);
+  Renderable::scene.release(m_rootNode);
 }
 
 // * --- Private --------------------------------------------------------- //
 
+// ====================================================================== //
+// ====================================================================== //
+// Bones and heads of every skeleton, drawn together by batchDraw
+// ====================================================================== //
+
+InstanceBatch Skeleton::m_batch{};
+
 // ====================================================================== //
 // ====================================================================== //
 // Counters
@@ -71,6 +102,41 @@ void Skeleton::frameCounter() {
   (limitReached) ? loadNextMotion() : (void)++m_currFrame;
 }
 
+// ====================================================================== //
+// ====================================================================== //
+// Apply queued commands. Only called from the animation thread
+// ====================================================================== //
+
+void Skeleton::applyCommands() {
+  using T = command::type;
+
+  m_commands.drain([&](const command& cmd) {
+    switch (cmd.kind) {
+      case T::speed:
+        speed = glm::clamp(speed + cmd.value, 0.1f, 2.f);
+        break;
+
+      case T::linkedAlpha:
+        m_linkedAlpha += cmd.value * alphaStep();
+        m_linkedAlpha = glm::clamp(m_linkedAlpha, 0.f, 1.f);
+        break;
+
+      case T::togglePlay: play = !play; break;
+
+      case T::toggleLink:
+        if (cmd.motion < m_motions.size() && cmd.other < m_motions.size()) {
+          auto& m   = m_motions[cmd.motion];
+          m->linked = (!m->linked) ? m_motions[cmd.other] : nullptr;
+        }
+        break;
+
+      case T::input:
+        if (inputFn) inputFn(cmd.motion, cmd.other);
+        break;
+    }
+  });
+}
+
 // ====================================================================== //
 // ====================================================================== //
 // Compute hierarchy of the skeleton based on current frame and motion
@@ -113,41 +179,235 @@ void Skeleton::hierarchy() {
 
 // ====================================================================== //
 // ====================================================================== //
-// Verify if motion exist on motion map
+// Copy the joints of this tick to a pose and publish it. Parent indices
+// are only rebuilt when the hierarchy of the slot changed
 // ====================================================================== //
 
-template <typename T>
-bool Skeleton::motionExistsOnMap(const std::unordered_map<std::string, T>& map,
-                                 const std::string& name) const {
-  if (map.count(name) < 1) {
-    if (!Settings::quiet) LOGE("Zero motions with name {}.", name);
-    return false;
+void Skeleton::publishPose() {
+  auto&       P      = m_poses.back();
+  const auto& joints = m_currMotion->joints;
+  auto        n      = joints.size();
+
+  if (!P.motion || P.parent.size() != n ||
+      P.motion->joints.front() != joints.front()) {
+    std::unordered_map<const Joint*, int32_t> index;
+    P.parent.resize(n);
+    for (auto i = 0u; i < n; ++i) {
+      const auto& J  = joints[i];
+      index[J.get()] = i;
+      P.parent[i]    = (J->parent) ? index.at(J->parent.get()) : -1;
+    }
   }
-  return true;
+
+  P.motion = m_currMotion;
+  P.matrix.resize(n);
+  P.endsite.resize(n);
+  for (auto i = 0u; i < n; ++i) {
+    const auto& J = joints[i];
+    P.matrix[i]   = J->matrix;
+    P.endsite[i]  = (J->endsite) ? J->endsite->matrix : J->matrix;
+  }
+  P.transform  = transform;
+  P.footHeight = joints.at(5)->matrix[3].y;
+  m_poses.publish();
 }
-// Check for motion in mix map
-bool Skeleton::mixMotionExists(const std::string& name) const {
-  return motionExistsOnMap(m_motionMap, name);
+
+// ====================================================================== //
+// ====================================================================== //
+// Model matrix of a bone mesh (unit height 2) laid between two points
+// ====================================================================== //
+
+glm::mat4 Skeleton::boneMatrix(const glm::vec3& P1,
+                               const glm::vec3& P2,
+                               float            thickness) {
+  glm::mat4 matrix(1.f);
+  Math::translate(matrix, (P1 + P2) * 0.5f);
+
+  auto dir  = glm::normalize(P1 - P2);
+  auto axis = glm::cross(Math::unitVecY, dir);
+  if (axis != glm::vec3(0.f)) {
+    Math::rotate(matrix, glm::angle(Math::unitVecY, dir), axis);
+  }
+
+  auto halfLength = glm::distance(P1, P2) * 0.5f;
+  Math::scale(matrix, glm::vec3{thickness, halfLength, thickness});
+  return matrix;
 }
-// Check for motion in regular map
-bool Skeleton::motionExists(const std::string& name) const {
-  return motionExistsOnMap(m_motions, name);
+
+// ====================================================================== //
+// ====================================================================== //
+// Capsule of radius around segment a-b, driven by joint driver. Near its
+// ends it blends half way with the joints driving the neighbour bones,
+// before (at a) and after (at b), -1 for none, so bends don't crack
+// ====================================================================== //
+
+static void capsule(Skinning::bindPose&        pose,
+                    std::vector<glm::vec2>&    uvs,
+                    std::vector<unsigned int>& indices,
+                    const glm::vec3&           a,
+                    const glm::vec3&           b,
+                    float                      radius,
+                    int32_t                    driver,
+                    int32_t                    before,
+                    int32_t                    after) {
+  constexpr auto sides = 12u;
+  constexpr auto caps  = 3u; // Rows per hemisphere, pole excluded
+  constexpr auto rows  = (caps + 1u) * 2u;
+  constexpr auto blend = 0.25f;
+
+  auto length = glm::distance(a, b);
+  auto axis   = (b - a) / length;
+  auto side   = glm::cross(axis, Math::unitVecY);
+  if (glm::length(side) < 1e-3f) side = glm::cross(axis, Math::unitVecX);
+  side    = glm::normalize(side);
+  auto up = glm::cross(side, axis);
+
+  auto first = static_cast<unsigned int>(pose.size());
+  for (auto row = 0u; row < rows; ++row) {
+    auto upper  = row > caps;
+    auto k      = upper ? row - caps - 1u : row;
+    auto lat    = (float)k / caps - (upper ? 0.f : 1.f);
+    auto phi    = glm::half_pi<float>() * lat;
+    auto center = upper ? b : a;
+
+    for (auto s = 0u; s <= sides; ++s) {
+      auto theta  = glm::two_pi<float>() * s / sides;
+      auto radial = side * std::cos(theta) + up * std::sin(theta);
+      auto normal = axis * std::sin(phi) + radial * std::cos(phi);
+      auto pos    = center + normal * radius;
+
+      auto t = glm::clamp(glm::dot(pos - a, axis) / length, 0.f, 1.f);
+      int32_t joints[Skinning::influences]  = {driver, 0, 0, 0};
+      float   weights[Skinning::influences] = {1.f, 0.f, 0.f, 0.f};
+      if (before >= 0 && t < blend) {
+        joints[1]  = before;
+        weights[1] = 0.5f * (1.f - t / blend);
+      }
+      if (after >= 0 && t > 1.f - blend) {
+        joints[2]  = after;
+        weights[2] = 0.5f * (t - (1.f - blend)) / blend;
+      }
+      weights[0] = 1.f - weights[1] - weights[2];
+
+      pose.push(pos, normal, joints, weights);
+      uvs.push_back({(float)s / sides, (float)row / (rows - 1u)});
+    }
+  }
+
+  for (auto row = 0u; row + 1u < rows; ++row) {
+    for (auto s = 0u; s < sides; ++s) {
+      auto i0 = first + row * (sides + 1u) + s;
+      auto i1 = i0 + sides + 1u;
+      indices.insert(indices.end(), {i0, i1, i0 + 1u, i0 + 1u, i1, i1 + 1u});
+    }
+  }
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Build the skinned mesh for the joints of a pose. Bind pose has
+// no rotations: every joint sits at the sum of its offsets from the root,
+// so inverse bind matrices are translations. Each bone is a capsule
+// driven by its parent joint, the one that moves it in hierarchy(). The
+// renderable needs OpenGL, it's made on the render thread
+// ====================================================================== //
+
+void Skeleton::buildSkin(const pose& P) {
+  const auto& joints = P.motion->joints;
+  m_skinRoot         = joints.front().get();
+  auto build         = ++m_skinBuilds;
+
+  std::unordered_map<const Joint*, int32_t> index;
+  std::vector<glm::vec3> bind(joints.size(), glm::vec3(0.f));
+  m_inverseBind.assign(joints.size(), glm::mat4(1.f));
+  for (auto i = 0u; i < joints.size(); ++i) {
+    const auto& J = joints[i];
+    index[J.get()] = i;
+    if (J->parent) {
+      bind[i] = bind[index.at(J->parent.get())] + J->offset * m_scale;
+    }
+    m_inverseBind[i] = glm::translate(glm::mat4(1.f), -bind[i]);
+  }
+
+  auto parentOf = [&](const Joint& J) {
+    return (J.parent) ? index.at(J.parent.get()) : -1;
+  };
+
+  m_skinPose.clear();
+  std::vector<glm::vec2>    uvs;
+  std::vector<unsigned int> indices;
+  auto bone = [&](const glm::vec3& a,
+                  const glm::vec3& b,
+                  int32_t          driver,
+                  int32_t          before,
+                  int32_t          after) {
+    auto length = glm::distance(a, b);
+    if (length < 1e-4f) return;
+    auto radius = glm::min(0.6f * m_scale, 0.4f * length);
+    capsule(m_skinPose, uvs, indices, a, b, radius, driver, before, after);
+  };
+
+  for (auto i = 1u; i < joints.size(); ++i) {
+    const auto& J = *joints[i];
+    if (!J.parent) continue;
+    auto P = parentOf(J);
+    bone(bind[P], bind[i], P, parentOf(*J.parent), i);
+    if (J.endsite) {
+      bone(bind[i], bind[i] + J.endsite->offset * m_scale, i, P, -1);
+    }
+  }
+
+  m_palette.resize(joints.size());
+
+  if (!Settings::quiet) {
+    LOGD("Skin of {} joints: {} vertices, {} tris, {} kernel",
+         joints.size(),
+         m_skinPose.size(),
+         indices.size() / 3u,
+         Skinning::kernel());
+  }
+
+  Renderable::queue.defer([this, build, uvs, indices]() {
+    m_skinRE = Renderable::create(
+        false, "", "", "", Colors::orange, Shader::getByName("sk"));
+    m_skinRE->fillStreamed(uvs);
+    m_skinRE->fillEBO(indices);
+    m_skinBuilt.store(build, std::memory_order_release);
+  });
 }
 
 // ====================================================================== //
 // ====================================================================== //
-// Compute and draw a bone of a gived joint and its parent
+// Skin the mesh with the current joints, straight to the frame bytes,
+// and queue it on the frame render queue. Positions come out in world
+// space, it draws with an identity model
 // ====================================================================== //
 
-void Skeleton::drawBone(const std::shared_ptr<Joint>& J) const {
-  auto P1    = J->matrix[3].xyz();
-  auto P2    = J->parent->matrix[3].xyz();
-  auto scale = glm::distance(P1, P2) * 0.5f;
-  auto bone  = Renderable::line(P1, P2, scale);
+void Skeleton::drawSkin(const pose& P) {
+  const auto& joints = P.motion->joints;
+  if (m_skinRoot != joints.front().get() ||
+      m_inverseBind.size() != joints.size()) {
+    this->buildSkin(P);
+  }
+  if (m_skinPose.size() == 0u) return;
+  if (m_skinBuilt.load(std::memory_order_acquire) != m_skinBuilds) return;
+
+  for (auto i = 0u; i < joints.size(); ++i) {
+    m_palette[i] = P.matrix[i] * m_inverseBind[i];
+  }
 
-  bone->transform.scl *= glm::vec3(5.f, 1.f, 5.f);
-  bone->draw(camera);
-  if (J->endsite) drawBone(J->endsite);
+  auto bytes  = m_skinPose.size() * sizeof(Skinning::vertex);
+  auto offset = Renderable::queue.alloc(bytes);
+  auto out    = reinterpret_cast<Skinning::vertex*>(
+      Renderable::queue.data(offset));
+  auto bounds = Skinning::skin(m_skinPose, m_palette.data(), out);
+
+  Renderable::queue.addStreamed(*m_skinRE,
+                                offset,
+                                bounds.min,
+                                bounds.max,
+                                m_skinRE->color(),
+                                camera);
 }
 
 // ====================================================================== //
@@ -166,45 +426,92 @@ void Skeleton::loadNextMotion() {
 
   m_currFrame  = m_nextFrame;
   m_currMotion = m_nextMotion;
+  m_currID     = m_nextID;
 
   m_nextFrame  = 0u;
   m_nextMotion = nullptr;
+  m_nextID     = noMotion;
 }
 
 // * --- Public --------------------------------------------------------- //
 
+// ====================================================================== //
+// ====================================================================== //
+// Pose taken by the last draw: is there one yet, foot height and root
+// position. Update thread
+// ====================================================================== //
+
+bool  Skeleton::posed() const { return m_poses.front().motion != nullptr; }
+float Skeleton::footHeight() const { return m_poses.front().footHeight; }
+glm::vec3 Skeleton::position() const { return m_poses.front().transform.pos; }
+
 // ====================================================================== //
 // ====================================================================== //
 // Link with the camera
 // ====================================================================== //
 
 void Skeleton::toggleCameraFollow() {
-  this->camera->target = (!this->camera->target)
-                             ? std::shared_ptr<Transform>(
-                                   &this->transform, [](imog::Transform*) {})
-                             : nullptr;
+  this->camera->following()
+      ? this->camera->follow(nullptr, SceneGraph::none)
+      : this->camera->follow(&Renderable::scene, m_rootNode);
 }
 
 // ====================================================================== //
 // ====================================================================== //
-// Manage speed
+// Queue a command for the animation thread (single producer)
 // ====================================================================== //
 
-void Skeleton::incSpeed() { speed = glm::clamp(speed + 0.1f, 0.1f, 2.f); }
-void Skeleton::decSpeed() { speed = glm::clamp(speed - 0.1f, 0.1f, 2.f); };
+void Skeleton::push(const command& cmd) {
+  if (!m_commands.push(cmd)) LOGE("Skeleton command queue is full.");
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Manage speed (queued)
+// ====================================================================== //
+
+void Skeleton::incSpeed() {
+  push({command::type::speed, noMotion, noMotion, 0.1f});
+}
+void Skeleton::decSpeed() {
+  push({command::type::speed, noMotion, noMotion, -0.1f});
+}
 
 // ====================================================================== //
 // ====================================================================== //
-// Manage linked motion alpha to lerp
+// Manage linked motion alpha to lerp (queued)
 // ====================================================================== //
 
 void Skeleton::incLinkedAlpha() {
-  m_linkedAlpha += alphaStep();
-  m_linkedAlpha = glm::clamp(m_linkedAlpha, 0.f, 1.f);
+  push({command::type::linkedAlpha, noMotion, noMotion, 1.f});
 }
 void Skeleton::decLinkedAlpha() {
-  m_linkedAlpha -= alphaStep();
-  m_linkedAlpha = glm::clamp(m_linkedAlpha, 0.f, 1.f);
+  push({command::type::linkedAlpha, noMotion, noMotion, -1.f});
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Toggle play state (queued)
+// ====================================================================== //
+
+void Skeleton::togglePlay() { push({command::type::togglePlay}); }
+
+// ====================================================================== //
+// ====================================================================== //
+// Un/link other motion to a motion (queued)
+// ====================================================================== //
+
+void Skeleton::toggleLink(uint motionID, uint linkedID) {
+  push({command::type::toggleLink, motionID, linkedID});
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Change an input of inputFn (queued), keeping the order of input events
+// ====================================================================== //
+
+void Skeleton::queueInput(uint input, uint value) {
+  push({command::type::input, input, value});
 }
 
 // ====================================================================== //
@@ -259,109 +566,206 @@ void Skeleton::animate() {
 
   // Actions per frame
   auto animationFn = [&]() {
+    static auto& tickMs = Metrics::findHistogram("anim.tick.ms");
+    TimePoint    start  = StdClock::now();
+
+    applyCommands();
     if (!this->play or !m_currMotion) return;
     hierarchy();
     frameCounter();
     userFn();
-    if (!Settings::pollEvents) { glfwPostEmptyEvent(); }
+    publishPose();
+    DebugDraw::commit();
+    FrameScheduler::invalidate();
+
+    Seconds elapsed = StdClock::now() - start;
+    tickMs.observe(elapsed.count() * 1000.0);
   };
 
-  // Thread lauch
+  // Thread lauch. Recorded and replayed runs step it from the frame loop
+  // on the virtual clock of the input log instead, to be repeatable
   std::call_once(m_animationOnceFlag, [&]() {
+    if (Replay::recording() || Replay::replaying()) {
+      Replay::drive([timestepFn, animationFn]() {
+        animationFn();
+        return timestepFn();
+      });
+      return;
+    }
     Async::periodic(timestepFn, &m_animThread, animationFn);
   });
 }
 
 // ====================================================================== //
 // ====================================================================== //
-// Compute joints models and draw its renderable bone
+// Queue bone and head instances of this skeleton for batchDraw, or its
+// skinned mesh with Settings::skinnedMesh
 // ====================================================================== //
 
-void Skeleton::draw() const {
-  if (!m_currMotion) return;
-  auto joints = m_currMotion->joints;
+void Skeleton::draw() {
+  m_poses.update();
+  const auto& P = m_poses.front();
+  if (!P.motion) return;
+  m_rootState = P.transform;
+  if (Settings::skinnedMesh) {
+    this->drawSkin(P);
+    Renderable::scene.update();
+    return;
+  }
+  const auto& joints = P.motion->joints;
 
-  // Draw joints
-  for (auto idx = 0u; idx < joints.size(); ++idx) {
-    auto J = joints.at(idx);
-    if (!J->parent) continue;
+  const auto& boneRE = Renderable::get(m_boneRE);
+  const auto& headRE = Renderable::get(m_headRE);
+  if (!boneRE) return;
 
-    if (J->name == "Head" and J->endsite) {
-      auto headRE = Renderable::getByName("Monkey");
+  auto addBone = [&](const glm::mat4& M1, const glm::mat4& M2) {
+    auto P1 = M1[3].xyz();
+    auto P2 = M2[3].xyz();
+    if (P1 == P2) return;
+    m_batch.add(m_boneRE, boneMatrix(P1, P2, 5.f), boneRE->color());
+  };
 
-      auto aux = J->endsite->matrix;
-      aux      = glm::translate(aux, glm::vec3{0.f, 1.f, 0.f});
-      aux      = glm::scale(aux, glm::vec3{3.f});
+  for (auto i = 0u; i < joints.size(); ++i) {
+    const auto& J = *joints[i];
+    if (P.parent[i] < 0) continue;
 
-      headRE->transform.overrideMatrix = aux;
-      headRE->draw(camera);
+    if (J.name == "Head" and J.endsite) {
+      Renderable::scene.setLocal(m_headNode, P.endsite[i]);
     }
 
-    // auto jointRE = Renderable::getByName("Ball");
-    // auto aux = J->matrix;
-    // aux      = glm::scale(aux, glm::vec3{3.f});
-    // jointRE->transform.overrideMatrix = aux;
-    // jointRE->draw(camera);
+    addBone(P.matrix[i], P.matrix[P.parent[i]]);
+    if (J.endsite) addBone(P.endsite[i], P.matrix[i]);
+  }
 
-    drawBone(J);
+  // Root and head world matrices, before the camera follows the root
+  Renderable::scene.update();
+  if (headRE) {
+    m_batch.add(m_headRE, Renderable::scene.world(m_headMesh), headRE->color());
   }
 }
 
 // ====================================================================== //
 // ====================================================================== //
-// Modify current motion (user call)
-//-> Always lowercase
+// Queue the instances of every skeleton inside the camera frustum on the
+// frame render queue, one instanced call per mesh and level of detail.
+// Returns the number of draw calls queued
+// ====================================================================== //
+
+unsigned int Skeleton::batchDraw(const std::shared_ptr<Camera>& camera) {
+  Frustum frustum(camera->viewproj());
+  m_batch.record(&frustum, camera.get());
+  auto draws = m_batch.submit();
+  m_batch.clear();
+  return draws;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Modify current motion (animation thread). Two array lookups, no allocations
 // ====================================================================== //
-//
-void Skeleton::setMotion(const std::string& dest) {
-  auto        _dest = Strings::toLower(dest);
-  std::string key   = m_currMotion->name + "_" + _dest;
 
-  if (m_currMotion->name == _dest || m_currMotion->isMix() || !m_currMotion ||
-      !motionExists(_dest) || !mixMotionExists(key))
+void Skeleton::setMotion(uint destID) {
+  uint K = m_motions.size();
+
+  // Unknown destination, same motion or in the middle of a transition
+  if (!m_currMotion || m_currID >= K || destID >= K || m_currID == destID)
     return;
 
-  auto t = (m_currFrame >= lastFrame()) ? m_motionMap.at(key).at(lastFrame())
-                                        : m_motionMap.at(key).at(m_currFrame);
-  m_nextFrame  = t.first;
-  m_nextMotion = m_motions.at(_dest);
+  auto  cell = m_mixOffsets[m_currID * K + destID];
+  auto& t    = m_mixTable[cell + glm::min(m_currFrame, lastFrame())];
+
+  m_nextFrame  = t.frame;
+  m_nextMotion = m_motions[destID];
+  m_nextID     = destID;
 
   m_currFrame  = 0u;
-  m_currMotion = t.second;
+  m_currMotion = t.motion;
+  m_currID     = noMotion;
+
+  static auto& switches = Metrics::findCounter("motion.switches");
+  switches.add();
 }
 
 // ====================================================================== //
 // ====================================================================== //
-// Add motions to skeleton motion map
-//-> The motion name is converted to lowercase
+// Modify current motion by name. Resolves the ID on every call
+//-> Always lowercase
 // ====================================================================== //
 
-void Skeleton::addMotion(const std::shared_ptr<Motion> m2) {
-  // @lambda : Manage motion list and wrap the process of mix two motions
-  auto _mix = [&](const std::shared_ptr<Motion>& _m1,
-                  const std::shared_ptr<Motion>& _m2) {
-    std::string key    = _m1->name + "_" + _m2->name;
-    auto        mixMap = _m1->mix(_m2);
-    this->m_motionMap.insert({key, mixMap});
-  };
+void Skeleton::setMotion(const std::string& dest) {
+  auto destID = motionID(dest);
+  if (destID != noMotion) setMotion(destID);
+}
 
-  // ----
+// ====================================================================== //
+// ====================================================================== //
+// Get the ID of a motion by name, noMotion if it doesn't exist
+// ====================================================================== //
 
+uint Skeleton::motionID(const std::string& name) const {
+  auto it = m_motionIDs.find(Strings::toLower(name));
+  if (it == m_motionIDs.end()) {
+    if (!Settings::quiet) LOGE("Zero motions with name {}.", name);
+    return noMotion;
+  }
+  return it->second;
+}
+
+// ====================================================================== //
+// ====================================================================== //
+// Add motions to skeleton motion map and get its ID
+//-> The motion name is converted to lowercase
+// ====================================================================== //
+
+uint Skeleton::addMotion(const std::shared_ptr<Motion> m2) {
   if (m2->isMix()) {
     LOGE("Motion names can NOT contains '_' is reserved for mixed motions");
-    return;
+    return noMotion;
   }
   m2->name = Strings::toLower(m2->name);
+  if (m_motionIDs.count(m2->name) > 0) { return m_motionIDs.at(m2->name); }
+
+  // Compute transitions of the new motion against the stored ones
+  uint                             K = m_motions.size();
+  std::vector<Motion::transitions> from(K), to(K);
+  for (auto id = 0u; id < K; ++id) {
+    from[id] = m_motions[id]->mix(m2);
+    to[id]   = m2->mix(m_motions[id]);
+  }
 
-  // Compute transitions
-  for (const auto& [_, m1] : m_motions) {
-    if (m1->isMix()) continue;
-    _mix(m1, m2);
-    _mix(m2, m1);
+  // Rebuild the dense table with the new row and column
+  uint                            newK = K + 1u;
+  std::vector<uint>               offsets(newK * newK + 1u, 0u);
+  std::vector<Motion::transition> table;
+
+  for (auto A = 0u; A < newK; ++A) {
+    for (auto B = 0u; B < newK; ++B) {
+      offsets[A * newK + B] = table.size();
+      if (A == B) continue;
+
+      if (A < K && B < K) {
+        auto first = m_mixTable.begin() + m_mixOffsets[A * K + B];
+        auto last  = m_mixTable.begin() + m_mixOffsets[A * K + B + 1u];
+        table.insert(table.end(), first, last);
+      } else {
+        const auto& cell = (B == K) ? from[A] : to[B];
+        table.insert(table.end(), cell.begin(), cell.end());
+      }
+    }
   }
+  offsets[newK * newK] = table.size();
+
+  m_mixOffsets = std::move(offsets);
+  m_mixTable   = std::move(table);
+
+  // Store the motion
+  uint id = K;
+  m_motions.push_back(m2);
+  m_motionIDs.try_emplace(m2->name, id);
 
-  m_motions.try_emplace(m2->name, m2);
-  m_currMotion = m_motions.at(m2->name);
+  m_currMotion = m2;
+  m_currID     = id;
+  return id;
 }
 
 // ====================================================================== //
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <set>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -8,15 +9,40 @@
 #include "gltools_IO.hpp"
 #include "gltools_Math.hpp"
 #include "gltools_Camera.hpp"
+#include "gltools_Skinning.hpp"
 #include "gltools_Transform.hpp"
 
 #include "mgtools_Motion.hpp"
 
 #include "cpptools_Logger.hpp"
+#include "cpptools_Registry.hpp"
+#include "cpptools_SPSCQueue.hpp"
+#include "cpptools_TripleBuffer.hpp"
+#include "gltools_InstanceBatch.hpp"
 
 namespace imog {
+class Renderable;
+
 class Skeleton {
 
+public:
+  // Typed request from input or gameplay code. Queued from any ONE thread
+  // and applied, in order, at the start of the next animation tick
+  struct command {
+    enum struct type {
+      speed,
+      linkedAlpha,
+      togglePlay,
+      toggleLink,
+      input // Handed to inputFn: motion is the input, other its value
+    };
+
+    type  kind;
+    uint  motion{~0u};
+    uint  other{~0u};
+    float value{0.f};
+  };
+
 private:
   float          m_scale;
   bool           m_animThread;
@@ -25,11 +51,56 @@ private:
   unsigned int m_currFrame;
   unsigned int m_nextFrame;
 
+  // Renderables resolved once at creation, used on every draw
+  Handle<Renderable> m_boneRE;
+  Handle<Renderable> m_headRE;
+
+  // Scene nodes: the root follows the transform of the last pose taken
+  // (camera target), the head mesh hangs from the Head end-site node, set
+  // from the joints on every draw. Update thread only
+  Transform        m_rootState;
+  SceneGraph::node m_rootNode;
+  SceneGraph::node m_headNode;
+  SceneGraph::node m_headMesh;
+
   std::shared_ptr<Motion> m_currMotion;
   std::shared_ptr<Motion> m_nextMotion;
 
-  std::unordered_map<std::string, std::shared_ptr<Motion>> m_motions;
-  std::unordered_map<std::string, Motion::mixMap>          m_motionMap;
+  // Motion IDs of current and next motion, noMotion while transitioning
+  uint m_currID;
+  uint m_nextID;
+
+  // Motions indexed by ID, names only used to resolve IDs at load time
+  std::vector<std::shared_ptr<Motion>>  m_motions;
+  std::unordered_map<std::string, uint> m_motionIDs;
+
+  // Dense KxK transitions table (CSR). Transitions from motion A to B are
+  // m_mixTable[m_mixOffsets[A*K+B] .. m_mixOffsets[A*K+B+1]), one per frame
+  std::vector<uint>               m_mixOffsets;
+  std::vector<Motion::transition> m_mixTable;
+
+  // Commands pending to be applied by the animation thread
+  SPSCQueue<command, 256u> m_commands;
+
+  // Apply queued commands. Only called from the animation thread
+  void applyCommands();
+
+  // What the update thread reads of a tick: joint matrices of the motion
+  // hierarchy (names, offsets and parents never change once loaded), the
+  // root transform and the foot height
+  struct pose {
+    std::shared_ptr<Motion> motion;
+    std::vector<int32_t>    parent;  // Index of the parent joint, -1 root
+    std::vector<glm::mat4>  matrix;  // Per joint
+    std::vector<glm::mat4>  endsite; // Per joint, its end-site if it has one
+    Transform               transform;
+    float                   footHeight{0.f};
+  };
+  TripleBuffer<pose> m_poses;
+
+  // Copy the joints of this tick to a pose and publish it. Only called
+  // from the animation thread, at the end of each tick
+  void publishPose();
 
   // Alpha value for linked motions
   float m_linkedAlpha;
@@ -45,17 +116,33 @@ private:
   // Compute hierarchy of the skeleton based on current frame and motion
   void hierarchy();
 
-  // Verify if motion exist on motion map
-  template <typename T>
-  bool motionExistsOnMap(const std::unordered_map<std::string, T>& map,
-                         const std::string&                        name) const;
-  // Check for motion in mix map
-  bool mixMotionExists(const std::string& name) const;
-  // Check for motion in regular map
-  bool motionExists(const std::string& name) const;
+  // Bones and heads of every skeleton, drawn together by batchDraw
+  static InstanceBatch m_batch;
+
+  // Model matrix of a bone mesh (unit height 2) laid between two points
+  static glm::mat4 boneMatrix(const glm::vec3& P1,
+                              const glm::vec3& P2,
+                              float            thickness);
+
+  // Skinned mesh (Settings::skinnedMesh): capsules around the bones of
+  // the bind pose, the joints of current motion without rotations
+  Skinning::bindPose          m_skinPose;
+  std::vector<glm::mat4>      m_inverseBind;
+  std::vector<glm::mat4>      m_palette;
+  std::shared_ptr<Renderable> m_skinRE;
+  const Joint*                m_skinRoot; // Joints the skin was built for
+
+  // Skins built, and the last one made on the render thread. m_skinRE is
+  // only read once they match
+  unsigned int              m_skinBuilds;
+  std::atomic<unsigned int> m_skinBuilt;
+
+  // Build the skinned mesh for the joints of a pose
+  void buildSkin(const pose& P);
 
-  // Compute and draw a bone of a gived joint and its parent
-  void drawBone(const std::shared_ptr<Joint>& J) const;
+  // Skin the mesh with the current joints and queue it on the frame
+  // render queue, once its renderable is ready
+  void drawSkin(const pose& P);
 
   // Jump from current motion to next motion modifying also
   // the value of the current frame
@@ -63,6 +150,8 @@ private:
 
 
 public:
+  static constexpr uint noMotion = ~0u;
+
   Skeleton(const std::shared_ptr<imog::Camera>& camera,
            float                                scale = 1.f,
            float                                speed = 1.f);
@@ -76,37 +165,68 @@ public:
   Transform               transform;
   _IO_FUNC                userFn;
 
-  // Get current motion
-  float footHeight() const { return m_currMotion->joints.at(5)->matrix[3].y; }
+  // Input state for userFn, set by input commands on the animation thread
+  std::function<void(uint input, uint value)> inputFn;
+
+  // Pose taken by the last draw: is there one yet, foot height and root
+  // position. Update thread
+  bool      posed() const;
+  float     footHeight() const;
+  glm::vec3 position() const;
 
   // link with the camera
   void toggleCameraFollow();
 
-  // manage speed
+  // Queue a command for the animation thread (single producer)
+  void push(const command& cmd);
+
+  // manage speed (queued)
   void incSpeed();
   void decSpeed();
 
-  // manage linked motion alpha and steps to lerp
+  // manage linked motion alpha and steps to lerp (queued)
   unsigned int linkedSteps;
   void         incLinkedAlpha();
   void         decLinkedAlpha();
 
+  // toggle play state (queued)
+  void togglePlay();
+
+  // un/link other motion to a motion (queued)
+  void toggleLink(uint motionID, uint linkedID);
+
+  // Change an input of inputFn (queued), keeping the order of input events
+  void queueInput(uint input, uint value);
+
   // Compute displacement to apply on next user input
   float step() const;
 
   // Run a detached thread for animation process
   void animate();
 
-  // Compute joints models and draw its renderable bone
-  void draw() const;
+  // Queue bone and head instances of this skeleton for batchDraw, or its
+  // skinned mesh with Settings::skinnedMesh
+  void draw();
+
+  // Queue the instances of every skeleton inside the camera frustum on the
+  // frame render queue, one instanced call per mesh and level of detail.
+  // Returns the number of draw calls queued
+  static unsigned int batchDraw(const std::shared_ptr<Camera>& camera);
 
-  // Modify current motion (user call)
-  //-> Always lowercase
+  // Modify current motion. Two array lookups, no allocations
+  //-> Animation thread only (userFn), other threads queue input commands
+  void setMotion(uint destID);
+
+  // Modify current motion by name. Resolves the ID on every call, prefer IDs
+  //-> Always lowercase. Animation thread only
   void setMotion(const std::string& dest);
 
-  // Add motions to skeleton motion map
+  // Get the ID of a motion by name, noMotion if it doesn't exist
+  uint motionID(const std::string& name) const;
+
+  // Add motions to skeleton motion map and get its ID
   //-> The motion name is converted to lowercase
-  void addMotion(const std::shared_ptr<Motion> motion);
+  uint addMotion(const std::shared_ptr<Motion> motion);
 
   // Define actions on key state
   void onKey(int      key,